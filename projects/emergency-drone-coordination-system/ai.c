@@ -1,22 +1,44 @@
 #include "headers/ai.h"
+#include "headers/globals.h"
+#include "headers/lockprof.h"
+#include "headers/metrics.h"
+#include "headers/trace.h"
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
-void assign_mission(Drone *drone, Coord target) {
-    pthread_mutex_lock(&drone->lock);
-    drone->target = target;
+void (*mission_hook)(Drone *drone, const Mission *m) = NULL;
+
+/* gives m to drone unless it stopped being idle since it was picked;
+ * caller holds missions.lock. Returns -1 if the drone is not idle. */
+int assign_mission(Drone *drone, Mission *m) {
+    long t = trace_now();
+    prof_lock(&drone->lock);
+    if (drone->status != IDLE) {
+        prof_unlock(&drone->lock);
+        trace_instant("assign_raced", drone->id);
+        return -1;
+    }
+    mission_start(m, drone);
+    drone->target = m->survivor.coord;
     drone->status = ON_MISSION;
-    pthread_mutex_unlock(&drone->lock);
+    drone->mission_id = m->id;
+    if (mission_hook) mission_hook(drone, m);
+    prof_unlock(&drone->lock);
+    trace_span("assign_mission", t, m->id);
+    return 0;
 }
 
 Drone *find_closest_idle_drone(Coord target) {
+    long t = trace_now();
     Drone *closest = NULL;
     int min_distance = INT_MAX;
-    pthread_mutex_lock(&drones->lock);  // List mutex
+    prof_lock(&drones->lock);  // List mutex
+    long locked = metrics_now_ns();
     Node *node = drones->head;
     while (node != NULL) {
-        Drone *d = (Drone *)node->data;
+        Drone *d = *(Drone **)node->data;
         if (d->status == IDLE) {
             int dist = abs(d->coord.x - target.x) +
                        abs(d->coord.y - target.y);
@@ -27,53 +49,55 @@ Drone *find_closest_idle_drone(Coord target) {
         }
         node = node->next;
     }
-    pthread_mutex_unlock(&drones->lock);  // List mutex
+    metrics_record(METRIC_LIST_LOCK_HOLD, metrics_now_ns() - locked);
+    prof_unlock(&drones->lock);  // List mutex
+    trace_span("nearest_drone", t, closest ? closest->id : 0);
     return closest;
 }
 
+/* Lock order: missions.lock -> drones->lock -> drone->lock. The AI
+ * sleeps on the wake of the table's only queue (no regions), which is
+ * signaled when a mission is queued or requeued and when a drone
+ * finishes one. It also wakes at the next mission deadline and at
+ * least once a second, to see drones that became idle on their own. */
 void *ai_controller(void *arg) {
-    while (1) {
-        // TODO change the lock and unlock location to avoid deadlock
-
-        pthread_mutex_lock(&survivors->lock);  // List mutex
-        Survivor *s = NULL;
-        if (s = survivors->peek(survivors)) {  
-            Drone *closest = find_closest_idle_drone(s->coord);
-            if (closest) {
-                assign_mission(closest, s->coord); // Uses drone->lock
-                printf("Drone %d assigned to survivor at (%d, %d)\n",
-                       closest->id, s->coord.x, s->coord.y);
-
-
-                // Remove from global list: make sure to use
-                // correct removedata or removenode
-                survivors->removedata(survivors,s);  
-                // TODO: assuming it is helped
-                s->status = 1;  // Mark as helped
-                s->helped_time = s->discovery_time;  
-
-                // // TODO: you should remove it when the drone
-                // reaches the survivor
-                // // Remove from map cell's survivor list
-                // pthread_mutex_lock(&helpedsurvivors->lock); // List
-                // mutex helpedsurvivors->add(helpedsurvivors, s); //
-                // Add to helped list
-                // pthread_mutex_unlock(&helpedsurvivors->lock); //
-                // List mutex
+    (void)arg;
+    trace_thread_name("ai");
+    pthread_mutex_lock(&missions.lock);
+    while (running) {
+        long t = trace_now();
+        int expired = mission_expire(time(NULL));
+        if (expired) {  // log unlocked; the pass below sees any wakeup
+            pthread_mutex_unlock(&missions.lock);
+            printf("%d missions expired\n", expired);
+            pthread_mutex_lock(&missions.lock);
+        }
 
-                printf("Survivor %s being helped by Drone %d\n",
-                       s->info, closest->id);
-            }
+        // highest priority first, as long as there are idle drones
+        Mission *m;
+        while ((m = mission_next()) != NULL) {
+            Drone *closest = find_closest_idle_drone(m->survivor.coord);
+            if (!closest) break;
+            if (assign_mission(closest, m) != 0) continue;  // pick again
+            printf("Drone %d assigned to survivor %s at (%d, %d)\n",
+                   closest->id, m->survivor.info, m->survivor.coord.x,
+                   m->survivor.coord.y);
         }
-        pthread_mutex_unlock(
-            &survivors->lock);  // TODO change its location
+        trace_span("ai_pass", t, missions.waiting);
 
-        // // Remove from map cell (if needed)
-        // pthread_mutex_lock(&map.cells[s.coord.x][s.coord.y].survivors->lock);
-        // map.cells[s.coord.x][s.coord.y].survivors->removedata(
-        //     map.cells[s.coord.x][s.coord.y].survivors, &s);
-        // pthread_mutex_unlock(&map.cells[s.coord.x][s.coord.y].survivors->lock);
-        sleep(1);
+        // sleep until woken, the next deadline or a second from now
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += 1;
+        Mission *first = missions.deadlines.next;
+        if (first != &missions.deadlines && first->deadline &&
+            first->deadline < until.tv_sec) {
+            until.tv_sec = first->deadline;
+            until.tv_nsec = 0;
+        }
+        pthread_cond_timedwait(&missions.region[0].wake, &missions.lock,
+                               &until);
     }
+    pthread_mutex_unlock(&missions.lock);
     return NULL;
-}
\ No newline at end of file
+}
@@ -0,0 +1,188 @@
+/**
+ * @file codec.c
+ * @brief compact binary encoding of world snapshots: LEB128 varints,
+ * zigzag for signed values and run-length coded occupancy.
+ *
+ * Frame layout (all numbers are varints):
+ *   "DRFR" version seq height width num_drones
+ *   num_drones * (id status x y target.x target.y)
+ *   occupancy runs: empty run, occupied run, empty run ... until
+ *   height*width cells are covered
+ */
+#include "headers/codec.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief writes v as a little-endian base-128 varint
+ * @return int: number of bytes written (1..VARINT_MAX)
+ */
+int put_varint(unsigned char *buf, unsigned int v) {
+    int n = 0;
+    while (v >= 0x80) {
+        buf[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = (unsigned char)v;
+    return n;
+}
+
+/**
+ * @brief reads a varint from at most len bytes of buf
+ * @return int: bytes consumed, 0 if buf ends inside the varint, -1 if
+ * the varint is longer than VARINT_MAX
+ */
+int get_varint(const unsigned char *buf, size_t len, unsigned int *v) {
+    unsigned int result = 0;
+    for (int i = 0; i < VARINT_MAX; i++) {
+        if ((size_t)i >= len) return 0;
+        result |= (unsigned int)(buf[i] & 0x7f) << (7 * i);
+        if (!(buf[i] & 0x80)) {
+            *v = result;
+            return i + 1;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief run-length codes n cells of 0/1 as alternating run lengths,
+ * starting with a (possibly empty) run of zeros.
+ * @return size_t: bytes written, at most (n + 1) * VARINT_MAX
+ */
+size_t rle_encode(const unsigned char *cells, int n, unsigned char *buf) {
+    size_t len = 0;
+    int i = 0;
+    unsigned char value = 0;
+    while (i < n) {
+        int start = i;
+        while (i < n && (cells[i] != 0) == value) i++;
+        len += put_varint(buf + len, i - start);
+        value = !value;
+    }
+    return len;
+}
+
+/**
+ * @brief inverse of rle_encode
+ * @return int: bytes consumed, -1 if the runs are malformed
+ */
+int rle_decode(const unsigned char *buf, size_t len, unsigned char *cells,
+               int n) {
+    size_t pos = 0;
+    int i = 0;
+    unsigned char value = 0;
+    while (i < n) {
+        unsigned int run;
+        int k = get_varint(buf + pos, len - pos, &run);
+        if (k <= 0 || run > (unsigned int)(n - i)) return -1;
+        pos += k;
+        memset(cells + i, value, run);
+        i += run;
+        value = !value;
+    }
+    return (int)pos;
+}
+
+size_t frame_max_size(int height, int width, int num_drones) {
+    return 5 + 5 * VARINT_MAX + (size_t)num_drones * 6 * VARINT_MAX +
+           ((size_t)height * width + 1) * VARINT_MAX;
+}
+
+/**
+ * @brief encodes the whole snapshot (a keyframe) into buf, which must
+ * hold frame_max_size() bytes
+ * @return size_t: encoded length
+ */
+size_t encode_frame(const WorldSnapshot *snap, unsigned char *buf) {
+    size_t len = 0;
+    memcpy(buf, FRAME_MAGIC, 4);
+    len += 4;
+    buf[len++] = FRAME_VERSION;
+    len += put_varint(buf + len, (unsigned int)snap->seq);
+    len += put_varint(buf + len, snap->height);
+    len += put_varint(buf + len, snap->width);
+    len += put_varint(buf + len, snap->num_drones);
+    for (int i = 0; i < snap->num_drones; i++) {
+        const DroneView *d = &snap->drones[i];
+        len += put_varint(buf + len, d->id);
+        len += put_varint(buf + len, d->status);
+        len += put_varint(buf + len, d->coord.x);
+        len += put_varint(buf + len, d->coord.y);
+        len += put_varint(buf + len, d->target.x);
+        len += put_varint(buf + len, d->target.y);
+    }
+    len += rle_encode(snap->occupied, snap->height * snap->width,
+                      buf + len);
+    return len;
+}
+
+/**
+ * @brief decodes a frame into dest, (re)allocating its arrays. dest
+ * must be zeroed or come from an earlier decode_frame. dest->dirty is
+ * not filled in, a frame has no notion of what changed.
+ * @return int: 0 on success, -1 on a malformed frame
+ */
+int decode_frame(const unsigned char *buf, size_t len,
+                 WorldSnapshot *dest) {
+    unsigned int v[6], seq, height, width, num_drones;
+    size_t pos = 5;
+    int k;
+
+    if (len < 5 || memcmp(buf, FRAME_MAGIC, 4) != 0 ||
+        buf[4] != FRAME_VERSION)
+        return -1;
+
+#define NEXT(var)                                          \
+    do {                                                   \
+        if ((k = get_varint(buf + pos, len - pos, &(var))) <= 0) \
+            return -1;                                     \
+        pos += k;                                          \
+    } while (0)
+
+    NEXT(seq);
+    NEXT(height);
+    NEXT(width);
+    NEXT(num_drones);
+
+    // the frame comes off the network: sizes must fit what follows
+    size_t cells = (size_t)height * width;
+    if (cells > INT_MAX || num_drones > (len - pos) / 6) return -1;
+    if (height != (unsigned int)dest->height ||
+        width != (unsigned int)dest->width) {
+        free(dest->occupied);
+        dest->occupied = malloc(cells);
+        if (!dest->occupied) {
+            dest->height = dest->width = 0;
+            return -1;
+        }
+        dest->height = height;
+        dest->width = width;
+    }
+    if ((size_t)num_drones > (size_t)dest->drone_capacity) {
+        free(dest->drones);
+        dest->drones = malloc(sizeof(DroneView) * (size_t)num_drones);
+        if (!dest->drones) {
+            dest->drone_capacity = 0;
+            return -1;
+        }
+        dest->drone_capacity = num_drones;
+    }
+    for (unsigned int i = 0; i < num_drones; i++) {
+        for (int f = 0; f < 6; f++) NEXT(v[f]);
+        dest->drones[i] = (DroneView){.id = v[0],
+                                      .status = v[1],
+                                      .coord = {v[2], v[3]},
+                                      .target = {v[4], v[5]}};
+    }
+#undef NEXT
+    dest->num_drones = num_drones;
+    dest->seq = seq;
+    dest->num_dirty = 0;
+
+    if (rle_decode(buf + pos, len - pos, dest->occupied, (int)cells) < 0)
+        return -1;
+    return 0;
+}
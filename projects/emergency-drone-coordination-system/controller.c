@@ -4,44 +4,261 @@
 #include "headers/drone.h"
 #include "headers/survivor.h"
 #include "headers/ai.h"
+#include "headers/metrics.h"
+#include "headers/mission.h"
 #include "headers/list.h"
+#include "headers/lockprof.h"
+#include "headers/pool.h"
+#include "headers/region.h"
+#include "headers/snapshot.h"
+#include "headers/codec.h"
+#include "headers/stream.h"
+#include "headers/trace.h"
+#ifndef NO_SDL
 #include "headers/view.h"
+#endif
+#include <getopt.h>
+#include <signal.h>
 #include <stdio.h>
-List *survivors, *helpedsurvivors, *drones;
+#include <stdlib.h>
+#include <unistd.h>
+List *helpedsurvivors, *drones;
+volatile sig_atomic_t running = 1;
+static volatile sig_atomic_t metrics_requested = 0;  // SIGUSR1
 
+/* Run options; everything but the SDL window is shared by both modes */
+typedef struct options {
+    int headless;      // no SDL at all, stop after ticks/duration
+    long ticks;        // snapshot ticks to run, 0 = no limit
+    long duration;     // seconds to run, 0 = no limit
+    char *dump_dir;    // write a frame every dump_every ticks if set
+    long dump_every;
+    int height, width;
+    int stream_port;   // serve remote viewers if not 0
+    char *trace_path;  // Chrome trace written at exit if set
+    int regions;       // AI workers by map region (region.c), 0: one AI
+    int pool;          // drones, generator and AI as tasks on this many
+                       // workers (pool.c), 0: a thread each
+} Options;
+
+static void stop(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+static void request_metrics(int sig) {
+    (void)sig;
+    metrics_requested = 1;
+}
+
+/* log_performance() if SIGUSR1 asked for it */
+static void check_metrics() {
+    if (!metrics_requested) return;
+    metrics_requested = 0;
+    log_performance(stdout, num_drones);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [--headless] [--ticks N] [--duration SEC]\n"
+            "          [--dump DIR] [--dump-every N]\n"
+            "          [--map HEIGHTxWIDTH] [--drones N]\n"
+            "          [--stream PORT] [--trace FILE] [--regions K]\n"
+            "          [--pool N]\n",
+            prog);
+}
+
+static int parse_options(int argc, char *argv[], Options *opt) {
+    static struct option longopts[] = {
+        {"headless", no_argument, NULL, 'H'},
+        {"ticks", required_argument, NULL, 't'},
+        {"duration", required_argument, NULL, 'd'},
+        {"dump", required_argument, NULL, 'o'},
+        {"dump-every", required_argument, NULL, 'e'},
+        {"map", required_argument, NULL, 'm'},
+        {"drones", required_argument, NULL, 'n'},
+        {"stream", required_argument, NULL, 's'},
+        {"trace", required_argument, NULL, 'T'},
+        {"regions", required_argument, NULL, 'R'},
+        {"pool", required_argument, NULL, 'P'},
+        {NULL, 0, NULL, 0}};
+    int c;
+    while ((c = getopt_long(argc, argv, "Ht:d:o:e:m:n:s:T:R:P:", longopts,
+                            NULL)) != -1) {
+        switch (c) {
+            case 'H': opt->headless = 1; break;
+            case 't': opt->ticks = atol(optarg); break;
+            case 'd': opt->duration = atol(optarg); break;
+            case 'o': opt->dump_dir = optarg; break;
+            case 'e': opt->dump_every = atol(optarg); break;
+            case 'm':
+                if (sscanf(optarg, "%dx%d", &opt->height, &opt->width) != 2 ||
+                    opt->height <= 0 || opt->width <= 0)
+                    return -1;
+                break;
+            case 'n': num_drones = atoi(optarg); break;
+            case 's': opt->stream_port = atoi(optarg); break;
+            case 'T': opt->trace_path = optarg; break;
+            case 'R': opt->regions = atoi(optarg); break;
+            case 'P': opt->pool = atoi(optarg); break;
+            default: return -1;
+        }
+    }
+    if (opt->dump_every <= 0 || num_drones <= 0) return -1;
+#ifdef NO_SDL
+    opt->headless = 1;  // built without view.c
+#endif
+    return 0;
+}
+
+/* writes the snapshot as DIR/frame-<seq>.bin */
+static int dump_frame(const char *dir, const WorldSnapshot *snap,
+                      unsigned char *buf) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/frame-%06lu.bin", dir, snap->seq);
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+    size_t len = encode_frame(snap, buf);
+    int short_write = fwrite(buf, 1, len, fp) != len;
+    // fclose() flushes: a full disk may only show here
+    if (fclose(fp) != 0 || short_write) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief runs the simulation without SDL. The main thread publishes the
+ * snapshots itself, one per tick, so --ticks counts exactly and every
+ * dumped frame is a published snapshot.
+ */
+static void run_headless(Options *opt) {
+    unsigned char *buf = NULL;
+    if (opt->dump_dir) {
+        buf = malloc(frame_max_size(map.height, map.width, num_drones));
+        if (!buf) {
+            perror("Failed to allocate frame buffer");
+            return;
+        }
+    }
+    long max_ticks = opt->ticks;
+    if (opt->duration > 0) {
+        long by_time = opt->duration * 1000 / SNAPSHOT_INTERVAL_MS;
+        if (max_ticks == 0 || by_time < max_ticks) max_ticks = by_time;
+    }
+
+    long tick = 0;
+    while (running && (max_ticks == 0 || tick < max_ticks)) {
+        publish_snapshot();
+        tick++;
+        const WorldSnapshot *snap = latest_snapshot();
+        if (buf && tick % opt->dump_every == 0) {
+            if (dump_frame(opt->dump_dir, snap, buf) != 0) break;
+        }
+        check_metrics();
+        usleep(SNAPSHOT_INTERVAL_MS * 1000);
+    }
+    printf("Headless run finished after %ld ticks\n", tick);
+    free(buf);
+}
+
+int main(int argc, char *argv[]) {
+    Options opt = {.dump_every = 1, .height = 40, .width = 30};
+    if (parse_options(argc, argv, &opt) != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    signal(SIGUSR1, request_metrics);
+    if (opt.trace_path) trace_start();
 
-int main() {
     // Initialize global lists
-    survivors = create_list(sizeof(Survivor), 1000);     // Survivors waiting for help
-    helpedsurvivors = create_list(sizeof(Survivor), 1000); // Helped survivors
-    drones = create_list(sizeof(Drone), 100);            // Active drones
+    // survivors waiting for help, no deadlines
+    if (mission_init(1000, 0) != 0) {
+        fprintf(stderr, "no memory for the mission table\n");
+        return 1;
+    }
+    helpedsurvivors = create_list(sizeof(Survivor), HELPED_HISTORY);
+    drones = create_list(sizeof(Drone *), num_drones);   // Active drones
 
     // Initialize map (depends on survivors list for cells)
-    init_map(40, 30); // Example: 40x30 grid
+    init_map(opt.height, opt.width); // Default: 40x30 grid
+    init_snapshots(map.height, map.width);
+    if (opt.pool > 0 && opt.regions == 0) opt.regions = 1;  // AI as tasks
+    if (opt.regions > 0 && regions_init(opt.regions, num_drones) != 0) {
+        fprintf(stderr, "no memory for %d regions\n", opt.regions);
+        return 1;
+    }
+    if (opt.stream_port && start_stream_server(opt.stream_port) != 0) {
+        return 1;
+    }
+    if (opt.pool > 0 && start_pool(opt.pool) != 0) {
+        fprintf(stderr, "no memory for %d pool workers\n", opt.pool);
+        return 1;
+    }
 
-    // Initialize drones (spawn threads)
+    // Initialize drones (spawn threads, or tasks on the pool)
     initialize_drones();
 
     // Start survivor generator thread
     pthread_t survivor_thread;
-    pthread_create(&survivor_thread, NULL, survivor_generator, NULL);
+    if (pool_workers()) pool_submit(survivor_task, NULL, POOL_ANY);
+    else pthread_create(&survivor_thread, NULL, survivor_generator, NULL);
 
     // Start AI controller thread
     pthread_t ai_thread;
-    pthread_create(&ai_thread, NULL, ai_controller, NULL);
+    if (num_regions) regions_start();
+    else pthread_create(&ai_thread, NULL, ai_controller, NULL);
+
+    if (opt.headless) {
+        run_headless(&opt);
+    } else {
+#ifndef NO_SDL
+        // Publish world snapshots for the view
+        pthread_t snapshot_thread;
+        pthread_create(&snapshot_thread, NULL, snapshot_publisher, NULL);
 
-    // Start SDL visualization
-    init_sdl_window();
-    while (!check_events()) {
-        draw_map();
-        SDL_Delay(100);
+        // Start SDL visualization
+        init_sdl_window(map.height, map.width);
+        while (running && !check_events()) {
+            draw_map();
+            check_metrics();
+            SDL_Delay(100);
+        }
+        running = 0;
+        pthread_join(snapshot_thread, NULL);
+        quit_all();
+#endif
     }
     printf("Exiting...\n");
+    running = 0;
+    if (pool_workers()) {  // drones, generator and AI
+        pool_report(stdout);
+        stop_pool();
+    } else {
+        pthread_join(survivor_thread, NULL);
+    }
+    if (!num_regions) pthread_join(ai_thread, NULL);
+    cleanup_drones();
+    if (num_regions) {  // after the drones, which move between regions
+        regions_report(stdout);
+        regions_stop();
+    }
+    stop_stream_server();
+    log_performance(stdout, num_drones);
+    lockprof_report(stdout, 10);
+    if (opt.trace_path) trace_write(opt.trace_path);
+
     // Cleanup
     freemap();
-    survivors->destroy(survivors);
+    mission_destroy();
     helpedsurvivors->destroy(helpedsurvivors);
     drones->destroy(drones);
-    quit_all();
+    free_snapshots();
     return 0;
-}
\ No newline at end of file
+}
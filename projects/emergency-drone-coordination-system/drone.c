@@ -1,5 +1,10 @@
 #include "headers/drone.h"
 #include "headers/globals.h"
+#include "headers/lockprof.h"
+#include "headers/mission.h"
+#include "headers/pool.h"
+#include "headers/region.h"
+#include "headers/trace.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <pthread.h>
@@ -10,62 +15,104 @@
 // Global drone fleet
 Drone *drone_fleet = NULL;
 int num_drones = 10; // Default fleet size
+static int pooled;    // drones run as pool tasks (pool.h), no threads
+
+static void drone_task(void *arg);
 
 void initialize_drones() {
     drone_fleet = malloc(sizeof(Drone) * num_drones);
+    pooled = pool_workers() > 0;
     srand(time(NULL));
 
     for(int i = 0; i < num_drones; i++) {
         drone_fleet[i].id = i;
+        snprintf(drone_fleet[i].name, sizeof(drone_fleet[i].name), "D%d", i);
+        drone_fleet[i].conn = NULL;  // simulated, no client connection
         drone_fleet[i].status = IDLE;
-        drone_fleet[i].coord = (Coord){rand() % map.width, rand() % map.height};
+        drone_fleet[i].coord = (Coord){rand() % map.height, rand() % map.width};
         drone_fleet[i].target = drone_fleet[i].coord; // Initial target=current position
+        drone_fleet[i].mission_id = 0;
+        drone_fleet[i].region = NULL;
         pthread_mutex_init(&drone_fleet[i].lock, NULL);
         
         //TODO in Phase-2 you should use this for client drones,
-        // Add to global drone list
-        pthread_mutex_lock(&drones->lock);
-        drones->add(drones, &drone_fleet[i]); 
-        pthread_mutex_unlock(&drones->lock);
+        // Add to global drone list. The list stores Drone pointers:
+        // a copy of the struct would not see the drone thread's moves
+        Drone *d = &drone_fleet[i];
+        prof_lock(&drones->lock);
+        drones->add(drones, &d);
+        prof_unlock(&drones->lock);
+        region_track(d);
         
-        // Create thread
-        pthread_create(&drone_fleet[i].thread_id, NULL, drone_behavior, &drone_fleet[i]);
+        // Create thread, or a task spread over the first second
+        if (pooled) pool_after(rand() % 1000, drone_task, d, d->id);
+        else pthread_create(&drone_fleet[i].thread_id, NULL, drone_behavior, &drone_fleet[i]);
     }
 }
 
-void* drone_behavior(void *arg) {
-    Drone *d = (Drone*)arg;
+/* one move of d toward its target, once a second */
+static void drone_step(Drone *d) {
+    int completed = 0, flying = 0;
+    long t = trace_now();
+    prof_lock(&d->lock);
     
-    while(1) {
-        pthread_mutex_lock(&d->lock);
+    if(d->status == ON_MISSION) {
+        flying = d->mission_id;
+        // Move toward target (1 cell per iteration)
+        if(d->coord.x < d->target.x) d->coord.x++;
+        else if(d->coord.x > d->target.x) d->coord.x--;
         
-        if(d->status == ON_MISSION) {
-            // Move toward target (1 cell per iteration)
-            if(d->coord.x < d->target.x) d->coord.x++;
-            else if(d->coord.x > d->target.x) d->coord.x--;
-            
-            if(d->coord.y < d->target.y) d->coord.y++;
-            else if(d->coord.y > d->target.y) d->coord.y--;
+        if(d->coord.y < d->target.y) d->coord.y++;
+        else if(d->coord.y > d->target.y) d->coord.y--;
 
-            // Check mission completion
-            if(d->coord.x == d->target.x && d->coord.y == d->target.y) {
-                d->status = IDLE;
-                printf("Drone %d: Mission completed!\n", d->id);
-            }
+        // Check mission completion
+        if(d->coord.x == d->target.x && d->coord.y == d->target.y) {
+            d->status = IDLE;
+            completed = d->mission_id;
+            d->mission_id = 0;
+            printf("Drone %d: Mission completed!\n", d->id);
         }
-        
-        pthread_mutex_unlock(&d->lock);
+    }
+    
+    prof_unlock(&d->lock);
+    if (flying) {
+        region_track(d);
+        trace_span("drone_tick", t, flying);
+    }
+
+    // missions.lock comes before drone locks
+    Survivor s;
+    t = trace_now();
+    if (completed && mission_complete(completed, d, &s) == 0) {
+        survivor_helped(&s);
+        trace_span("mission_complete", t, completed);
+    }
+}
+
+void* drone_behavior(void *arg) {
+    Drone *d = (Drone*)arg;
+    trace_thread_name("drone");
+    
+    while(running) {
+        drone_step(d);
         sleep(1); // Update every second
     }
     return NULL;
 }
 
-
-
+/* drone_behavior() as a pool task: a step, then again in a second on
+ * the same worker */
+static void drone_task(void *arg) {
+    Drone *d = arg;
+    drone_step(d);
+    if (running) pool_after(1000, drone_task, d, d->id);
+}
 
 void cleanup_drones() {
+    // drone_behavior returns once running is cleared; drone tasks stop
+    // with the pool, before this
     for(int i = 0; i < num_drones; i++) {
-        pthread_cancel(drone_fleet[i].thread_id);
+        if (!pooled) pthread_join(drone_fleet[i].thread_id, NULL);
         pthread_mutex_destroy(&drone_fleet[i].lock);
     }
     free(drone_fleet);
@@ -1,32 +1,271 @@
-/* example drone_client.c 
-* This is a simple drone client that connects to a server and sends its status
-* while receiving navigation commands.
-* You should separate the client implementation from server.
-*/
-#include <sys/socket.h>
-#include <netinet/in.h>
+/* drone_client.c
+ * A drone that connects to the server (server.c), registers with
+ * HANDSHAKE and then follows communication-protocol.md: periodic
+ * STATUS_UPDATE, flies to ASSIGN_MISSION targets one cell per second,
+ * reports MISSION_COMPLETE and answers HEARTBEAT.
+ *
+ * Reads and writes go through framing.c: a recv() may hold part of a
+ * message or several, and everything queued in one loop iteration is
+ * sent with one sendmsg().
+ *
+ * With "udp" the drone asks for the UDP telemetry channel and, if the
+ * server grants it, sends its STATUS_UPDATEs as datagrams. A host of
+ * shm:PATH talks to a server on the same machine through shared memory
+ * (server --shm PATH) instead of TCP.
+ *
+ * usage: drone_client [drone_id=D1] [host=127.0.0.1] [port=8080]
+ *                     [json|binary] [udp]
+ */
 #include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
 #include <stdio.h>
-#include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../headers/framing.h"
+#include "../headers/protocol.h"
+#include "../headers/shm.h"
+#include "../headers/wire.h"
+
+typedef struct {
+    int fd;        // TCP socket, or the unix socket of shm
+    ShmLink *shm;  // NULL over TCP
+    int udp;       // connected UDP socket for telemetry, -1 if none
+    unsigned int telemetry_id, telemetry_key, telemetry_seq;
+    const char *host;
+    int binary;
+    int registered;  // HANDSHAKE_ACK received
+    FrameReader in;
+    OutQueue out;
+    char id[16];
+    Coord coord;
+    Coord target;
+    char mission_id[16];
+    int on_mission;
+    time_t expiry;  // of the mission, 0 for none
+    int battery;
+    int status_interval;
+} Client;
+
+/* queues msg in the negotiated encoding */
+static void queue(Client *cl, const Message *msg) {
+    char buf[MAX_MESSAGE];
+    int len = cl->binary
+                  ? encode_binary(msg, (unsigned char *)buf, sizeof(buf))
+                  : format_message(buf, sizeof(buf), msg);
+    if (len > 0 && len < (int)sizeof(buf)) outq_push(&cl->out, buf, len);
+}
+
+static int connect_to(const char *host, int port, int type);
+
+/* the server granted the UDP channel: one connected socket for it */
+static void open_telemetry(Client *cl, const Message *ack) {
+    cl->udp = connect_to(cl->host, ack->telemetry_port, SOCK_DGRAM);
+    if (cl->udp < 0) {
+        perror("telemetry");
+        return;
+    }
+    cl->telemetry_id = ack->telemetry_id;
+    cl->telemetry_key = ack->telemetry_key;
+    cl->telemetry_seq = 0;
+}
+
+/* STATUS_UPDATE over UDP if the channel is open, else on the connection */
+static void queue_status(Client *cl) {
+    Message msg = {.type = MSG_STATUS_UPDATE,
+                   .timestamp = time(NULL),
+                   .location = cl->coord,
+                   .battery = cl->battery,
+                   .speed = 1};
+    strcpy(msg.drone_id, cl->id);
+    strcpy(msg.status, cl->on_mission ? "busy" : "idle");
+    if (cl->udp >= 0) {
+        unsigned char buf[TELEMETRY_MAX];
+        int len = encode_telemetry(&msg, cl->telemetry_id, cl->telemetry_key,
+                                   ++cl->telemetry_seq, buf, sizeof(buf));
+        if (len > 0) send(cl->udp, buf, len, 0);  // a lost one is replaced
+        return;
+    }
+    queue(cl, &msg);
+}
+
+static void handle(Client *cl, Message *msg) {
+    switch (msg->type) {
+        case MSG_HANDSHAKE_ACK:
+            cl->binary = strcmp(msg->encoding, "binary") == 0;
+            cl->registered = 1;
+            if (msg->status_update_interval > 0)
+                cl->status_interval = msg->status_update_interval;
+            if (msg->telemetry_port > 0) open_telemetry(cl, msg);
+            printf("%s registered, session %s, %s encoding%s\n", cl->id,
+                   msg->session_id, cl->binary ? "binary" : "json",
+                   cl->udp >= 0 ? ", UDP telemetry" : "");
+            queue_status(cl);
+            break;
+        case MSG_ASSIGN_MISSION:
+            cl->target = msg->target;
+            strcpy(cl->mission_id, msg->mission_id);
+            cl->on_mission = 1;
+            cl->expiry = msg->expiry;
+            printf("%s: mission %s to (%d, %d)\n", cl->id, msg->mission_id,
+                   msg->target.x, msg->target.y);
+            break;
+        case MSG_HEARTBEAT: {
+            Message reply = {.type = MSG_HEARTBEAT_RESPONSE,
+                             .timestamp = time(NULL)};
+            strcpy(reply.drone_id, cl->id);
+            queue(cl, &reply);
+            break;
+        }
+        case MSG_CONFIG_UPDATE:  // the next STATUS_UPDATE follows it
+            if (msg->status_update_interval > 0)
+                cl->status_interval = msg->status_update_interval;
+            break;
+        case MSG_ERROR:
+            fprintf(stderr, "%s: server error %d: %s\n", cl->id, msg->code,
+                    msg->error);
+            break;
+        default:
+            break;
+    }
+}
 
-int main() {
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    struct sockaddr_in server_addr = {.sin_family = AF_INET,
-                                      .sin_port = htons(8080),
-                                      .sin_addr.s_addr = inet_addr("127.0.0.1")};
-    connect(sock, (struct sockaddr*)&server_addr, sizeof(server_addr));
-    
+/* one step toward the target per second, like drone_behavior() */
+static void move(Client *cl) {
+    if (!cl->on_mission) return;
+    if (cl->expiry && time(NULL) >= cl->expiry) {
+        // the server took it back and counts this drone as idle
+        cl->on_mission = 0;
+        printf("%s: mission %s expired\n", cl->id, cl->mission_id);
+        queue_status(cl);
+        return;
+    }
+    if (cl->coord.x < cl->target.x) cl->coord.x++;
+    else if (cl->coord.x > cl->target.x) cl->coord.x--;
+    if (cl->coord.y < cl->target.y) cl->coord.y++;
+    else if (cl->coord.y > cl->target.y) cl->coord.y--;
+
+    if (cl->coord.x == cl->target.x && cl->coord.y == cl->target.y) {
+        Message done = {.type = MSG_MISSION_COMPLETE,
+                        .timestamp = time(NULL),
+                        .success = 1};
+        strcpy(done.drone_id, cl->id);
+        strcpy(done.mission_id, cl->mission_id);
+        queue(cl, &done);
+        cl->on_mission = 0;
+        printf("%s: mission %s complete\n", cl->id, cl->mission_id);
+        queue_status(cl);
+    }
+}
+
+static int connect_to(const char *host, int port, int type) {
+    struct sockaddr_in addr = {.sin_family = AF_INET,
+                               .sin_port = htons(port),
+                               .sin_addr.s_addr = inet_addr(host)};
+    int fd = socket(AF_INET, type, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+int main(int argc, char *argv[]) {
+    Client cl = {.udp = -1, .battery = 100, .status_interval = 5};
+    snprintf(cl.id, sizeof(cl.id), "%s", argc > 1 ? argv[1] : "D1");
+    cl.host = argc > 2 ? argv[2] : "127.0.0.1";
+    int port = argc > 3 ? atoi(argv[3]) : SERVER_PORT;
+    int want_binary = argc > 4 && strcmp(argv[4], "binary") == 0;
+    int want_udp = argc > 5 && strcmp(argv[5], "udp") == 0;
+
+    if (strncmp(cl.host, "shm:", 4) == 0) {
+        cl.shm = shm_connect(cl.host + 4, &cl.fd);
+        if (!cl.shm) cl.fd = -1;
+        want_udp = 0;  // no host to send datagrams to
+    } else {
+        cl.fd = connect_to(cl.host, port, SOCK_STREAM);
+    }
+    if (cl.fd < 0) {
+        perror("connect");
+        return 1;
+    }
+    frame_reader_init(&cl.in);
+
+    Message hello = {.type = MSG_HANDSHAKE};
+    strcpy(hello.drone_id, cl.id);
+    strcpy(hello.encoding, want_binary ? "binary" : "json");
+    if (want_udp) strcpy(hello.telemetry, "udp");
+    queue(&cl, &hello);  // always JSON, binary starts after the ACK
+
+    time_t last_move = time(NULL), last_status = last_move;
+    int more = 0;  // shm: the ring may hold more than one read took
     while (1) {
-        // Send status update
-        DroneStatus status = {.x = current_x, .y = current_y, .idle = 1};
-        send(sock, &status, sizeof(status), 0);
-        
-        // Receive mission
-        Coord target;
-        recv(sock, &target, sizeof(target), 0);
-        navigate_to_target(target);
-        
-        sleep(1);
-    }
-}
\ No newline at end of file
+        int flushed = cl.shm ? shm_flush(&cl.out, cl.shm)
+                             : outq_flush(&cl.out, cl.fd);
+        if (flushed != 0) {
+            perror("send");
+            break;
+        }
+        // over shm the socket only reports the hangup, the bell the rest
+        struct pollfd pfd[2] = {
+            {.fd = cl.fd,
+             .events = POLLIN | (cl.out.bytes && !cl.shm ? POLLOUT : 0)},
+            {.fd = cl.shm ? cl.shm->bell : -1, .events = POLLIN}};
+        if (poll(pfd, 2, more ? 0 : 200) < 0 && errno != EINTR) break;
+
+        if (cl.shm && pfd[0].revents) {
+            printf("%s: server closed the connection\n", cl.id);
+            break;
+        }
+        if (cl.shm || (pfd[0].revents & (POLLIN | POLLHUP | POLLERR))) {
+            if (cl.shm && pfd[1].revents) shm_ack_bell(cl.shm);
+            size_t room;
+            char *space = frame_reader_space(&cl.in, &room);
+            ssize_t n = cl.shm ? shm_recv(cl.shm, space, room)
+                               : recv(cl.fd, space, room, 0);
+            int closed = cl.shm ? n < 0
+                                : n == 0 || (n < 0 && errno != EAGAIN &&
+                                             errno != EINTR);
+            if (closed) {
+                printf("%s: server closed the connection\n", cl.id);
+                break;
+            }
+            if (n > 0) frame_reader_commit(&cl.in, n);
+            more = cl.shm && n > 0;
+
+            Message *msg;
+            int rc;
+            while ((rc = frame_next(&cl.in, cl.binary, &msg)) != FRAME_MORE) {
+                if (rc == FRAME_TOO_LONG) break;
+                if (rc == FRAME_MESSAGE) handle(&cl, msg);
+            }
+            if (rc == FRAME_TOO_LONG) {
+                fprintf(stderr, "%s: message too long\n", cl.id);
+                break;
+            }
+        }
+
+        time_t now = time(NULL);
+        if (now > last_move) {
+            move(&cl);
+            last_move = now;
+        }
+        if (cl.registered && now - last_status >= cl.status_interval) {
+            queue_status(&cl);
+            last_status = now;
+        }
+    }
+    outq_free(&cl.out);
+    if (cl.udp >= 0) close(cl.udp);
+    shm_close(cl.shm);
+    close(cl.fd);
+    return 0;
+}
@@ -0,0 +1,641 @@
+/* loadgen.c
+ * Load generator for server.c: thousands of drones in one process, all
+ * on non-blocking sockets served by one epoll loop. Each drone follows
+ * communication-protocol.md like drone_client.c does: HANDSHAKE,
+ * periodic STATUS_UPDATE, flying to ASSIGN_MISSION targets, reporting
+ * MISSION_COMPLETE and answering HEARTBEAT. In addition each drone
+ * sends a HEARTBEAT of its own now and then and times the server's
+ * HEARTBEAT_RESPONSE, which gives the round-trip latency under load.
+ *
+ * Per-drone deadlines (next status, next step, next ping) sit on a
+ * timer wheel (timer.c), messages go through framing.c, and everything
+ * a drone queued in one loop iteration leaves in one sendmsg().
+ * With --udp the drones ask for the UDP telemetry channel and send
+ * their STATUS_UPDATEs as datagrams from one shared socket. With
+ * --shm PATH they reach a server on this host through shared memory
+ * (server --shm PATH) instead of TCP.
+ *
+ * usage: loadgen [--drones N] [--seconds S] [--host ADDR] [--port P]
+ *                [--binary] [--connect-rate N] [--status-interval MS]
+ *                [--ping-interval MS] [--speed CELLS] [--map HxW]
+ *                [--id-base N] [--udp] [--shm PATH]
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../headers/framing.h"
+#include "../headers/protocol.h"
+#include "../headers/shm.h"
+#include "../headers/timer.h"
+#include "../headers/wire.h"
+
+#define TICK_MS 10
+#define MAX_EVENTS 256
+
+typedef enum { CONNECTING, HANDSHAKE, READY, CLOSED } State;
+
+typedef struct sim_drone {
+    int fd;
+    ShmLink *shm;                   // --shm, fd is then its unix socket
+    State state;
+    int binary;
+    FrameReader in;
+    OutQueue out;
+    int dirty;                      // on the flush list
+    struct sim_drone *next_dirty;
+    char id[16];
+    Coord coord, target;
+    char mission_id[16];
+    int on_mission;
+    time_t expiry;                  // of the mission, 0 for none
+    int status_ms;                  // STATUS_UPDATE interval
+    struct sockaddr_in telemetry;   // UDP channel, sin_port 0 if none
+    unsigned int telemetry_id, telemetry_key, telemetry_seq;
+    long handshake_at, ping_at;     // µs, 0 if no reply is due
+    Timer status_timer, move_timer, ping_timer;
+} SimDrone;
+
+/* latency samples in µs; sorted copies give the percentiles */
+typedef struct samples {
+    long *v;
+    long n, cap;
+} Samples;
+
+typedef struct options {
+    int drones, seconds, port, binary, udp;
+    const char *host;
+    const char *shm_path;  // NULL: TCP
+    int connect_rate;     // new connections per second
+    int status_ms;        // 0: what HANDSHAKE_ACK says
+    int ping_ms;          // 0: no pings
+    int speed;            // cells per second
+    int id_base;          // drone ids are D<id_base + i>
+    int height, width;
+} Options;
+
+static Options opt = {.drones = 1000, .seconds = 30, .port = SERVER_PORT,
+                      .host = "127.0.0.1", .connect_rate = 1000,
+                      .ping_ms = 1000, .speed = 1, .height = 40, .width = 30};
+
+static struct {
+    long connected, acked, sent, received, heartbeats, config_updates;
+    long status, datagrams, datagrams_dropped;  // STATUS_UPDATEs, over UDP
+    long assigned, completed, expired;
+    // errors
+    long connect_failed, disconnected, invalid, send_failed;
+    long err_400, err_404, err_503, err_other;
+} st;
+
+static Samples handshake_rtt, ping_rtt;
+static TimerWheel wheel;
+static SimDrone *dirty_list;
+static struct sockaddr_in server;
+static int epfd;
+static int udp_sock = -1;  // --udp: shared by all drones
+static long start_us;
+static volatile sig_atomic_t stopping;
+
+static long now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+static unsigned long tick_now() {
+    return (now_us() - start_us) / (TICK_MS * 1000);
+}
+
+static void stop(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+static void sample(Samples *s, long us) {
+    if (s->n == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 4096;
+        s->v = realloc(s->v, s->cap * sizeof(long));
+    }
+    s->v[s->n++] = us;
+}
+
+static int cmp_long(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+/* p in [0, 1] of samples [from, s->n), sorted by sort_from() */
+static double percentile(Samples *s, long from, double p) {
+    long n = s->n - from;
+    if (n <= 0) return 0;
+    return s->v[from + (long)(p * (n - 1))] / 1000.0;  // ms
+}
+
+static void sort_from(Samples *s, long from) {
+    if (s->n > from) qsort(s->v + from, s->n - from, sizeof(long), cmp_long);
+}
+
+static void mark_dirty(SimDrone *d) {
+    if (d->dirty) return;
+    d->dirty = 1;
+    d->next_dirty = dirty_list;
+    dirty_list = d;
+}
+
+/* queues msg in the negotiated encoding */
+static void queue(SimDrone *d, const Message *msg) {
+    char buf[MAX_MESSAGE];
+    int len = d->binary
+                  ? encode_binary(msg, (unsigned char *)buf, sizeof(buf))
+                  : format_message(buf, sizeof(buf), msg);
+    if (len <= 0 || len >= (int)sizeof(buf)) return;
+    if (outq_push(&d->out, buf, len) != 0) {
+        st.send_failed++;
+        return;
+    }
+    st.sent++;
+    mark_dirty(d);
+}
+
+static void queue_status(SimDrone *d) {
+    Message msg = {.type = MSG_STATUS_UPDATE,
+                   .timestamp = time(NULL),
+                   .location = d->coord,
+                   .battery = 100,
+                   .speed = opt.speed};
+    strcpy(msg.drone_id, d->id);
+    strcpy(msg.status, d->on_mission ? "busy" : "idle");
+    st.status++;
+    if (d->telemetry.sin_port) {
+        unsigned char buf[TELEMETRY_MAX];
+        int len = encode_telemetry(&msg, d->telemetry_id, d->telemetry_key,
+                                   ++d->telemetry_seq, buf, sizeof(buf));
+        if (len <= 0) return;
+        // a full socket buffer loses the update, like the network would
+        if (sendto(udp_sock, buf, len, 0, (struct sockaddr *)&d->telemetry,
+                   sizeof(d->telemetry)) != len) {
+            st.datagrams_dropped++;
+            return;
+        }
+        st.sent++;
+        st.datagrams++;
+        return;
+    }
+    queue(d, &msg);
+}
+
+static void drop(SimDrone *d) {
+    if (d->state == CLOSED) return;
+    if (d->state != CONNECTING) st.disconnected++;
+    d->state = CLOSED;
+    timer_del(&wheel, &d->status_timer);
+    timer_del(&wheel, &d->move_timer);
+    timer_del(&wheel, &d->ping_timer);
+    close(d->fd);  // also leaves the epoll set
+    shm_close(d->shm);
+    d->shm = NULL;
+    outq_free(&d->out);
+}
+
+/* epoll data of an shm drone's socket: the pointer with the low bit set,
+ * its events are the server's hangup */
+#define SHM_SOCKET(d) ((void *)((uintptr_t)(d) | 1))
+
+static void connected(SimDrone *d);
+static void read_drone(SimDrone *d);
+
+/* over shared memory the setup finishes in shm_connect() */
+static void open_shm(SimDrone *d) {
+    d->shm = shm_connect(opt.shm_path, &d->fd);
+    if (!d->shm) {
+        st.connect_failed++;
+        d->state = CLOSED;
+        return;
+    }
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLRDHUP | EPOLLET,
+                             .data.ptr = SHM_SOCKET(d)};
+    epoll_ctl(epfd, EPOLL_CTL_ADD, d->fd, &ev);
+    ev.data.ptr = d;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, d->shm->bell, &ev);
+    d->state = CONNECTING;
+    connected(d);
+    read_drone(d);  // finds the ring empty and asks for the bell
+}
+
+static void open_drone(SimDrone *d, int i) {
+    snprintf(d->id, sizeof(d->id), "D%d", opt.id_base + i);
+    d->coord = (Coord){rand() % opt.height, rand() % opt.width};
+    d->status_timer.data = d->move_timer.data = d->ping_timer.data = d;
+    frame_reader_init(&d->in);
+    if (opt.shm_path) {
+        open_shm(d);
+        return;
+    }
+
+    d->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (d->fd < 0 || (connect(d->fd, (struct sockaddr *)&server,
+                              sizeof(server)) < 0 &&
+                      errno != EINPROGRESS)) {
+        st.connect_failed++;
+        if (d->fd >= 0) close(d->fd);
+        d->state = CLOSED;
+        return;
+    }
+    d->state = CONNECTING;
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT | EPOLLET,
+                             .data.ptr = d};
+    epoll_ctl(epfd, EPOLL_CTL_ADD, d->fd, &ev);
+}
+
+/* the connect() finished, successfully or not */
+static void connected(SimDrone *d) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(d->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    if (err) {
+        st.connect_failed++;
+        drop(d);
+        return;
+    }
+    st.connected++;
+    d->state = HANDSHAKE;
+    Message hello = {.type = MSG_HANDSHAKE};
+    strcpy(hello.drone_id, d->id);
+    strcpy(hello.encoding, opt.binary ? "binary" : "json");
+    if (opt.udp) strcpy(hello.telemetry, "udp");
+    queue(d, &hello);  // always JSON, binary starts after the ACK
+    d->handshake_at = now_us();
+}
+
+static void handle(SimDrone *d, Message *msg) {
+    long now = now_us();
+    switch (msg->type) {
+        case MSG_HANDSHAKE_ACK:
+            if (d->state != HANDSHAKE) break;
+            sample(&handshake_rtt, now - d->handshake_at);
+            st.acked++;
+            d->state = READY;
+            d->binary = strcmp(msg->encoding, "binary") == 0;
+            if (msg->telemetry_port > 0) {
+                d->telemetry = server;
+                d->telemetry.sin_port = htons(msg->telemetry_port);
+                d->telemetry_id = msg->telemetry_id;
+                d->telemetry_key = msg->telemetry_key;
+            }
+            d->status_ms = opt.status_ms ? opt.status_ms
+                           : msg->status_update_interval > 0
+                               ? msg->status_update_interval * 1000
+                               : 5000;
+            queue_status(d);
+            // spread the drones over the intervals
+            timer_add(&wheel, &d->status_timer,
+                      tick_now() + 1 + rand() % (d->status_ms / TICK_MS + 1));
+            if (opt.ping_ms)
+                timer_add(&wheel, &d->ping_timer,
+                          tick_now() + 1 + rand() % (opt.ping_ms / TICK_MS + 1));
+            break;
+        case MSG_ASSIGN_MISSION:
+            st.assigned++;
+            d->target = msg->target;
+            strcpy(d->mission_id, msg->mission_id);
+            d->on_mission = 1;
+            d->expiry = msg->expiry;
+            timer_add(&wheel, &d->move_timer,
+                      tick_now() + 1000 / opt.speed / TICK_MS);
+            break;
+        case MSG_HEARTBEAT: {
+            st.heartbeats++;
+            Message reply = {.type = MSG_HEARTBEAT_RESPONSE,
+                             .timestamp = time(NULL)};
+            strcpy(reply.drone_id, d->id);
+            queue(d, &reply);
+            break;
+        }
+        case MSG_CONFIG_UPDATE: {
+            st.config_updates++;
+            if (opt.status_ms || msg->status_update_interval <= 0) break;
+            d->status_ms = msg->status_update_interval * 1000;
+            // a shorter interval applies now, a longer one after the
+            // next STATUS_UPDATE
+            unsigned long due = tick_now() + d->status_ms / TICK_MS;
+            if (timer_pending(&d->status_timer) && d->status_timer.expires > due) {
+                timer_del(&wheel, &d->status_timer);
+                timer_add(&wheel, &d->status_timer, due);
+            }
+            break;
+        }
+        case MSG_HEARTBEAT_RESPONSE:  // answer to our ping
+            if (d->ping_at) sample(&ping_rtt, now - d->ping_at);
+            d->ping_at = 0;
+            break;
+        case MSG_ERROR:
+            if (msg->code == 400) st.err_400++;
+            else if (msg->code == 404) st.err_404++;
+            else if (msg->code == 503) st.err_503++;
+            else st.err_other++;
+            break;
+        default:
+            break;
+    }
+}
+
+/* one cell toward the target, like drone_client.c */
+static void step(SimDrone *d) {
+    if (d->expiry && time(NULL) >= d->expiry) {
+        // the server took it back and counts this drone as idle
+        d->on_mission = 0;
+        st.expired++;
+        queue_status(d);
+        return;
+    }
+    if (d->coord.x < d->target.x) d->coord.x++;
+    else if (d->coord.x > d->target.x) d->coord.x--;
+    if (d->coord.y < d->target.y) d->coord.y++;
+    else if (d->coord.y > d->target.y) d->coord.y--;
+
+    if (d->coord.x == d->target.x && d->coord.y == d->target.y) {
+        Message done = {.type = MSG_MISSION_COMPLETE,
+                        .timestamp = time(NULL),
+                        .success = 1};
+        strcpy(done.drone_id, d->id);
+        strcpy(done.mission_id, d->mission_id);
+        queue(d, &done);
+        d->on_mission = 0;
+        st.completed++;
+        queue_status(d);
+        return;
+    }
+    timer_add(&wheel, &d->move_timer, wheel.now + 1000 / opt.speed / TICK_MS);
+}
+
+static void fire(Timer *t, void *arg) {
+    (void)arg;
+    SimDrone *d = t->data;
+    if (d->state != READY) return;
+    if (t == &d->status_timer) {
+        queue_status(d);
+        timer_add(&wheel, t, wheel.now + d->status_ms / TICK_MS);
+    } else if (t == &d->move_timer) {
+        if (d->on_mission) step(d);
+    } else {
+        if (!d->ping_at) {  // one ping in flight per drone
+            Message ping = {.type = MSG_HEARTBEAT, .timestamp = time(NULL)};
+            queue(d, &ping);
+            d->ping_at = now_us();
+        }
+        timer_add(&wheel, t, wheel.now + opt.ping_ms / TICK_MS);
+    }
+}
+
+static void read_drone(SimDrone *d) {
+    while (d->state != CLOSED) {
+        size_t room;
+        char *space = frame_reader_space(&d->in, &room);
+        ssize_t n;
+        if (d->shm) {  // empty: the bell rings when the server writes
+            n = shm_recv(d->shm, space, room);
+            if (n == 0) return;
+            if (n < 0) {  // a corrupted ring, errno is not set
+                drop(d);
+                return;
+            }
+        } else {
+            n = recv(d->fd, space, room, 0);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                drop(d);
+                return;
+            }
+        }
+        frame_reader_commit(&d->in, n);
+
+        Message *msg;
+        int rc;
+        while ((rc = frame_next(&d->in, d->binary, &msg)) != FRAME_MORE) {
+            if (rc == FRAME_TOO_LONG) {
+                st.invalid++;
+                drop(d);
+                return;
+            }
+            if (rc == FRAME_INVALID) {
+                st.invalid++;
+                continue;
+            }
+            st.received++;
+            handle(d, msg);
+        }
+    }
+}
+
+static void flush_dirty() {
+    while (dirty_list) {
+        SimDrone *d = dirty_list;
+        dirty_list = d->next_dirty;
+        d->dirty = 0;
+        // the rest goes when EPOLLOUT says there is room
+        if (d->state != CLOSED && d->state != CONNECTING &&
+            (d->shm ? shm_flush(&d->out, d->shm)
+                    : outq_flush(&d->out, d->fd)) != 0) {
+            st.send_failed++;
+            drop(d);
+        }
+    }
+}
+
+static long errors() {
+    return st.connect_failed + st.disconnected + st.invalid + st.send_failed +
+           st.err_400 + st.err_404 + st.err_503 + st.err_other;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [--drones N] [--seconds S] [--host ADDR] [--port P]\n"
+            "          [--binary] [--connect-rate N] [--status-interval MS]\n"
+            "          [--ping-interval MS] [--speed CELLS] [--map HxW]\n"
+            "          [--id-base N] [--udp] [--shm PATH]\n",
+            prog);
+}
+
+static int parse_options(int argc, char *argv[]) {
+    static struct option longopts[] = {
+        {"drones", required_argument, NULL, 'n'},
+        {"seconds", required_argument, NULL, 's'},
+        {"host", required_argument, NULL, 'h'},
+        {"port", required_argument, NULL, 'p'},
+        {"binary", no_argument, NULL, 'b'},
+        {"connect-rate", required_argument, NULL, 'c'},
+        {"status-interval", required_argument, NULL, 'u'},
+        {"ping-interval", required_argument, NULL, 'i'},
+        {"speed", required_argument, NULL, 'v'},
+        {"map", required_argument, NULL, 'm'},
+        {"id-base", required_argument, NULL, 'd'},
+        {"udp", no_argument, NULL, 'U'},
+        {"shm", required_argument, NULL, 'S'},
+        {NULL, 0, NULL, 0}};
+    int c;
+    while ((c = getopt_long(argc, argv, "n:s:h:p:bc:u:i:v:m:d:US:", longopts,
+                            NULL)) != -1) {
+        switch (c) {
+            case 'n': opt.drones = atoi(optarg); break;
+            case 's': opt.seconds = atoi(optarg); break;
+            case 'h': opt.host = optarg; break;
+            case 'p': opt.port = atoi(optarg); break;
+            case 'b': opt.binary = 1; break;
+            case 'c': opt.connect_rate = atoi(optarg); break;
+            case 'u': opt.status_ms = atoi(optarg); break;
+            case 'i': opt.ping_ms = atoi(optarg); break;
+            case 'v': opt.speed = atoi(optarg); break;
+            case 'd': opt.id_base = atoi(optarg); break;
+            case 'U': opt.udp = 1; break;
+            case 'S': opt.shm_path = optarg; break;
+            case 'm':
+                if (sscanf(optarg, "%dx%d", &opt.height, &opt.width) != 2)
+                    return -1;
+                break;
+            default: return -1;
+        }
+    }
+    if (opt.drones < 1 || opt.seconds < 1 || opt.connect_rate < 1 ||
+        opt.speed < 1 || opt.height < 1 || opt.width < 1)
+        return -1;
+    if (opt.status_ms && opt.status_ms < TICK_MS) opt.status_ms = TICK_MS;
+    if (opt.ping_ms && opt.ping_ms < TICK_MS) opt.ping_ms = TICK_MS;
+    if (opt.speed > 1000 / TICK_MS) opt.speed = 1000 / TICK_MS;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (parse_options(argc, argv) != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    server = (struct sockaddr_in){.sin_family = AF_INET,
+                                  .sin_port = htons(opt.port),
+                                  .sin_addr.s_addr = inet_addr(opt.host)};
+    SimDrone *fleet = calloc(opt.drones, sizeof(SimDrone));
+    epfd = epoll_create1(0);
+    if (opt.udp) {
+        udp_sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        int sndbuf = 4 << 20;
+        setsockopt(udp_sock, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    }
+    start_us = now_us();
+    wheel_init(&wheel, 0);
+
+    struct epoll_event events[MAX_EVENTS];
+    int opened = 0;
+    long last_report = start_us, end = start_us + opt.seconds * 1000000L;
+    long report_sent = 0, report_received = 0, report_ping = 0;
+    while (!stopping && now_us() < end) {
+        // connect at the configured rate, the accept queue is finite
+        long due = (now_us() - start_us) * opt.connect_rate / 1000000 + 1;
+        for (; opened < opt.drones && opened < due; opened++)
+            open_drone(&fleet[opened], opened);
+
+        int n = epoll_wait(epfd, events, MAX_EVENTS, TICK_MS);
+        for (int i = 0; i < n; i++) {
+            SimDrone *d = events[i].data.ptr;
+            if ((uintptr_t)d & 1) {  // an shm socket: the server hung up
+                drop((SimDrone *)((uintptr_t)d & ~(uintptr_t)1));
+                continue;
+            }
+            if (d->shm) {  // its bell: data for us or room for ours
+                shm_ack_bell(d->shm);
+                mark_dirty(d);
+                read_drone(d);
+                continue;
+            }
+            if (d->state == CONNECTING) {
+                connected(d);
+                if (d->state == CLOSED) continue;
+            }
+            if (events[i].events & EPOLLOUT) mark_dirty(d);
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                read_drone(d);
+        }
+        wheel_advance(&wheel, tick_now(), fire, NULL);
+        flush_dirty();
+
+        long t = now_us();
+        if (t - last_report >= 1000000) {
+            double secs = (t - last_report) / 1e6;
+            sort_from(&ping_rtt, report_ping);
+            printf("connected: %ld  acked: %ld  sent/s: %.0f  "
+                   "received/s: %.0f  rtt p50/p99: %.2f/%.2f ms  "
+                   "missions: %ld/%ld  errors: %ld\n",
+                   st.connected, st.acked, (st.sent - report_sent) / secs,
+                   (st.received - report_received) / secs,
+                   percentile(&ping_rtt, report_ping, 0.50),
+                   percentile(&ping_rtt, report_ping, 0.99), st.completed,
+                   st.assigned, errors());
+            report_sent = st.sent;
+            report_received = st.received;
+            report_ping = ping_rtt.n;
+            last_report = t;
+        }
+    }
+
+    double secs = (now_us() - start_us) / 1e6;
+    sort_from(&handshake_rtt, 0);
+    sort_from(&ping_rtt, 0);
+    printf("\n%d drones, %.1f s, %s encoding%s\n", opt.drones, secs,
+           opt.binary ? "binary" : "json", opt.udp ? ", UDP telemetry" : "");
+    printf("connected %ld, registered %ld\n", st.connected, st.acked);
+    printf("sent      %ld messages (%.1f/s)\n", st.sent, st.sent / secs);
+    printf("status    %ld updates, %ld as datagrams, %ld datagrams dropped\n",
+           st.status, st.datagrams, st.datagrams_dropped);
+    printf("received  %ld messages (%.1f/s), %ld heartbeats answered, "
+           "%ld config updates\n",
+           st.received, st.received / secs, st.heartbeats, st.config_updates);
+    printf("missions  %ld assigned, %ld completed, %ld expired\n",
+           st.assigned, st.completed, st.expired);
+    printf("handshake p50 %.2f  p90 %.2f  p99 %.2f  max %.2f ms\n",
+           percentile(&handshake_rtt, 0, 0.50),
+           percentile(&handshake_rtt, 0, 0.90),
+           percentile(&handshake_rtt, 0, 0.99),
+           percentile(&handshake_rtt, 0, 1.0));
+    printf("round-trip p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  "
+           "max %.2f ms (%ld pings)\n",
+           percentile(&ping_rtt, 0, 0.50), percentile(&ping_rtt, 0, 0.90),
+           percentile(&ping_rtt, 0, 0.99), percentile(&ping_rtt, 0, 0.999),
+           percentile(&ping_rtt, 0, 1.0), ping_rtt.n);
+    printf("errors    %ld: connect %ld, disconnected %ld, invalid %ld, "
+           "send %ld, 400: %ld, 404: %ld, 503: %ld, other %ld\n",
+           errors(), st.connect_failed, st.disconnected, st.invalid,
+           st.send_failed, st.err_400, st.err_404, st.err_503, st.err_other);
+
+    for (int i = 0; i < opened; i++) {
+        if (fleet[i].state == CLOSED) continue;
+        close(fleet[i].fd);
+        shm_close(fleet[i].shm);
+        outq_free(&fleet[i].out);
+    }
+    close(epfd);
+    if (udp_sock >= 0) close(udp_sock);
+    free(fleet);
+    free(handshake_rtt.v);
+    free(ping_rtt.v);
+    return errors() != 0;
+}
@@ -0,0 +1,173 @@
+/**
+ * @file framing.c
+ * @brief splits a byte stream into protocol messages and queues
+ * outgoing ones, see framing.h.
+ *
+ * TCP gives no message boundaries: one recv() may hold half a message
+ * or several, and one send() may take only part of what it is given.
+ * The reader keeps the unparsed tail between calls; JSON is fed to the
+ * incremental parser as it arrives, a binary frame waits in the buffer
+ * until its length prefix is satisfied. The writer keeps unsent bytes
+ * in a list of blocks, so a partial write never moves data and all
+ * messages queued since the last flush leave in a single writev().
+ */
+#include "headers/framing.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "headers/wire.h"
+
+void frame_reader_init(FrameReader *fr) {
+    fr->start = fr->len = 0;
+    json_init(&fr->parser, &fr->msg);
+}
+
+/**
+ * @brief free space at the end of the buffer for the next recv()
+ * @param room set to the bytes that fit there
+ */
+char *frame_reader_space(FrameReader *fr, size_t *room) {
+    if (fr->start > 0) {  // only a partial binary frame is left
+        memmove(fr->buf, fr->buf + fr->start, fr->len - fr->start);
+        fr->len -= fr->start;
+        fr->start = 0;
+    }
+    *room = sizeof(fr->buf) - fr->len;
+    return fr->buf + fr->len;
+}
+
+/* n bytes were received into frame_reader_space() */
+void frame_reader_commit(FrameReader *fr, size_t n) {
+    fr->len += n;
+}
+
+/**
+ * @brief cuts the next message out of the buffered bytes
+ * @param binary framing of the connection; may change between calls
+ * (after HANDSHAKE), the bytes after a message are not looked at yet
+ * @param msg set to the parsed message, valid until the next call
+ * @return int: FRAME_MESSAGE, FRAME_MORE, FRAME_INVALID or FRAME_TOO_LONG
+ */
+int frame_next(FrameReader *fr, int binary, Message **msg) {
+    while (fr->start < fr->len) {
+        char *data = fr->buf + fr->start;
+        size_t avail = fr->len - fr->start;
+
+        if (binary) {
+            int frame = binary_frame_length((unsigned char *)data, avail);
+            if (frame < 0) return FRAME_TOO_LONG;
+            if (frame == 0 || (size_t)frame > avail) return FRAME_MORE;
+            fr->start += frame;
+            if (decode_binary((unsigned char *)data + WIRE_HEADER,
+                              frame - WIRE_HEADER, &fr->msg) != 0)
+                return FRAME_INVALID;
+            *msg = &fr->msg;
+            return FRAME_MESSAGE;
+        }
+
+        size_t used;
+        int rc = json_feed(&fr->parser, data, avail, &used);
+        fr->start += used;
+        if (rc == JSON_TOO_LONG) return FRAME_TOO_LONG;
+        if (rc == JSON_INVALID) return FRAME_INVALID;
+        if (rc == JSON_DONE) {
+            *msg = &fr->msg;
+            return FRAME_MESSAGE;
+        }
+    }
+    // everything is parsed (JSON keeps its state in the parser)
+    fr->start = fr->len = 0;
+    return FRAME_MORE;
+}
+
+static OutBlock *new_block() {
+    OutBlock *b = malloc(sizeof(OutBlock));
+    if (!b) return NULL;
+    b->next = NULL;
+    b->start = b->end = 0;
+    return b;
+}
+
+/**
+ * @brief appends one message to the queue (copied)
+ * @return int: 0 on success, -1 if out of memory
+ */
+int outq_push(OutQueue *q, const char *data, size_t len) {
+    while (len > 0) {
+        OutBlock *b = q->tail;
+        if (!b || b->end == OUT_BLOCK) {
+            if (!(b = new_block())) return -1;
+            if (q->tail) q->tail->next = b;
+            else q->head = b;
+            q->tail = b;
+        }
+        size_t n = OUT_BLOCK - b->end < len ? OUT_BLOCK - b->end : len;
+        memcpy(b->data + b->end, data, n);
+        b->end += n;
+        q->bytes += n;
+        data += n;
+        len -= n;
+    }
+    q->messages++;
+    return 0;
+}
+
+/* drops n sent bytes from the head, e.g. after an io_uring SEND */
+void outq_consume(OutQueue *q, size_t n) {
+    q->bytes -= n;
+    while (n > 0) {
+        OutBlock *b = q->head;
+        size_t chunk = b->end - b->start < n ? b->end - b->start : n;
+        b->start += chunk;
+        n -= chunk;
+        if (b->start < b->end) break;
+        q->head = b->next;
+        if (!q->head) q->tail = NULL;
+        free(b);  // idle connections hold no blocks
+    }
+}
+
+/**
+ * @brief writes as much of the queue as the socket takes with one
+ * gathering write per FLUSH_IOV blocks
+ * @return int: 0 if the queue is empty or the socket is full (retry on
+ * EPOLLOUT/POLLOUT), -1 if the connection is broken
+ */
+int outq_flush(OutQueue *q, int fd) {
+    while (q->head) {
+        struct iovec iov[FLUSH_IOV];
+        int n = 0;
+        size_t total = 0;
+        for (OutBlock *b = q->head; b && n < FLUSH_IOV; b = b->next) {
+            iov[n].iov_base = b->data + b->start;
+            iov[n].iov_len = b->end - b->start;
+            total += iov[n++].iov_len;
+        }
+        // sendmsg() is writev() with MSG_NOSIGNAL: EPIPE, not SIGPIPE
+        struct msghdr mh = {.msg_iov = iov, .msg_iovlen = n};
+        ssize_t sent = sendmsg(fd, &mh, MSG_NOSIGNAL);
+        q->writes++;
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        outq_consume(q, sent);
+        if ((size_t)sent < total) return 0;  // socket buffer is full
+    }
+    return 0;
+}
+
+void outq_free(OutQueue *q) {
+    while (q->head) {
+        OutBlock *b = q->head;
+        q->head = b->next;
+        free(b);
+    }
+    q->tail = NULL;
+    q->bytes = 0;
+}
@@ -3,8 +3,15 @@
 
 #include "drone.h"
 #include "survivor.h"
+#include "mission.h"
 
 // AI Mission Assignment
+int assign_mission(Drone *drone, Mission *m);
+Drone *find_closest_idle_drone(Coord target);
 void* ai_controller(void *args);
 
+// Called with drone->lock held when a mission is assigned; the server
+// sets it to send ASSIGN_MISSION to the drone
+extern void (*mission_hook)(Drone *drone, const Mission *m);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stddef.h>
+#include "snapshot.h"
+
+#define FRAME_MAGIC "DRFR"
+#define FRAME_VERSION 1
+#define VARINT_MAX 5  // bytes for a 32 bit value
+
+/* zigzag maps signed to unsigned so small negative deltas stay small */
+static inline unsigned int zigzag(int v) {
+    return ((unsigned int)v << 1) ^ (unsigned int)(v >> 31);
+}
+static inline int unzigzag(unsigned int v) {
+    return (int)(v >> 1) ^ -(int)(v & 1);
+}
+
+int put_varint(unsigned char *buf, unsigned int v);
+int get_varint(const unsigned char *buf, size_t len, unsigned int *v);
+
+size_t rle_encode(const unsigned char *cells, int n, unsigned char *buf);
+int rle_decode(const unsigned char *buf, size_t len, unsigned char *cells,
+               int n);
+
+size_t frame_max_size(int height, int width, int num_drones);
+size_t encode_frame(const WorldSnapshot *snap, unsigned char *buf);
+int decode_frame(const unsigned char *buf, size_t len,
+                 WorldSnapshot *dest);
+
+#endif
@@ -13,13 +13,24 @@ typedef enum {
 } DroneStatus;
 
 
+struct conn;  // reactor.h
+struct region;  // region.h
+
 typedef struct drone {
     int id;
+    char name[16];          // protocol drone_id, e.g. "D1" (server only)
+    struct conn *conn;      // NULL for simulated or disconnected drones
     pthread_t thread_id;
     int status;             // IDLE, ON_MISSION, DISCONNECTED
     Coord coord;
     Coord target;
+    int mission_id;         // mission table entry (mission.h), 0 if none
     struct tm last_update;
+    time_t last_status;     // last STATUS_UPDATE taken (server, shedding)
+    int status_interval;    // last status_update_interval sent (server)
+    unsigned int telemetry_key;  // UDP session key, 0 if none (server)
+    unsigned int telemetry_seq;  // last UDP STATUS_UPDATE taken (server)
+    struct region *region;  // region.c drone list it is in, NULL: none
     pthread_mutex_t lock;   // Per-drone mutex
 } Drone;
 
@@ -30,5 +41,6 @@ extern int num_drones;    // Number of drones in the fleet
 // Functions
 void initialize_drones();
 void* drone_behavior(void *arg);
+void cleanup_drones();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef FRAMING_H
+#define FRAMING_H
+
+#include <stddef.h>
+#include "json.h"
+#include "protocol.h"
+
+/* Message framing on a stream socket, shared by server and clients.
+ * Inbound: bytes from any number of recv() calls are cut into
+ * newline-delimited JSON messages or length-prefixed binary frames
+ * (wire.h). Outbound: messages are queued in blocks and written with
+ * one writev() per flush, partial writes stay queued. */
+
+/* frame_next results */
+#define FRAME_MORE 0       // no complete message buffered
+#define FRAME_MESSAGE 1    // *msg holds the next message
+#define FRAME_INVALID -1   // malformed message dropped, reading continues
+#define FRAME_TOO_LONG -2  // longer than MAX_MESSAGE, close the connection
+
+typedef struct frame_reader {
+    char buf[MAX_MESSAGE];  // received bytes not yet parsed
+    size_t start, len;      // parsed up to start, filled up to len
+    JsonParser parser;      // JSON message in progress, into msg
+    Message msg;
+} FrameReader;
+
+void frame_reader_init(FrameReader *fr);
+char *frame_reader_space(FrameReader *fr, size_t *room);
+void frame_reader_commit(FrameReader *fr, size_t n);
+int frame_next(FrameReader *fr, int binary, Message **msg);
+
+#define OUT_BLOCK 4096
+#define FLUSH_IOV 64  // blocks per writev()
+
+typedef struct out_block {
+    struct out_block *next;
+    size_t start, end;  // unsent bytes are data[start..end)
+    char data[OUT_BLOCK];
+} OutBlock;
+
+typedef struct out_queue {
+    OutBlock *head, *tail;
+    size_t bytes;     // queued and not yet sent
+    long messages;    // queued since start
+    long writes;      // writev() calls since start
+} OutQueue;
+
+int outq_push(OutQueue *q, const char *data, size_t len);
+int outq_flush(OutQueue *q, int fd);
+void outq_consume(OutQueue *q, size_t n);
+void outq_free(OutQueue *q);
+
+#endif
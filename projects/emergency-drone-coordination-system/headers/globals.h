@@ -6,8 +6,10 @@
 #include "survivor.h"
 #include "list.h"
 #include "coord.h"
+#include <signal.h>
 
 extern Map map;
-extern List *survivors, *helpedsurvivors, *drones;
+extern List *helpedsurvivors, *drones;
+extern volatile sig_atomic_t running;  // threads exit when cleared
 
 #endif
\ No newline at end of file
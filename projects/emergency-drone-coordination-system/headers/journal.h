@@ -0,0 +1,39 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "drone.h"
+#include "mission.h"
+#include "survivor.h"
+
+/* counters since journal_open() */
+typedef struct journal_stats {
+    long records;      // committed
+    long commits;      // write() + fdatasync() pairs
+    long bytes;        // written to the journal
+    long checkpoints;  // written, including the one after recovery
+    long replayed;     // journal records read back by recovery
+    long dropped;      // records lost for want of memory
+    long failures;     // commits that did not reach the disk
+} JournalStats;
+
+extern JournalStats journal_stats;
+
+/* installs the recovered state, called by journal_open() before the
+ * writer starts; drones come in id order */
+typedef struct journal_restore {
+    void (*drone)(const char *name, Coord coord);
+    void (*mission)(int id, const Survivor *s);
+    void (*helped)(const Survivor *s);
+} JournalRestore;
+
+int journal_open(const char *dir, int mission_capacity, int max_drones,
+                 const JournalRestore *restore);
+void journal_close();
+void journal_sync();
+
+/* record a change; no-ops while the journal is not open */
+void journal_mission(MissionEvent e, const Mission *m);  // missions.lock held
+void journal_drone(const Drone *d);                      // first HANDSHAKE
+void journal_disconnect(const Drone *d);
+
+#endif
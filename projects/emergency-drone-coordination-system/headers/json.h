@@ -0,0 +1,41 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stddef.h>
+#include "protocol.h"
+
+#define JSON_MAX_DEPTH 8
+#define JSON_MAX_KEY 32
+
+/* json_feed results */
+#define JSON_MORE 0       // input used up, message not complete yet
+#define JSON_DONE 1       // a message was parsed into the Message
+#define JSON_INVALID -1   // syntax error or unknown type; rest of line skipped
+#define JSON_TOO_LONG -2  // message longer than MAX_MESSAGE
+
+/* Incremental tokenizer for the messages in communication-protocol.md.
+ * Known fields are written straight into the Message while the bytes
+ * arrive, so a message split over several recv() calls is never copied
+ * or re-scanned. Unknown keys, nested objects and arrays are skipped. */
+typedef struct json_parser {
+    Message *msg;
+    int state;
+    int depth;
+    char containers[JSON_MAX_DEPTH];  // '{' or '[' per level
+    int parent;                       // field of the enclosing object
+    int field;                        // field of the current key
+    char key[JSON_MAX_KEY];
+    int klen;
+    char *dest;                       // string value destination
+    size_t dsize, dlen;
+    char type[24];                    // "type" value until it is mapped
+    long number;
+    int negative, fraction, digits;
+    int escape;                       // chars left of \uXXXX
+    size_t length;                    // bytes of the current message
+} JsonParser;
+
+void json_init(JsonParser *p, Message *msg);
+int json_feed(JsonParser *p, const char *buf, size_t len, size_t *used);
+
+#endif
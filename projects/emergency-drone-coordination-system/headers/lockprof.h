@@ -0,0 +1,41 @@
+#ifndef LOCKPROF_H
+#define LOCKPROF_H
+
+#include <pthread.h>
+#include <stdio.h>
+
+/* Contention profile of the List and Drone mutexes (lockprof.c). Built
+ * with -DLOCK_PROFILE (make ... LOCK_PROFILE=1), every prof_lock() call
+ * site counts its acquisitions and the contended ones, and times the
+ * wait for the lock and how long it was held; lockprof_report() prints
+ * the sites that waited longest. Without it prof_lock() is
+ * pthread_mutex_lock() and the profile costs nothing. */
+typedef struct lock_site {
+    const char *name;  // the expression locked, e.g. "&drones->lock"
+    const char *file;
+    int line;
+    int registered;
+    struct lock_site *next;
+    long acquired, contended;
+    long wait_ns, max_wait_ns;
+    long hold_ns, max_hold_ns;
+} LockSite;
+
+#ifdef LOCK_PROFILE
+#define prof_lock(m)                                                   \
+    do {                                                               \
+        static LockSite prof_site_ = {#m, __FILE__, __LINE__, 0, NULL, \
+                                      0, 0, 0, 0, 0, 0};               \
+        lockprof_lock((m), &prof_site_);                               \
+    } while (0)
+#define prof_unlock(m) lockprof_unlock(m)
+#else
+#define prof_lock(m) pthread_mutex_lock(m)
+#define prof_unlock(m) pthread_mutex_unlock(m)
+#endif
+
+void lockprof_lock(pthread_mutex_t *m, LockSite *site);
+void lockprof_unlock(pthread_mutex_t *m);
+void lockprof_report(FILE *out, int top);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef MAP_H
 #define MAP_H
 
+#include <pthread.h>
 #include "survivor.h"
 #include "list.h"
 #include "coord.h"
@@ -10,9 +11,20 @@ typedef struct mapcell {
     List *survivors;    // Survivors in this cell
 } MapCell;
 
+/* Change log of cells whose content changed since the snapshot
+ * publisher last looked at them. Each cell is logged at most once (marked[] dedups),
+ * so cells[] never needs more than height*width entries. */
+typedef struct dirtylog {
+    unsigned char *marked;  // marked[x * width + y] == 1 if logged
+    int *cells;             // logged cell indices, in order of change
+    int count;
+    pthread_mutex_t lock;
+} DirtyLog;
+
 typedef struct map {
     int height, width;
     MapCell **cells;
+    DirtyLog dirty;
 } Map;
 
 // Global map instance (extern)
@@ -21,5 +33,7 @@ extern Map map;
 // Functions
 void init_map(int height, int width);
 void freemap();
+void mark_cell_dirty(Coord coord);
+int take_dirty_cells(int *dest, int max);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,50 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+
+/* Performance metrics (metrics.c): counters and latency histograms kept
+ * per thread, so recording one is a few plain stores with no lock and
+ * no shared cache line; log_performance() adds the threads up. */
+typedef enum {
+    METRIC_SURVIVOR_WAIT,     // mission opened -> completed
+    METRIC_ASSIGN_LATENCY,    // mission queued (or requeued) -> assigned
+    METRIC_MISSION_DURATION,  // assigned -> completed
+    METRIC_LIST_LOCK_HOLD,    // drones, map cell and helped list sections
+    METRIC_HISTOGRAMS
+} MetricHistogram;
+
+typedef enum {
+    METRIC_MISSIONS_OPENED,
+    METRIC_MISSIONS_ASSIGNED,
+    METRIC_MISSIONS_COMPLETED,
+    METRIC_MISSIONS_REQUEUED,  // drone lost or deadline passed
+    METRIC_DRONE_BUSY_NS,      // end minus start times of assignments
+    METRIC_COUNTERS
+} MetricCounter;
+
+/* log-linear buckets: exact below 32 ns, then 16 per power of two
+ * (about 6% wide) up to 2^63 ns */
+#define METRIC_SUB_BUCKETS 16
+#define METRIC_BUCKETS (60 * METRIC_SUB_BUCKETS)
+
+/* a histogram summed over the threads */
+typedef struct metric_summary {
+    long count;
+    long sum_ns, max_ns;
+    long buckets[METRIC_BUCKETS];
+} MetricSummary;
+
+long metrics_now_ns();
+void metrics_record(MetricHistogram h, long ns);
+void metrics_add(MetricCounter c, long n);
+long metrics_counter(MetricCounter c);
+void metrics_summary(MetricHistogram h, MetricSummary *out);
+long metrics_percentile(const MetricSummary *s, double p);
+
+/* prints every histogram and counter since start, and the share of
+ * drone time spent on missions since the last call for a fleet of
+ * `drones` */
+void log_performance(FILE *out, int drones);
+
+#endif
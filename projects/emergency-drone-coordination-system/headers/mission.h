@@ -0,0 +1,89 @@
+#ifndef MISSION_H
+#define MISSION_H
+
+#include <pthread.h>
+#include <time.h>
+#include "drone.h"
+#include "survivor.h"
+
+/* Mission table: every survivor awaiting help or being helped has one
+ * entry, found by its mission_id in O(1). A waiting mission sits in the
+ * queue of its survivor's priority; an assigned one sits in a list in
+ * deadline order. A mission lost with its drone or past its deadline
+ * goes back to the head of its priority queue, so it is the next one
+ * handed out at that priority. With mission_partition() every map
+ * region (region.c) has its own set of queues. */
+typedef enum {
+    MISSION_FREE,      // slot unused
+    MISSION_WAITING,   // in a priority queue, or claimed
+    MISSION_ASSIGNED   // sent to drone, in the deadline list
+} MissionState;
+
+typedef struct mission {
+    struct mission *next, *prev;  // queue, deadline or free list
+    int id;                       // > 0, "M<id>" on the wire
+    int state;                    // MissionState
+    int region;                   // MissionQueue it waits in
+    Survivor survivor;
+    Drone *drone;                 // while ASSIGNED
+    time_t deadline;              // while ASSIGNED, the ASSIGN_MISSION expiry
+    time_t queued;                // when it last entered a queue
+    long opened_ns, queued_ns;    // metrics.h clock: opened, last queued
+    long started_ns;              // while ASSIGNED
+} Mission;
+
+/* the waiting missions of one region */
+typedef struct mission_queue {
+    Mission queue[PRIORITY_LEVELS];     // by priority
+    Mission claimed;                    // taken by mission_claim()
+    int waiting;                        // in both
+    pthread_cond_t wake;                // a mission or a drone is available
+} MissionQueue;
+
+typedef struct mission_table {
+    Mission *slots;
+    int capacity;
+    int timeout;                        // seconds from assignment to expiry
+    int waiting, assigned;              // missions in each state
+    long requeued, expired;             // since start
+    Mission free;                       // list heads
+    Mission deadlines;                  // assigned, earliest deadline first
+    int regions;                        // one queue for the map by default
+    MissionQueue *region;
+    int (*region_of)(Coord c);          // NULL while there is one
+    pthread_mutex_t lock;
+} MissionTable;
+
+extern MissionTable missions;
+
+/* changes reported to mission_observer, with missions.lock held so they
+ * arrive in the order they happened (the server's journal) */
+typedef enum {
+    MISSION_OPENED,    // mission_enqueue
+    MISSION_STARTED,   // mission_start, m->drone is set
+    MISSION_COMPLETED  // mission_complete, before the slot is freed
+} MissionEvent;
+
+extern void (*mission_observer)(MissionEvent e, const Mission *m);
+
+/* called with missions.lock held whenever a region's wake is signaled,
+ * for an AI that does not sleep on it (region.c on the pool) */
+extern void (*mission_notify)(int region);
+
+int mission_init(int capacity, int timeout);
+void mission_destroy();
+int mission_partition(int regions, int (*region_of)(Coord c));
+int mission_enqueue(const Survivor *s);
+int mission_restore(int id, const Survivor *s);
+Mission *mission_next();
+Mission *mission_claim(int region);
+void mission_unclaim(Mission *m);
+void mission_start(Mission *m, Drone *drone);
+void mission_requeue(Mission *m);
+Mission *mission_find(int id);
+int mission_lost(int id);
+int mission_complete(int id, Drone *drone, Survivor *dest);
+int mission_expire(time_t now);
+void mission_wake();
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdio.h>
+
+/* Work-stealing thread pool (pool.c): a fixed set of workers runs
+ * short tasks in place of a thread per drone, generator and AI. Each
+ * worker has its own deque, which it works LIFO, and idle workers
+ * steal the oldest task of another. A task is submitted with an
+ * affinity hint, the worker it should run on (mod the pool size), so
+ * tasks of the same drone or region keep their data in one cache;
+ * POOL_ANY runs it on the submitting worker, or spreads tasks from
+ * other threads. Each worker also owns a timer wheel (timer.h) for
+ * pool_after(); a task that re-arms itself is a periodic timer.
+ *
+ * Tasks must not block for long: a sleeping task holds up its worker.
+ * Pool locks are taken last, so tasks may be submitted with any lock
+ * held. */
+#define POOL_ANY -1
+#define POOL_TICK_MS 10  // timer resolution
+
+int start_pool(int workers);
+void stop_pool();
+int pool_workers();
+int pool_submit(void (*fn)(void *arg), void *arg, int affinity);
+int pool_after(long ms, void (*fn)(void *arg), void *arg, int affinity);
+void pool_report(FILE *out);
+
+#endif
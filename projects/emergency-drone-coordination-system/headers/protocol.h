@@ -0,0 +1,76 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+#include <time.h>
+#include "coord.h"
+
+/* see communication-protocol.md; every message is one JSON object
+ * terminated by '\n' */
+#define SERVER_PORT 8080
+#define MAX_MESSAGE 1024  // longest accepted message, including '\n'
+
+typedef enum {
+    MSG_UNKNOWN,
+    MSG_HANDSHAKE,
+    MSG_STATUS_UPDATE,
+    MSG_MISSION_COMPLETE,
+    MSG_HEARTBEAT_RESPONSE,
+    MSG_HANDSHAKE_ACK,
+    MSG_ASSIGN_MISSION,
+    MSG_HEARTBEAT,
+    MSG_ERROR,
+    MSG_CONFIG_UPDATE
+} MessageType;
+
+/* Fields of all message types; a parsed message fills the ones its
+ * type carries and leaves the others zero */
+typedef struct message {
+    MessageType type;
+    char drone_id[16];
+    char mission_id[16];
+    char session_id[16];
+    char status[16];      // "idle", "busy", "charging"
+    char priority[8];     // "low", "medium", "high"
+    char encoding[8];     // HANDSHAKE(_ACK): "json" or "binary"
+    char telemetry[8];    // HANDSHAKE: "udp" asks for the UDP channel
+    char error[64];       // ERROR message
+    Coord location;
+    Coord target;
+    int battery;
+    int speed;
+    long timestamp;
+    long expiry;
+    int success;
+    int code;             // ERROR code
+    int status_update_interval;
+    int heartbeat_interval;
+    int telemetry_port;   // HANDSHAKE_ACK: UDP channel granted, else 0
+    unsigned int telemetry_id, telemetry_key;
+} Message;
+
+int parse_message(const char *json, size_t len, Message *msg);
+int format_message(char *buf, size_t size, const Message *msg);
+
+/* drone -> server */
+int format_handshake(char *buf, size_t size, const char *drone_id,
+                     const char *encoding, const char *telemetry);
+int format_status_update(char *buf, size_t size, const char *drone_id,
+                         Coord location, const char *status, int battery,
+                         int speed);
+int format_mission_complete(char *buf, size_t size, const char *drone_id,
+                            const char *mission_id, int success);
+int format_heartbeat_response(char *buf, size_t size, const char *drone_id);
+
+/* server -> drone */
+int format_handshake_ack(char *buf, size_t size, const char *session_id,
+                         int status_update_interval, int heartbeat_interval,
+                         const char *encoding, int telemetry_port,
+                         unsigned int telemetry_id, unsigned int telemetry_key);
+int format_assign_mission(char *buf, size_t size, const char *mission_id,
+                          const char *priority, Coord target, long expiry);
+int format_heartbeat(char *buf, size_t size);
+int format_error(char *buf, size_t size, int code, const char *message);
+int format_config_update(char *buf, size_t size, int status_update_interval);
+
+#endif
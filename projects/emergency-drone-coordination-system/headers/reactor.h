@@ -0,0 +1,115 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include "framing.h"
+#include "protocol.h"
+#include "shm.h"
+#include "timer.h"
+
+#define MAX_REACTORS 64
+#define MAX_EVENTS 256  // epoll_wait batch
+#define TIMER_TICK_MS 100
+#define MAX_FDS (1 << 20)  // size of the fd-indexed connection table
+
+struct reactor;
+
+/* One client connection. Owned by the reactor thread that accepted
+ * it; other threads may only call conn_send(). */
+typedef struct conn {
+    int fd;
+    struct reactor *reactor;
+    FrameReader in;
+    int binary;              // framing negotiated in HANDSHAKE, see wire.h
+    OutQueue out;            // bytes not yet accepted by the socket
+    long counted;            // out.messages already added to the stats
+    pthread_mutex_t wlock;   // guards out and the flags below
+    int write_pending;       // on reactor->pending, waiting for a flush
+    int flush_queued;        // on reactor->flush (reactor thread only)
+    int closed;              // freed by the reactor once off all lists
+    int ready_queued;        // on reactor->ready (reactor thread only)
+    struct conn *next_pending, *next_flush, *next_ready;
+    Timer timer;             // see conn_set_timer(), reactor thread only
+    int overflowed;          // out passed conn_queue_limit, closing
+    int io_ops;              // io_uring requests in flight on fd (uring.c)
+    ShmLink *shm;            // local drone over shared memory (shm.c), fd is
+                             // then its unix socket; NULL for TCP
+    int missed_heartbeats;   // HEARTBEATs sent since the last message
+    void *data;              // protocol state of the owner (e.g. Drone*)
+} Conn;
+
+/* I/O backend of all reactors, chosen before start_reactors() */
+typedef enum {
+    IO_EPOLL,  // readiness: epoll_wait, then recv()/sendmsg() (reactor.c)
+    IO_URING   // completions: multishot accept/recv, batched SEND (uring.c)
+} IoBackend;
+
+/* Event-loop callbacks, run on the reactor thread of the connection */
+typedef struct handlers {
+    void (*on_open)(Conn *c);
+    void (*on_message)(Conn *c, Message *msg);  // in either encoding
+    void (*on_close)(Conn *c);
+    int (*on_timer)(Conn *c);  // return -1 to close the connection
+} Handlers;
+
+typedef struct reactor {
+    int id;
+    int epfd;               // IO_EPOLL
+    void *ring;             // IO_URING, see uring.c
+    int listen_fd;          // own SO_REUSEPORT listener
+    long accept_retry;      // IO_EPOLL, µs; 0 unless accept() failed
+    int shm_fd;             // unix socket of shm_path, first reactor only
+    int wake_fd;            // eventfd, written when pending grows
+    pthread_t thread;
+    pthread_mutex_t pending_lock;
+    Conn *pending;          // conns with sends queued by other threads
+    Conn *flush;            // conns to flush at the end of this iteration
+    Conn *ready, *ready_tail;  // conns with unread data, round robin
+    TimerWheel wheel;       // connection timers, in TIMER_TICK_MS ticks
+    long connections;       // currently open
+    long messages;          // received since start
+    long replies;           // sent since start
+    long writes;            // sendmsg() calls or SENDs since start
+    long syscalls;          // I/O system calls of the loop since start
+    // load, read by the server's admission control and stats
+    long lag_us;            // moving average of one loop iteration, µs;
+                            // atomic, read it with reactor_lag_us()
+    long max_lag_us;        // longest iteration since the stats reset it
+    long max_queued;        // most unsent bytes left on one conn, ditto
+    long overflows;         // conns closed for passing conn_queue_limit
+    long shed;              // messages the server dropped under load
+    long rejected;          // HANDSHAKEs refused under load
+} Reactor;
+
+extern size_t conn_queue_limit;  // unsent bytes per connection
+extern IoBackend reactor_io;
+extern const char *shm_path;  // unix socket for local drones, NULL: none
+
+extern Reactor reactors[MAX_REACTORS];
+extern int num_reactors;
+
+int start_reactors(int n, int port, Handlers *handlers);
+void stop_reactors();
+int conn_send(Conn *c, const char *msg, size_t len);
+int conn_send_message(Conn *c, const Message *msg);
+void conn_send_error(Conn *c, int code, const char *message);
+void conn_close(Conn *c);
+void conn_set_timer(Conn *c, int ms);
+Conn *conn_lookup(int fd);
+
+/* shared by the epoll loop (reactor.c) and the io_uring loop (uring.c),
+ * reactor thread only */
+Conn *conn_open(Reactor *r, int fd);
+int conn_input(Reactor *r, Conn *c, const char *data, size_t n);
+void conn_close_now(Reactor *r, Conn *c);
+void conn_release(Conn *c);
+void reactor_take_pending(Reactor *r);
+void reactor_end_turn(Reactor *r, long busy_from, int drained);
+
+/* r's lag estimate, from any thread */
+static inline long reactor_lag_us(const Reactor *r) {
+    return __atomic_load_n(&r->lag_us, __ATOMIC_RELAXED);
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include "drone.h"
+#include "list.h"
+
+/* Parallel AI (region.c): the map is cut into bands of rows, each with
+ * its own mission queues (mission_partition()), drone list and AI
+ * worker, so workers search N/K drones each and hold missions.lock only
+ * to claim and to start a mission. A region with missions but no idle
+ * drone is starved; workers with nothing of their own to do steal its
+ * missions for their drones. With the thread pool running (pool.h),
+ * a worker is a task instead, submitted to the region's pool worker
+ * whenever the region's wake is signaled.
+ *
+ * Lock order: missions.lock -> drone->lock -> region drone lists (in
+ * region order). A worker holds no other lock while searching. */
+typedef struct region {
+    int id;
+    int first_row, rows;       // map rows [first_row, first_row + rows)
+    List *drones;              // Drone *s in the region
+    int starved;               // under missions.lock
+    long assigned, stolen;     // by its worker, stolen: of other regions
+    int scheduled;             // its task is queued on the pool
+    pthread_t thread;
+} Region;
+
+extern Region *regions;
+extern int num_regions;  // 0 until regions_init()
+
+int regions_init(int k, int max_drones);
+int region_of(Coord c);
+void region_track(Drone *d);
+void regions_start();
+void regions_stop();
+void regions_report(FILE *out);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include "drone.h"
+
+/* Drones known to the server, by protocol drone_id. Records come from
+ * one pool sized for the expected fleet and are never freed: a drone
+ * that reconnects gets its old record back. The index is an open
+ * addressing hash table over the names stored in the records, so each
+ * name is kept once and a HANDSHAKE finds its drone in O(1).
+ * Not thread safe: the server calls it with drones->lock held. */
+typedef struct registry_slot {
+    unsigned int hash;
+    Drone *drone;  // NULL if the slot is empty
+} RegistrySlot;
+
+typedef struct registry {
+    Drone *pool;
+    int capacity, used;
+    RegistrySlot *slots;  // a power of two, at least 2 * capacity
+    unsigned int mask;
+} Registry;
+
+int registry_init(Registry *r, int capacity);
+void registry_free(Registry *r);
+Drone *registry_find(Registry *r, const char *name);
+Drone *registry_add(Registry *r, const char *name);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "framing.h"
+
+/* Shared-memory transport for drones on the server's host, see shm.c.
+ * The rings carry the same byte stream as a TCP connection: JSON
+ * messages or binary frames in the negotiated encoding. */
+
+#define SHM_RING_SIZE (16 * 1024)  // bytes per direction, a power of two
+#define SHM_MAGIC 0x4d485344       // "DSHM"
+
+/* Single-producer single-consumer byte ring. Positions run freely and
+ * are taken modulo SHM_RING_SIZE. The flags are set by the side that
+ * is about to sleep and cleared by the side that wakes it. */
+typedef struct shm_ring {
+    _Alignas(64) unsigned int head;  // consumed up to, written by the consumer
+    unsigned int waiting;            // consumer waits for data
+    _Alignas(64) unsigned int tail;  // produced up to, written by the producer
+    unsigned int full;               // producer waits for room
+    _Alignas(64) char data[SHM_RING_SIZE];
+} ShmRing;
+
+/* the shared mapping of one drone */
+typedef struct shm_channel {
+    unsigned int magic;
+    ShmRing up;    // drone -> server
+    ShmRing down;  // server -> drone
+} ShmChannel;
+
+/* One side of a channel. Each side keeps its own copy of the positions
+ * it owns and checks the peer's, so a broken peer cannot make it read
+ * or write outside the ring. */
+typedef struct shm_link {
+    ShmChannel *ch;
+    ShmRing *in, *out;
+    unsigned int in_head, out_tail;
+    int bell;       // eventfd the peer writes: data in `in` or room in `out`
+    int peer_bell;  // eventfd this side writes
+} ShmLink;
+
+/* server: sets up a channel for the drone on unix socket sock */
+ShmLink *shm_accept(int sock);
+/* drone: connects to the server's socket at path; the socket stays
+ * open as long as the channel is used, *sock gets it */
+ShmLink *shm_connect(const char *path, int *sock);
+void shm_close(ShmLink *l);
+
+ssize_t shm_recv(ShmLink *l, char *buf, size_t room);
+int shm_flush(OutQueue *q, ShmLink *l);
+void shm_ack_bell(ShmLink *l);
+
+#endif
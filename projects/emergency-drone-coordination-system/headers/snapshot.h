@@ -0,0 +1,46 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "coord.h"
+
+#define SNAPSHOT_INTERVAL_MS 50  // Publish period of the simulation
+
+/* What the view needs to know about one drone */
+typedef struct droneview {
+    int id;
+    int status;
+    Coord coord;
+    Coord target;
+} DroneView;
+
+/* Immutable copy of the world as of one publish. The simulation fills
+ * a private slot and swaps it in; the view only ever reads the slot it
+ * swapped out, so neither side waits for the other.
+ *
+ * Only the render side is lock-free. To fill a slot the publisher
+ * still takes drones->lock and every drone's lock once per tick, so
+ * drone threads and the AI contend with it instead of with the view:
+ * one short hold per drone every SNAPSHOT_INTERVAL_MS. */
+typedef struct worldsnapshot {
+    unsigned long seq;        // 1 for the first publish, +1 per publish
+    int height, width;
+    int num_drones;
+    int drone_capacity;
+    DroneView *drones;
+    unsigned char *occupied;  // occupied[x * width + y]: cell has survivors
+    int num_dirty;
+    int *dirty;               // cells that changed since snapshot seq - 1
+} WorldSnapshot;
+
+/* snapshot.c: the triple buffer */
+void init_snapshots(int height, int width);
+WorldSnapshot *begin_snapshot();
+void commit_snapshot();
+const WorldSnapshot *latest_snapshot();
+void free_snapshots();
+
+/* publisher.c: fills snapshots from the simulation */
+void publish_snapshot();
+void *snapshot_publisher(void *args);
+
+#endif
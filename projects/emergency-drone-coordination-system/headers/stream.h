@@ -0,0 +1,43 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "codec.h"
+#include "snapshot.h"
+
+#define STREAM_PORT 8090                 // default viewer port
+#define STREAM_MAX_VIEWERS 16
+#define STREAM_MAX_PENDING (4 << 20)     // bytes queued before a viewer is dropped
+// largest payload either side accepts: a message must fit in a viewer's
+// queue with its length prefix. Keyframes (at most 1 + frame_max_size())
+// and deltas (what encode_delta() reserves) of the maps and fleets this
+// runs are far below it. The server drops a viewer rather than send
+// more; a viewer drops a stream that claims more before buffering it.
+#define STREAM_MAX_MESSAGE (STREAM_MAX_PENDING - VARINT_MAX)
+
+/* Message types, first payload byte of every message */
+#define STREAM_KEYFRAME 'K'  // full world, see encode_frame()
+#define STREAM_DELTA 'D'     // changes since the previous message
+
+/* Which DroneView fields a delta record carries */
+#define DELTA_ID 1
+#define DELTA_STATUS 2
+#define DELTA_COORD 4
+#define DELTA_TARGET 8
+
+/* server side: send every published snapshot to connected viewers */
+int start_stream_server(int port);
+void stream_snapshot(const WorldSnapshot *snap);
+void stop_stream_server();
+
+/* viewer side: mirror the server's world into the local snapshots */
+typedef struct streamconn {
+    int fd;
+    WorldSnapshot *mirror;  // world as of the last applied message
+} StreamConn;
+
+int stream_connect(const char *host, int port);
+int stream_apply_next(int fd, WorldSnapshot *mirror);
+void publish_mirror(const WorldSnapshot *mirror);
+void *stream_receiver(void *args);
+
+#endif
@@ -4,20 +4,35 @@
 #include "coord.h"
 #include <time.h>
 #include "list.h"
+
+// Order in which waiting survivors get a drone, see mission.h
+typedef enum {
+    PRIORITY_LOW,
+    PRIORITY_MEDIUM,
+    PRIORITY_HIGH
+} Priority;
+#define PRIORITY_LEVELS 3
+
 typedef struct survivor {
     int status;
+    int priority;           // Priority
     Coord coord;
     struct tm discovery_time;
     struct tm helped_time;
     char info[25];
 } Survivor;
 
-// Global survivor lists (extern)
-extern List *survivors;          // Survivors awaiting help
-extern List *helpedsurvivors;    // Helped survivors
+// Survivors awaiting help are in the mission table (mission.h)
+extern List *helpedsurvivors;    // Helped survivors, the latest ones
+#define HELPED_HISTORY 1000      // its capacity; the oldest go first.
+                                 // METRIC_MISSIONS_COMPLETED counts all
 
 // Functions
 Survivor* create_survivor(Coord *coord, char *info, struct tm *discovery_time);
 void *survivor_generator(void *args);
+void survivor_task(void *arg);
+void survivor_place(const Survivor *s);
+void survivor_helped(Survivor *s);
+void survivor_remember(const Survivor *s);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "drone.h"
+#include "protocol.h"
+#include "registry.h"
+
+#define TELEMETRY_BATCH 64  // datagrams per recvmmsg()
+
+/* counters of the telemetry thread since start */
+typedef struct telemetry_stats {
+    long datagrams;  // received
+    long batches;    // recvmmsg() calls that returned datagrams
+    long taken;      // handed to the server
+    long stale;      // overtaken by a newer sequence number
+    long invalid;    // malformed, unknown drone or old session key
+} TelemetryStats;
+
+extern TelemetryStats telemetry_stats;
+
+/* on_status runs on the telemetry thread with d->lock held */
+int start_telemetry(int port, Registry *registry,
+                    void (*on_status)(Drone *d, Message *msg));
+void stop_telemetry();
+unsigned int telemetry_new_key();
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+/* Hierarchical timer wheel: WHEEL_LEVELS wheels of WHEEL_SIZE slots,
+ * level n slots are WHEEL_SIZE^n ticks wide. Adding and deleting a
+ * timer is O(1); a tick only touches the slot that expires (and, every
+ * WHEEL_SIZE ticks, one slot of the next level that is cascaded down).
+ * Not thread safe: each reactor owns one wheel. */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4  // 64^4 ticks, about 19 days at 100 ms
+
+typedef struct timer {
+    struct timer *next, *prev;  // slot list, NULL when not pending
+    unsigned long expires;      // absolute tick
+    void *data;                 // owner, e.g. the Conn
+} Timer;
+
+typedef struct timer_wheel {
+    unsigned long now;  // last tick processed
+    long count;         // pending timers
+    Timer slots[WHEEL_LEVELS][WHEEL_SIZE];  // list heads
+} TimerWheel;
+
+void wheel_init(TimerWheel *w, unsigned long now);
+void timer_add(TimerWheel *w, Timer *t, unsigned long expires);
+void timer_del(TimerWheel *w, Timer *t);
+int timer_pending(const Timer *t);
+long wheel_advance(TimerWheel *w, unsigned long now,
+                   void (*fire)(Timer *t, void *arg), void *arg);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/* Survivor lifecycle tracing (trace.c), exported in Chrome trace-event
+ * format for chrome://tracing or ui.perfetto.dev. Each thread records
+ * into its own buffer without locks; trace_write() merges them. Off
+ * until trace_start(): then a call site costs one load and a branch.
+ *
+ *   long t = trace_now();
+ *   ...
+ *   trace_span("assign_mission", t, m->id);
+ */
+extern int trace_enabled;
+
+long trace_clock();
+
+/* start of a span, 0 while tracing is off */
+static inline long trace_now() {
+    return __atomic_load_n(&trace_enabled, __ATOMIC_RELAXED) ? trace_clock()
+                                                             : 0;
+}
+
+void trace_span(const char *name, long start, long arg);  // start -> now
+void trace_instant(const char *name, long arg);
+/* a slice of object `id`'s own track, across threads: 'b' begins it,
+ * 'e' ends it (names are static strings) */
+void trace_async(const char *name, char phase, long id);
+void trace_thread_name(const char *name);
+
+void trace_start();
+int trace_write(const char *path);
+
+#endif
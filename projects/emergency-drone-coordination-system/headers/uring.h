@@ -0,0 +1,13 @@
+#ifndef URING_H
+#define URING_H
+
+#include "reactor.h"
+
+/* io_uring backend of the reactors (reactor_io = IO_URING), see uring.c */
+int uring_setup(Reactor *r);
+void uring_free(Reactor *r);
+void *uring_loop(void *arg);
+void uring_send(Reactor *r, Conn *c);
+void uring_close(Reactor *r, Conn *c);
+
+#endif
@@ -2,14 +2,15 @@
 #ifndef VIEW_H
 #define VIEW_H
 #include <SDL2/SDL.h>
+#include "snapshot.h"
 /*view.c*/
-extern int init_sdl_window();
+extern int init_sdl_window(int height, int width);
 extern void draw_cell(int x, int y, SDL_Color color);
-extern void draw_drones();
-extern void draw_survivors();
+extern void draw_drones(const WorldSnapshot *snap);
+extern void draw_survivors(const WorldSnapshot *snap);
 extern void draw_grid();
 extern int draw_map();
 extern int check_events();
-extern int quit_all();
+extern void quit_all();
 
 #endif
\ No newline at end of file
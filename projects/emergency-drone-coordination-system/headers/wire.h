@@ -0,0 +1,29 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stddef.h>
+#include "protocol.h"
+
+/* Binary encoding of the protocol messages, selected with
+ * "encoding": "binary" in HANDSHAKE. A frame is a 2 byte little-endian
+ * payload length followed by the payload: 1 byte MessageType, then
+ * the fields of that type in a fixed order (see wire.c). */
+#define WIRE_HEADER 2
+#define WIRE_MAX_FRAME MAX_MESSAGE
+
+int encode_binary(const Message *msg, unsigned char *buf, size_t size);
+int decode_binary(const unsigned char *payload, size_t len, Message *msg);
+int binary_frame_length(const unsigned char *buf, size_t len);
+
+/* UDP telemetry datagram (telemetry.c): the drone's telemetry_id and
+ * telemetry_key from HANDSHAKE_ACK, a sequence number, then a binary
+ * STATUS_UPDATE frame */
+#define TELEMETRY_HEADER 12
+#define TELEMETRY_MAX (TELEMETRY_HEADER + WIRE_MAX_FRAME)
+
+int encode_telemetry(const Message *msg, unsigned int id, unsigned int key,
+                     unsigned int seq, unsigned char *buf, size_t size);
+int decode_telemetry(const unsigned char *buf, size_t len, unsigned int *id,
+                     unsigned int *key, unsigned int *seq, Message *msg);
+
+#endif
@@ -0,0 +1,803 @@
+/**
+ * @file journal.c
+ * @brief write-ahead journal of missions and drones (server --journal
+ * DIR), so a restarted server picks up the survivors, assignments and
+ * drones of the one that crashed.
+ *
+ * The thread that makes a change appends a record to an in-memory
+ * batch; mission records are appended under missions.lock, so they are
+ * in the order the changes happened. One writer thread takes the whole
+ * batch and commits it with one write() and one fdatasync(): the cost
+ * of a sync is shared by every record that arrived while the previous
+ * one ran, and no one on the assignment path waits for the disk. A
+ * crash loses the records of the batch being written, not more.
+ *
+ * The writer applies each committed batch to a shadow of the state:
+ * open missions, helped survivors and drones. Every CHECKPOINT_RECORDS
+ * records or CHECKPOINT_SECONDS it writes the shadow out as a
+ * checkpoint, one record per live object, and starts a new journal
+ * generation, so recovery reads the live state plus a short tail
+ * instead of the whole history. No server lock is taken for it.
+ *
+ * Files in DIR:
+ *   checkpoint   u32 magic, u32 first generation to replay, records
+ *   journal.<G>  records appended since the checkpoint before it
+ *
+ * A record is u16 payload length, u8 type, u32 FNV-1a hash of the type
+ * and payload, then the payload (integers little-endian, str = 1 byte
+ * length + bytes, coord = two i32, tm = u16 year, u8 month, day, hour,
+ * minute, second, weekday, u16 day of year, i8 dst, as in struct tm):
+ *
+ *   DRONE       u32 drone, str name, coord       first HANDSHAKE
+ *   DISCONNECT  u32 drone, coord                 connection closed
+ *   SURVIVOR    u32 mission, coord, u8 priority, tm discovered, str info
+ *   ASSIGN      u32 mission, u32 drone
+ *   COMPLETE    u32 mission, i64 helped
+ *   HELPED      coord, u8 priority, tm discovered, str info, tm helped
+ *               (checkpoints only)
+ *
+ * Replay stops at the first record that is cut short or fails its hash:
+ * the end of the write the crash interrupted.
+ */
+#include "headers/journal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define JOURNAL_MAGIC 0x4a444543u  // "CEDJ"
+#define CHECKPOINT_RECORDS 100000
+#define CHECKPOINT_SECONDS 60
+#define RECORD_HEADER 7
+#define RECORD_MAX (RECORD_HEADER + 96)
+
+enum { J_DRONE = 1, J_DISCONNECT, J_SURVIVOR, J_ASSIGN, J_COMPLETE, J_HELPED };
+
+typedef struct shadow_mission {
+    int id;     // 0: slot unused
+    int drone;  // registry id while assigned, else 0
+    long seq;   // order the missions were opened in
+    Survivor survivor;
+} ShadowMission;
+
+typedef struct shadow_drone {
+    char name[16];
+    Coord coord;
+} ShadowDrone;
+
+static struct {
+    char dir[256];
+    int fd;             // journal.<gen>
+    unsigned int gen;
+    int open, stopping;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t work;    // records appended, or stopping
+    pthread_cond_t synced;  // a batch was committed
+    unsigned char *batch;   // appended, not yet taken by the writer
+    size_t len, cap;
+    long appended, committed;  // records, for journal_sync()
+
+    // the shadow: the writer's, or recovery's before the writer starts
+    ShadowMission *missions;
+    int mission_capacity;
+    long next_seq;
+    ShadowDrone *drones;
+    int drone_capacity, drone_count;
+    Survivor *helped;
+    int helped_count, helped_cap, helped_first;
+    long since_checkpoint;
+    time_t checkpoint_at;
+} j = {.fd = -1,
+       .lock = PTHREAD_MUTEX_INITIALIZER,
+       .work = PTHREAD_COND_INITIALIZER,
+       .synced = PTHREAD_COND_INITIALIZER};
+
+JournalStats journal_stats;
+
+/* record encoding, bounded like wire.c's Writer and Reader */
+typedef struct {
+    unsigned char *buf;
+    size_t pos, size;
+    int error;
+} Writer;
+
+typedef struct {
+    const unsigned char *buf;
+    size_t pos, len;
+    int error;
+} Reader;
+
+static void put_uint(Writer *w, uint64_t v, int bytes) {
+    if (w->pos + bytes > w->size) {
+        w->error = 1;
+        return;
+    }
+    for (int i = 0; i < bytes; i++)
+        w->buf[w->pos++] = (unsigned char)(v >> (8 * i));
+}
+
+static void put_str(Writer *w, const char *s) {
+    size_t n = strnlen(s, 255);
+    put_uint(w, n, 1);
+    if (w->pos + n > w->size) {
+        w->error = 1;
+        return;
+    }
+    memcpy(w->buf + w->pos, s, n);
+    w->pos += n;
+}
+
+static void put_coord(Writer *w, Coord c) {
+    put_uint(w, (uint32_t)c.x, 4);
+    put_uint(w, (uint32_t)c.y, 4);
+}
+
+static uint64_t get_uint(Reader *r, int bytes) {
+    if (r->pos + bytes > r->len) {
+        r->error = 1;
+        return 0;
+    }
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++)
+        v |= (uint64_t)r->buf[r->pos + i] << (8 * i);
+    r->pos += bytes;
+    return v;
+}
+
+static void get_str(Reader *r, char *dest, size_t size) {
+    size_t n = get_uint(r, 1);
+    if (r->error || r->pos + n > r->len || n >= size) {
+        r->error = 1;
+        dest[0] = '\0';
+        return;
+    }
+    memcpy(dest, r->buf + r->pos, n);
+    dest[n] = '\0';
+    r->pos += n;
+}
+
+static Coord get_coord(Reader *r) {
+    Coord c;
+    c.x = (int32_t)get_uint(r, 4);
+    c.y = (int32_t)get_uint(r, 4);
+    return c;
+}
+
+#define FNV_OFFSET 2166136261u
+
+static uint32_t fnv1a(uint32_t h, const unsigned char *p, size_t n) {
+    for (size_t i = 0; i < n; i++) h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+/* a Writer for the payload of a record built in buf */
+static Writer record(unsigned char *buf, size_t size, int type) {
+    Writer w = {buf, RECORD_HEADER, size, 0};
+    buf[2] = (unsigned char)type;
+    return w;
+}
+
+/* fills in the header of the record in w->buf
+ * @return record size, 0 if the payload did not fit */
+static size_t seal(Writer *w) {
+    if (w->error) return 0;
+    size_t payload = w->pos - RECORD_HEADER;
+    w->buf[0] = (unsigned char)payload;
+    w->buf[1] = (unsigned char)(payload >> 8);
+    uint32_t h = fnv1a(fnv1a(FNV_OFFSET, w->buf + 2, 1),
+                       w->buf + RECORD_HEADER, payload);
+    for (int i = 0; i < 4; i++) w->buf[3 + i] = (unsigned char)(h >> (8 * i));
+    return w->pos;
+}
+
+/* the fields of a struct tm as they are: no mktime() on the caller's
+ * side, it takes the time zone lock */
+static void put_tm(Writer *w, const struct tm *tm) {
+    put_uint(w, tm->tm_year, 2);
+    put_uint(w, tm->tm_mon, 1);
+    put_uint(w, tm->tm_mday, 1);
+    put_uint(w, tm->tm_hour, 1);
+    put_uint(w, tm->tm_min, 1);
+    put_uint(w, tm->tm_sec, 1);
+    put_uint(w, tm->tm_wday, 1);
+    put_uint(w, tm->tm_yday, 2);
+    put_uint(w, (unsigned char)tm->tm_isdst, 1);
+}
+
+static void get_tm(Reader *r, struct tm *tm) {
+    memset(tm, 0, sizeof(*tm));
+    tm->tm_year = (int16_t)get_uint(r, 2);
+    tm->tm_mon = get_uint(r, 1);
+    tm->tm_mday = get_uint(r, 1);
+    tm->tm_hour = get_uint(r, 1);
+    tm->tm_min = get_uint(r, 1);
+    tm->tm_sec = get_uint(r, 1);
+    tm->tm_wday = get_uint(r, 1);
+    tm->tm_yday = get_uint(r, 2);
+    tm->tm_isdst = (signed char)get_uint(r, 1);
+}
+
+static void put_survivor(Writer *w, const Survivor *s) {
+    put_coord(w, s->coord);
+    put_uint(w, s->priority, 1);
+    put_tm(w, &s->discovery_time);
+    put_str(w, s->info);
+}
+
+static void get_survivor(Reader *r, Survivor *s) {
+    memset(s, 0, sizeof(*s));
+    s->coord = get_coord(r);
+    s->priority = get_uint(r, 1);
+    get_tm(r, &s->discovery_time);
+    get_str(r, s->info, sizeof(s->info));
+}
+
+/* adds a record to the batch for the writer; j.lock is taken last,
+ * after missions.lock or a drone's */
+static void append(const unsigned char *rec, size_t len) {
+    if (len == 0) return;
+    pthread_mutex_lock(&j.lock);
+    if (j.len + len > j.cap) {
+        size_t cap = j.cap ? j.cap * 2 : 65536;
+        unsigned char *grown = realloc(j.batch, cap);
+        if (!grown) {
+            journal_stats.dropped++;
+            pthread_mutex_unlock(&j.lock);
+            return;
+        }
+        j.batch = grown;
+        j.cap = cap;
+    }
+    memcpy(j.batch + j.len, rec, len);
+    j.len += len;
+    j.appended++;
+    pthread_cond_signal(&j.work);
+    pthread_mutex_unlock(&j.lock);
+}
+
+/* keeps the last HELPED_HISTORY helped survivors, like the server's
+ * list: once full, a ring from j.helped_first (the oldest) */
+static void add_helped(const Survivor *s) {
+    if (j.helped_count == HELPED_HISTORY) {
+        j.helped[j.helped_first] = *s;
+        j.helped_first = (j.helped_first + 1) % HELPED_HISTORY;
+        return;
+    }
+    if (j.helped_count == j.helped_cap) {
+        int cap = j.helped_cap ? j.helped_cap * 2 : 1024;
+        Survivor *grown = realloc(j.helped, cap * sizeof(Survivor));
+        if (!grown) return;
+        j.helped = grown;
+        j.helped_cap = cap;
+    }
+    j.helped[j.helped_count++] = *s;
+}
+
+static ShadowMission *shadow_mission(int id) {
+    if (id <= 0) return NULL;
+    ShadowMission *m = &j.missions[(id - 1) % j.mission_capacity];
+    return m->id == id ? m : NULL;
+}
+
+/* applies one record to the shadow; ids outside the shadow's range are
+ * ignored, so a restart with a smaller table loses those, not the rest
+ * @return 0, -1 if the payload is malformed */
+static int apply(int type, const unsigned char *payload, size_t len) {
+    Reader r = {payload, 0, len, 0};
+    switch (type) {
+        case J_DRONE: {
+            int id = get_uint(&r, 4);
+            ShadowDrone d;
+            get_str(&r, d.name, sizeof(d.name));
+            d.coord = get_coord(&r);
+            if (r.error || id <= 0 || id > j.drone_capacity) break;
+            j.drones[id - 1] = d;
+            if (id > j.drone_count) j.drone_count = id;
+            break;
+        }
+        case J_DISCONNECT: {
+            int id = get_uint(&r, 4);
+            Coord c = get_coord(&r);
+            if (!r.error && id > 0 && id <= j.drone_count)
+                j.drones[id - 1].coord = c;
+            break;
+        }
+        case J_SURVIVOR: {
+            int id = get_uint(&r, 4);
+            Survivor s;
+            get_survivor(&r, &s);
+            if (r.error || id <= 0) break;
+            ShadowMission *m = &j.missions[(id - 1) % j.mission_capacity];
+            *m = (ShadowMission){id, 0, j.next_seq++, s};
+            break;
+        }
+        case J_ASSIGN: {
+            ShadowMission *m = shadow_mission(get_uint(&r, 4));
+            int drone = get_uint(&r, 4);
+            if (!r.error && m) m->drone = drone;
+            break;
+        }
+        case J_COMPLETE: {
+            ShadowMission *m = shadow_mission(get_uint(&r, 4));
+            time_t t = (time_t)get_uint(&r, 8);
+            if (r.error || !m) break;
+            m->survivor.status = 1;
+            localtime_r(&t, &m->survivor.helped_time);
+            add_helped(&m->survivor);
+            m->id = 0;
+            break;
+        }
+        case J_HELPED: {
+            Survivor s;
+            get_survivor(&r, &s);
+            get_tm(&r, &s.helped_time);
+            if (r.error) break;
+            s.status = 1;
+            add_helped(&s);
+            break;
+        }
+        default:
+            return -1;
+    }
+    return r.error || r.pos != len ? -1 : 0;
+}
+
+/* applies the records in data to the shadow
+ * @return records applied; *used is the size of the valid prefix */
+static long apply_all(const unsigned char *data, size_t len, size_t *used) {
+    size_t pos = 0;
+    long n = 0;
+    while (len - pos >= RECORD_HEADER) {
+        const unsigned char *rec = data + pos;
+        size_t payload = rec[0] | rec[1] << 8;
+        if (len - pos - RECORD_HEADER < payload) break;  // cut short
+        uint32_t h = rec[3] | rec[4] << 8 | rec[5] << 16 | (uint32_t)rec[6] << 24;
+        if (fnv1a(fnv1a(FNV_OFFSET, rec + 2, 1), rec + RECORD_HEADER,
+                  payload) != h ||
+            apply(rec[2], rec + RECORD_HEADER, payload) != 0)
+            break;
+        pos += RECORD_HEADER + payload;
+        n++;
+    }
+    if (used) *used = pos;
+    return n;
+}
+
+static void path_of(char *dest, size_t size, const char *name,
+                    unsigned int gen) {
+    if (gen) snprintf(dest, size, "%s/%s.%u", j.dir, name, gen);
+    else snprintf(dest, size, "%s/%s", j.dir, name);
+}
+
+/* the whole file in a malloc'd buffer, NULL if it does not exist */
+static unsigned char *read_file(const char *path, size_t *len) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    unsigned char *data = NULL;
+    if (fstat(fd, &st) == 0 && (data = malloc(st.st_size + 1))) {
+        size_t got = 0;
+        ssize_t n;
+        while (got < (size_t)st.st_size &&
+               (n = read(fd, data + got, st.st_size - got)) > 0)
+            got += n;
+        *len = got;
+    }
+    close(fd);
+    return data;
+}
+
+static int write_all(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* appends a batch and makes it durable; on failure the file is cut
+ * back, so that the retry does not follow a torn record */
+static int commit(const unsigned char *batch, size_t len) {
+    off_t end = lseek(j.fd, 0, SEEK_END);
+    if (end >= 0 && write_all(j.fd, batch, len) == 0 && fdatasync(j.fd) == 0)
+        return 0;
+    perror("journal");
+    if (end >= 0 && ftruncate(j.fd, end) != 0) perror("journal");
+    return -1;
+}
+
+static void sync_dir() {
+    int fd = open(j.dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+}
+
+static int open_generation(unsigned int gen) {
+    char path[300];
+    path_of(path, sizeof(path), "journal", gen);
+    return open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+}
+
+static int by_seq(const void *a, const void *b) {
+    long x = (*(ShadowMission *const *)a)->seq;
+    long y = (*(ShadowMission *const *)b)->seq;
+    return (x > y) - (x < y);
+}
+
+/* writes the shadow to FILE out, missions in the order they opened */
+static int write_shadow(FILE *out) {
+    unsigned char rec[RECORD_MAX];
+    int failed = 0;
+    for (int i = 0; i < j.drone_count; i++) {
+        Writer w = record(rec, sizeof(rec), J_DRONE);
+        put_uint(&w, i + 1, 4);
+        put_str(&w, j.drones[i].name);
+        put_coord(&w, j.drones[i].coord);
+        size_t n = seal(&w);
+        failed |= fwrite(rec, 1, n, out) != n;
+    }
+
+    ShadowMission **open = malloc(j.mission_capacity * sizeof(*open));
+    if (!open) return -1;
+    int count = 0;
+    for (int i = 0; i < j.mission_capacity; i++)
+        if (j.missions[i].id) open[count++] = &j.missions[i];
+    qsort(open, count, sizeof(*open), by_seq);
+    for (int i = 0; i < count; i++) {
+        Writer w = record(rec, sizeof(rec), J_SURVIVOR);
+        put_uint(&w, open[i]->id, 4);
+        put_survivor(&w, &open[i]->survivor);
+        size_t n = seal(&w);
+        failed |= fwrite(rec, 1, n, out) != n;
+        if (!open[i]->drone) continue;
+        w = record(rec, sizeof(rec), J_ASSIGN);
+        put_uint(&w, open[i]->id, 4);
+        put_uint(&w, open[i]->drone, 4);
+        n = seal(&w);
+        failed |= fwrite(rec, 1, n, out) != n;
+    }
+    free(open);
+
+    for (int i = 0; i < j.helped_count; i++) {
+        const Survivor *s = &j.helped[(j.helped_first + i) % j.helped_count];
+        Writer w = record(rec, sizeof(rec), J_HELPED);
+        put_survivor(&w, s);
+        put_tm(&w, &s->helped_time);
+        size_t n = seal(&w);
+        failed |= fwrite(rec, 1, n, out) != n;
+    }
+    return failed ? -1 : 0;
+}
+
+/* Writes the shadow as the new checkpoint and moves the journal to the
+ * next generation. The checkpoint replaces the old one with rename(), so
+ * a crash at any point leaves either the old checkpoint and its
+ * generations or the new one. */
+static int checkpoint() {
+    unsigned int next = j.gen + 1;
+    int fd = open_generation(next);
+    if (fd < 0) return -1;
+
+    char tmp[300], path[300];
+    path_of(tmp, sizeof(tmp), "checkpoint.tmp", 0);
+    path_of(path, sizeof(path), "checkpoint", 0);
+    FILE *out = fopen(tmp, "w");
+    int failed = !out;
+    if (out) {
+        unsigned char header[8];
+        Writer w = {header, 0, sizeof(header), 0};
+        put_uint(&w, JOURNAL_MAGIC, 4);
+        put_uint(&w, next, 4);
+        failed |= fwrite(header, 1, sizeof(header), out) != sizeof(header);
+        failed |= write_shadow(out) != 0;
+        failed |= fflush(out) != 0 || fsync(fileno(out)) != 0;
+        failed |= fclose(out) != 0;
+    }
+    if (failed || rename(tmp, path) != 0) {
+        perror("journal checkpoint");
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+    sync_dir();
+
+    close(j.fd);
+    path_of(path, sizeof(path), "journal", j.gen);
+    unlink(path);
+    j.fd = fd;
+    j.gen = next;
+    j.since_checkpoint = 0;
+    j.checkpoint_at = time(NULL);
+    journal_stats.checkpoints++;
+    return 0;
+}
+
+/* commits batches as they come: one write() and one fdatasync() for
+ * all the records appended since the last one. A batch that failed is
+ * kept and retried, about once a second, before any later record; it
+ * is neither applied nor reported to journal_sync() until it is on
+ * disk, and is given up at journal_close(). */
+static void *writer(void *arg) {
+    (void)arg;
+    unsigned char *batch = NULL;  // in hand; the spare buffer once done
+    size_t len = 0, cap = 0;
+    long upto = 0;
+    int failed = 0;
+    while (1) {
+        pthread_mutex_lock(&j.lock);
+        if ((failed || j.len == 0) && !j.stopping) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_sec += 1;
+            pthread_cond_timedwait(&j.work, &j.lock, &until);
+        }
+        int stop = j.stopping && (failed || j.len == 0);
+        if (!failed) {
+            // take the batch, appends go on into the spare buffer
+            unsigned char *taken = j.batch;
+            size_t taken_cap = j.cap;
+            len = j.len;
+            upto = j.appended;
+            j.batch = batch;
+            j.cap = cap;
+            j.len = 0;
+            batch = taken;
+            cap = taken_cap;
+        }
+        pthread_mutex_unlock(&j.lock);
+
+        if (len > 0 && commit(batch, len) != 0) {
+            failed = 1;
+            pthread_mutex_lock(&j.lock);
+            journal_stats.failures++;
+            pthread_mutex_unlock(&j.lock);
+        } else if (len > 0) {
+            failed = 0;
+            long n = apply_all(batch, len, NULL);
+            j.since_checkpoint += n;
+            pthread_mutex_lock(&j.lock);
+            journal_stats.records += n;
+            journal_stats.commits++;
+            journal_stats.bytes += len;
+            j.committed = upto;
+            pthread_cond_broadcast(&j.synced);
+            pthread_mutex_unlock(&j.lock);
+        }
+        if (j.since_checkpoint >= CHECKPOINT_RECORDS ||
+            (j.since_checkpoint > 0 &&
+             (stop || time(NULL) - j.checkpoint_at >= CHECKPOINT_SECONDS)))
+            checkpoint();
+        if (stop) break;
+    }
+    free(batch);
+    return NULL;
+}
+
+/* reads the checkpoint and the generations after it into the shadow;
+ * *first is the first generation replayed
+ * @return the generation after the last one replayed, 0 on error */
+static unsigned int recover(long *from_checkpoint, unsigned int *first) {
+    char path[300];
+    size_t len = 0, used;
+    unsigned int gen = 1;
+    path_of(path, sizeof(path), "checkpoint", 0);
+    unsigned char *data = read_file(path, &len);
+    if (data) {
+        Reader r = {data, 0, len, 0};
+        uint32_t magic = get_uint(&r, 4);
+        gen = get_uint(&r, 4);
+        *from_checkpoint = apply_all(data + r.pos, len - r.pos, &used);
+        free(data);
+        if (r.error || magic != JOURNAL_MAGIC || gen == 0 ||
+            r.pos + used != len) {
+            fprintf(stderr, "journal: %s is damaged\n", path);
+            return 0;
+        }
+    }
+
+    for (*first = gen;; gen++) {
+        path_of(path, sizeof(path), "journal", gen);
+        if (!(data = read_file(path, &len))) break;
+        journal_stats.replayed += apply_all(data, len, &used);
+        free(data);
+        if (used != len) {
+            fprintf(stderr, "journal: %s: %zu torn bytes at the end ignored\n",
+                    path, len - used);
+            return gen + 1;  // nothing after a torn write can be trusted
+        }
+    }
+    return gen;
+}
+
+/**
+ * @brief recovers the state journaled in dir (created if missing),
+ * installs it through restore and starts journaling
+ *
+ * Drones come back DISCONNECTED under the names and ids they had;
+ * missions come back waiting under their ids, the ones that were
+ * assigned included, since their drones have to reconnect anyway.
+ * @return int: 0, -1 if dir is unusable or its checkpoint damaged
+ */
+int journal_open(const char *dir, int mission_capacity, int max_drones,
+                 const JournalRestore *restore) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    snprintf(j.dir, sizeof(j.dir), "%s", dir);
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        perror(dir);
+        return -1;
+    }
+    memset(&journal_stats, 0, sizeof(journal_stats));
+    j.mission_capacity = mission_capacity;
+    j.drone_capacity = max_drones;
+    j.missions = calloc(mission_capacity, sizeof(ShadowMission));
+    j.drones = calloc(max_drones, sizeof(ShadowDrone));
+    if (!j.missions || !j.drones) {
+        journal_close();
+        return -1;
+    }
+
+    long from_checkpoint = 0;
+    unsigned int first, gen = recover(&from_checkpoint, &first);
+    if (gen == 0) {
+        journal_close();
+        return -1;
+    }
+
+    int missions_open = 0, were_assigned = 0;
+    for (int i = 0; i < j.drone_count; i++)
+        if (restore && restore->drone)
+            restore->drone(j.drones[i].name, j.drones[i].coord);
+    ShadowMission **open = malloc(mission_capacity * sizeof(*open));
+    for (int i = 0; open && i < mission_capacity; i++)
+        if (j.missions[i].id) open[missions_open++] = &j.missions[i];
+    if (open) qsort(open, missions_open, sizeof(*open), by_seq);
+    for (int i = 0; open && i < missions_open; i++) {
+        were_assigned += open[i]->drone != 0;
+        open[i]->drone = 0;
+        if (restore && restore->mission)
+            restore->mission(open[i]->id, &open[i]->survivor);
+    }
+    free(open);
+    for (int i = 0; i < j.helped_count; i++)  // oldest first
+        if (restore && restore->helped)
+            restore->helped(&j.helped[(j.helped_first + i) % j.helped_count]);
+
+    // start clean: checkpoint the recovered state, drop what it covers
+    j.gen = gen;
+    j.fd = open_generation(gen);
+    if (j.fd < 0 || checkpoint() != 0) {
+        perror("journal");
+        journal_close();
+        return -1;
+    }
+    char path[300];
+    for (unsigned int g = first; g < gen; g++) {
+        path_of(path, sizeof(path), "journal", g);
+        unlink(path);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("journal: recovered %d drones, %d missions (%d were assigned), "
+           "%d helped from %ld checkpoint + %ld journal records in %.1f ms\n",
+           j.drone_count, missions_open, were_assigned, j.helped_count,
+           from_checkpoint, journal_stats.replayed,
+           (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+
+    j.stopping = 0;
+    j.appended = j.committed = 0;
+    if (pthread_create(&j.writer, NULL, writer, NULL) != 0) {
+        perror("journal");
+        journal_close();
+        return -1;
+    }
+    j.open = 1;
+    return 0;
+}
+
+/**
+ * @brief commits what is appended, writes a last checkpoint and stops
+ * the writer
+ */
+void journal_close() {
+    if (j.open) {
+        pthread_mutex_lock(&j.lock);
+        j.open = 0;
+        j.stopping = 1;
+        pthread_cond_signal(&j.work);
+        pthread_cond_broadcast(&j.synced);  // journal_sync() gives up
+        pthread_mutex_unlock(&j.lock);
+        pthread_join(j.writer, NULL);
+    }
+    if (j.fd >= 0) close(j.fd);
+    j.fd = -1;
+    free(j.batch);
+    free(j.missions);
+    free(j.drones);
+    free(j.helped);
+    j.batch = NULL;
+    j.missions = NULL;
+    j.drones = NULL;
+    j.helped = NULL;
+    j.len = j.cap = 0;
+    j.drone_count = j.helped_count = j.helped_cap = j.helped_first = 0;
+    j.next_seq = j.since_checkpoint = 0;
+}
+
+/**
+ * @brief waits until every record appended so far is on disk
+ */
+void journal_sync() {
+    pthread_mutex_lock(&j.lock);
+    long target = j.appended;
+    while (j.open && j.committed < target)
+        pthread_cond_wait(&j.synced, &j.lock);
+    pthread_mutex_unlock(&j.lock);
+}
+
+/**
+ * @brief mission_observer of the server: journals a mission change
+ */
+void journal_mission(MissionEvent e, const Mission *m) {
+    if (!j.open) return;
+    unsigned char rec[RECORD_MAX];
+    Writer w;
+    switch (e) {
+        case MISSION_OPENED:
+            w = record(rec, sizeof(rec), J_SURVIVOR);
+            put_uint(&w, m->id, 4);
+            put_survivor(&w, &m->survivor);
+            break;
+        case MISSION_STARTED:
+            w = record(rec, sizeof(rec), J_ASSIGN);
+            put_uint(&w, m->id, 4);
+            put_uint(&w, m->drone ? m->drone->id : 0, 4);
+            break;
+        case MISSION_COMPLETED:
+            w = record(rec, sizeof(rec), J_COMPLETE);
+            put_uint(&w, m->id, 4);
+            put_uint(&w, (uint64_t)time(NULL), 8);
+            break;
+        default:
+            return;
+    }
+    append(rec, seal(&w));
+}
+
+/**
+ * @brief journals a drone's first registration under its registry id
+ */
+void journal_drone(const Drone *d) {
+    if (!j.open) return;
+    unsigned char rec[RECORD_MAX];
+    Writer w = record(rec, sizeof(rec), J_DRONE);
+    put_uint(&w, d->id, 4);
+    put_str(&w, d->name);
+    put_coord(&w, d->coord);
+    append(rec, seal(&w));
+}
+
+/**
+ * @brief journals where a drone was when its connection closed
+ */
+void journal_disconnect(const Drone *d) {
+    if (!j.open) return;
+    unsigned char rec[RECORD_MAX];
+    Writer w = record(rec, sizeof(rec), J_DISCONNECT);
+    put_uint(&w, d->id, 4);
+    put_coord(&w, d->coord);
+    append(rec, seal(&w));
+}
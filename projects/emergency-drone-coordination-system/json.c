@@ -0,0 +1,392 @@
+/**
+ * @file json.c
+ * @brief incremental JSON tokenizer for the protocol messages.
+ *
+ * json_feed() is a byte-at-a-time state machine: all state lives in the
+ * JsonParser, so parsing stops wherever a recv() ended and resumes with
+ * the next one. Values of the known keys are stored into the Message as
+ * they are read; nothing is allocated and nothing is buffered except
+ * the current key name.
+ *
+ * A message is complete at the '\n' after its closing '}', so a
+ * connection that switches to binary right after it (HANDSHAKE) starts
+ * with the next byte. A raw '\n' inside a message is an error; after
+ * any error the rest of the line is skipped and the next message parses
+ * normally.
+ */
+#include "headers/json.h"
+
+#include <limits.h>
+#include <string.h>
+
+enum {
+    S_START,        // before '{' of a message
+    S_KEY_OR_END,   // after '{'
+    S_KEY_NEXT,     // after ',' in an object
+    S_KEY,          // inside a key
+    S_COLON,
+    S_VALUE,
+    S_VALUE_OR_END, // after '['
+    S_STRING,
+    S_STRING_ESC,
+    S_STRING_U,     // inside \uXXXX
+    S_NUMBER,
+    S_LITERAL,      // true, false, null
+    S_AFTER,        // after a value
+    S_END,          // after the final '}', until '\n'
+    S_SKIP          // after an error, until '\n'
+};
+
+enum {
+    F_NONE,
+    F_TYPE,
+    F_DRONE_ID,
+    F_MISSION_ID,
+    F_SESSION_ID,
+    F_STATUS,
+    F_PRIORITY,
+    F_ENCODING,
+    F_MESSAGE,
+    F_BATTERY,
+    F_SPEED,
+    F_TIMESTAMP,
+    F_EXPIRY,
+    F_CODE,
+    F_SUCCESS,
+    F_LOCATION,
+    F_TARGET,
+    F_CONFIG,
+    F_X,
+    F_Y,
+    F_STATUS_INTERVAL,
+    F_HEARTBEAT_INTERVAL,
+    F_TELEMETRY,
+    F_TELEMETRY_PORT,
+    F_TELEMETRY_ID,
+    F_TELEMETRY_KEY
+};
+
+/* known keys by the object they appear in (F_NONE = top level) */
+static const struct {
+    const char *name;
+    int len;
+    int parent;
+    int field;
+} keys[] = {
+#define KEY(name, parent, field) {name, sizeof(name) - 1, parent, field}
+    KEY("type", F_NONE, F_TYPE),
+    KEY("drone_id", F_NONE, F_DRONE_ID),
+    KEY("timestamp", F_NONE, F_TIMESTAMP),
+    KEY("location", F_NONE, F_LOCATION),
+    KEY("status", F_NONE, F_STATUS),
+    KEY("battery", F_NONE, F_BATTERY),
+    KEY("speed", F_NONE, F_SPEED),
+    KEY("mission_id", F_NONE, F_MISSION_ID),
+    KEY("success", F_NONE, F_SUCCESS),
+    KEY("session_id", F_NONE, F_SESSION_ID),
+    KEY("priority", F_NONE, F_PRIORITY),
+    KEY("target", F_NONE, F_TARGET),
+    KEY("expiry", F_NONE, F_EXPIRY),
+    KEY("encoding", F_NONE, F_ENCODING),
+    KEY("code", F_NONE, F_CODE),
+    KEY("message", F_NONE, F_MESSAGE),
+    KEY("config", F_NONE, F_CONFIG),
+    KEY("telemetry", F_NONE, F_TELEMETRY),
+    KEY("x", F_LOCATION, F_X),
+    KEY("y", F_LOCATION, F_Y),
+    KEY("x", F_TARGET, F_X),
+    KEY("y", F_TARGET, F_Y),
+    KEY("status_update_interval", F_CONFIG, F_STATUS_INTERVAL),
+    KEY("heartbeat_interval", F_CONFIG, F_HEARTBEAT_INTERVAL),
+    KEY("telemetry_port", F_CONFIG, F_TELEMETRY_PORT),
+    KEY("telemetry_id", F_CONFIG, F_TELEMETRY_ID),
+    KEY("telemetry_key", F_CONFIG, F_TELEMETRY_KEY),
+#undef KEY
+};
+
+static const char *type_names[] = {
+    [MSG_HANDSHAKE] = "HANDSHAKE",
+    [MSG_STATUS_UPDATE] = "STATUS_UPDATE",
+    [MSG_MISSION_COMPLETE] = "MISSION_COMPLETE",
+    [MSG_HEARTBEAT_RESPONSE] = "HEARTBEAT_RESPONSE",
+    [MSG_HANDSHAKE_ACK] = "HANDSHAKE_ACK",
+    [MSG_ASSIGN_MISSION] = "ASSIGN_MISSION",
+    [MSG_HEARTBEAT] = "HEARTBEAT",
+    [MSG_ERROR] = "ERROR",
+    [MSG_CONFIG_UPDATE] = "CONFIG_UPDATE",
+};
+
+void json_init(JsonParser *p, Message *msg) {
+    memset(p, 0, sizeof(JsonParser));
+    p->msg = msg;
+    p->state = S_START;
+}
+
+static int is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';  // '\n' ends a message
+}
+
+/* field of the key just read, at the current nesting */
+static int lookup_key(JsonParser *p) {
+    if (p->depth > 2 || (p->depth == 2 && p->parent == F_NONE)) return F_NONE;
+    int parent = p->depth == 1 ? F_NONE : p->parent;
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        if (keys[i].len == p->klen && keys[i].parent == parent &&
+            memcmp(keys[i].name, p->key, p->klen) == 0)
+            return keys[i].field;
+    }
+    return F_NONE;
+}
+
+/* points dest at the Message field a string value goes to */
+static void begin_string(JsonParser *p) {
+    Message *m = p->msg;
+    p->dest = NULL;
+    p->dlen = 0;
+    switch (p->field) {
+#define DEST(f, array)        \
+    case f:                   \
+        p->dest = array;      \
+        p->dsize = sizeof(array); \
+        break;
+        DEST(F_TYPE, p->type)
+        DEST(F_DRONE_ID, m->drone_id)
+        DEST(F_MISSION_ID, m->mission_id)
+        DEST(F_SESSION_ID, m->session_id)
+        DEST(F_STATUS, m->status)
+        DEST(F_PRIORITY, m->priority)
+        DEST(F_ENCODING, m->encoding)
+        DEST(F_MESSAGE, m->error)
+        DEST(F_TELEMETRY, m->telemetry)
+#undef DEST
+    }
+}
+
+static void end_string(JsonParser *p) {
+    if (!p->dest) return;
+    p->dest[p->dlen] = '\0';
+    if (p->field != F_TYPE) return;
+    for (int t = MSG_HANDSHAKE; t <= MSG_CONFIG_UPDATE; t++) {
+        if (strcmp(p->type, type_names[t]) == 0) p->msg->type = t;
+    }
+}
+
+static void append(JsonParser *p, char c) {
+    if (p->dest && p->dlen + 1 < p->dsize) p->dest[p->dlen++] = c;
+}
+
+static void end_number(JsonParser *p) {
+    Message *m = p->msg;
+    long v = p->negative ? -p->number : p->number;
+    switch (p->field) {
+        case F_BATTERY: m->battery = (int)v; break;
+        case F_SPEED: m->speed = (int)v; break;
+        case F_TIMESTAMP: m->timestamp = v; break;
+        case F_EXPIRY: m->expiry = v; break;
+        case F_CODE: m->code = (int)v; break;
+        case F_STATUS_INTERVAL: m->status_update_interval = (int)v; break;
+        case F_HEARTBEAT_INTERVAL: m->heartbeat_interval = (int)v; break;
+        case F_TELEMETRY_PORT: m->telemetry_port = (int)v; break;
+        case F_TELEMETRY_ID: m->telemetry_id = (unsigned int)v; break;
+        case F_TELEMETRY_KEY: m->telemetry_key = (unsigned int)v; break;
+        case F_X:
+            if (p->parent == F_LOCATION) m->location.x = (int)v;
+            else m->target.x = (int)v;
+            break;
+        case F_Y:
+            if (p->parent == F_LOCATION) m->location.y = (int)v;
+            else m->target.y = (int)v;
+            break;
+    }
+}
+
+/* opens '{' or '[' as a value; returns -1 if nested too deep */
+static int open_container(JsonParser *p, char c) {
+    if (p->depth == JSON_MAX_DEPTH) return -1;
+    if (p->depth == 1 && c == '{') p->parent = p->field;
+    p->containers[p->depth++] = c;
+    p->state = c == '{' ? S_KEY_OR_END : S_VALUE_OR_END;
+    return 0;
+}
+
+/* closes the innermost container */
+static void close_container(JsonParser *p) {
+    p->depth--;
+    if (p->depth == 1) p->parent = F_NONE;
+    p->state = p->depth == 0 ? S_END : S_AFTER;
+}
+
+/**
+ * @brief parses up to len bytes of buf into p->msg
+ * @param used set to the bytes consumed; after JSON_DONE the rest of
+ * buf belongs to the next message
+ * @return int: JSON_DONE, JSON_MORE, JSON_INVALID or JSON_TOO_LONG
+ */
+int json_feed(JsonParser *p, const char *buf, size_t len, size_t *used) {
+    size_t i = 0;
+    while (i < len) {
+        char c = buf[i];
+        if (p->state != S_START && p->state != S_SKIP) {
+            if (c == '\n') {
+                if (p->state == S_END) goto done;
+                goto invalid;
+            }
+            if (++p->length >= MAX_MESSAGE) {
+                *used = i;
+                return JSON_TOO_LONG;
+            }
+        }
+        switch (p->state) {
+            case S_START:
+                if (c == '{') {
+                    memset(p->msg, 0, sizeof(Message));
+                    p->depth = 0;
+                    p->parent = F_NONE;
+                    p->length = 1;
+                    open_container(p, c);
+                } else if (!is_space(c) && c != '\n') {
+                    goto invalid;
+                }
+                break;
+            case S_KEY_OR_END:
+                if (c == '}') {
+                    close_container(p);
+                    break;
+                }
+                // fall through
+            case S_KEY_NEXT:
+                if (c == '"') {
+                    p->klen = 0;
+                    p->state = S_KEY;
+                } else if (!is_space(c)) {
+                    goto invalid;
+                }
+                break;
+            case S_KEY:
+                if (c == '"') {
+                    p->field = lookup_key(p);
+                    p->state = S_COLON;
+                } else if (p->klen < JSON_MAX_KEY) {
+                    p->key[p->klen++] = c;
+                } else {
+                    p->klen = JSON_MAX_KEY + 1;  // matches no key
+                }
+                break;
+            case S_COLON:
+                if (c == ':') p->state = S_VALUE;
+                else if (!is_space(c)) goto invalid;
+                break;
+            case S_VALUE_OR_END:
+                if (c == ']') {
+                    close_container(p);
+                    break;
+                }
+                // fall through
+            case S_VALUE:
+                if (is_space(c)) break;
+                if (p->containers[p->depth - 1] == '[') p->field = F_NONE;
+                if (c == '"') {
+                    begin_string(p);
+                    p->state = S_STRING;
+                } else if (c == '{' || c == '[') {
+                    if (open_container(p, c) != 0) goto invalid;
+                } else if (c == '-' || (c >= '0' && c <= '9')) {
+                    p->negative = c == '-';
+                    p->number = c == '-' ? 0 : c - '0';
+                    p->digits = c != '-';
+                    p->fraction = 0;
+                    p->state = S_NUMBER;
+                } else if (c == 't' || c == 'f' || c == 'n') {
+                    if (p->field == F_SUCCESS) p->msg->success = c == 't';
+                    p->state = S_LITERAL;
+                } else {
+                    goto invalid;
+                }
+                break;
+            case S_STRING:
+                if (c == '"') {
+                    end_string(p);
+                    p->state = S_AFTER;
+                } else if (c == '\\') {
+                    p->state = S_STRING_ESC;
+                } else {
+                    append(p, c);
+                }
+                break;
+            case S_STRING_ESC:
+                if (c == 'u') {
+                    p->escape = 4;
+                    p->state = S_STRING_U;
+                    break;
+                }
+                append(p, c == 'n' ? '\n' : c == 't' ? '\t' : c == 'r' ? '\r'
+                                                                    : c);
+                p->state = S_STRING;
+                break;
+            case S_STRING_U:
+                if (--p->escape == 0) {
+                    append(p, '?');  // ids and statuses are ASCII
+                    p->state = S_STRING;
+                }
+                break;
+            case S_NUMBER:
+                if (c >= '0' && c <= '9') {
+                    if (!p->fraction) {
+                        // no field is that large: fail rather than wrap
+                        if (p->number > (LONG_MAX - (c - '0')) / 10)
+                            goto invalid;
+                        p->number = p->number * 10 + (c - '0');
+                    }
+                    p->digits++;
+                    break;
+                }
+                if (c == '.' || c == 'e' || c == 'E' || c == '+' ||
+                    (c == '-' && p->fraction)) {
+                    p->fraction = 1;  // integers only, the rest is dropped
+                    break;
+                }
+                if (!p->digits) goto invalid;
+                end_number(p);
+                p->state = S_AFTER;
+                p->length--;
+                continue;  // c belongs to S_AFTER
+            case S_LITERAL:
+                if (c >= 'a' && c <= 'z') break;
+                p->state = S_AFTER;
+                p->length--;
+                continue;
+            case S_AFTER:
+                if (is_space(c)) break;
+                if (c == ',') {
+                    p->state = p->containers[p->depth - 1] == '{' ? S_KEY_NEXT
+                                                                  : S_VALUE;
+                } else if ((c == '}' && p->containers[p->depth - 1] == '{') ||
+                           (c == ']' && p->containers[p->depth - 1] == '[')) {
+                    close_container(p);
+                } else {
+                    goto invalid;
+                }
+                break;
+            case S_END:
+                if (!is_space(c)) goto invalid;
+                break;
+            case S_SKIP:
+                if (c == '\n') p->state = S_START;
+                break;
+        }
+        i++;
+        continue;
+
+    done:
+        *used = i + 1;
+        p->state = S_START;
+        return p->msg->type != MSG_UNKNOWN ? JSON_DONE : JSON_INVALID;
+
+    invalid:
+        *used = i + 1;
+        p->state = c == '\n' ? S_START : S_SKIP;
+        return JSON_INVALID;
+    }
+    *used = len;
+    return JSON_MORE;
+}
@@ -144,22 +144,8 @@ int removedata(List *list, void *data) {
            memcmp(temp->data, data, list->datasize) != 0) {
         temp = temp->next;
     }
-    if (temp != NULL) {
-        Node *prevnode = temp->prev;
-        Node *nextnode = temp->next;
-        if (prevnode != NULL) {
-            prevnode->next = nextnode;
-        }
-        if (nextnode != NULL) {
-            nextnode->prev = prevnode;
-        }
-
-        temp->next = NULL;
-        temp->prev = NULL;
-        temp->occupied = 0;
-        return 0;
-    }
-    return 1;
+    /*removenode also fixes head, tail and number_of_elements*/
+    return removenode(list, temp);
 }
 /**
  * @brief removes the node from list->head, and copies its data into
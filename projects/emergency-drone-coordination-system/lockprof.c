@@ -0,0 +1,145 @@
+/**
+ * @file lockprof.c
+ * @brief lock contention profile, see lockprof.h.
+ *
+ * A lock is taken with trylock first: if that fails the acquisition
+ * counts as contended and the blocking lock is timed. Each thread keeps
+ * the locks it holds on a small stack with the site and time they were
+ * taken, so the unlock can charge the hold time to the site. Sites
+ * register themselves on first use in a list that is only pushed to;
+ * their counters are atomic, shared by the threads using the site.
+ */
+#include "headers/lockprof.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_HELD 16  // deeper nesting is locked but not timed
+
+static LockSite *sites;
+static __thread struct {
+    pthread_mutex_t *m;
+    LockSite *site;
+    long since;
+} held[MAX_HELD];
+static __thread int depth;
+
+static long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static void add(long *p, long n) {
+    __atomic_add_fetch(p, n, __ATOMIC_RELAXED);
+}
+
+static void raise_max(long *p, long v) {
+    long cur = __atomic_load_n(p, __ATOMIC_RELAXED);
+    while (v > cur && !__atomic_compare_exchange_n(p, &cur, v, 1,
+                                                   __ATOMIC_RELAXED,
+                                                   __ATOMIC_RELAXED))
+        ;
+}
+
+static void register_site(LockSite *site) {
+    if (__atomic_exchange_n(&site->registered, 1, __ATOMIC_ACQ_REL)) return;
+    site->next = __atomic_load_n(&sites, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&sites, &site->next, site, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+}
+
+void lockprof_lock(pthread_mutex_t *m, LockSite *site) {
+    if (!__atomic_load_n(&site->registered, __ATOMIC_ACQUIRE))
+        register_site(site);
+    long now;
+    if (pthread_mutex_trylock(m) == 0) {
+        now = now_ns();
+    } else {
+        long from = now_ns();
+        pthread_mutex_lock(m);
+        now = now_ns();
+        add(&site->contended, 1);
+        add(&site->wait_ns, now - from);
+        raise_max(&site->max_wait_ns, now - from);
+    }
+    add(&site->acquired, 1);
+    if (depth < MAX_HELD) {
+        held[depth].m = m;
+        held[depth].site = site;
+        held[depth].since = now;
+    }
+    depth++;
+}
+
+void lockprof_unlock(pthread_mutex_t *m) {
+    long now = now_ns();
+    // usually the last one taken; search down for out of order unlocks
+    int top = depth < MAX_HELD ? depth : MAX_HELD;
+    for (int i = top - 1; i >= 0; i--) {
+        if (held[i].m != m) continue;
+        long hold = now - held[i].since;
+        add(&held[i].site->hold_ns, hold);
+        raise_max(&held[i].site->max_hold_ns, hold);
+        memmove(&held[i], &held[i + 1], (top - i - 1) * sizeof(held[0]));
+        break;
+    }
+    if (depth > 0) depth--;
+    pthread_mutex_unlock(m);
+}
+
+#ifdef LOCK_PROFILE
+/* longest total wait first, then longest total hold */
+static int by_wait(const void *a, const void *b) {
+    const LockSite *x = *(LockSite *const *)a, *y = *(LockSite *const *)b;
+    if (x->wait_ns != y->wait_ns)
+        return (x->wait_ns < y->wait_ns) - (x->wait_ns > y->wait_ns);
+    return (x->hold_ns < y->hold_ns) - (x->hold_ns > y->hold_ns);
+}
+#endif
+
+/**
+ * @brief prints the `top` sites with the longest total wait
+ */
+void lockprof_report(FILE *out, int top) {
+#ifndef LOCK_PROFILE
+    (void)out;
+    (void)top;
+#else
+    int n = 0;
+    for (LockSite *s = __atomic_load_n(&sites, __ATOMIC_ACQUIRE); s;
+         s = s->next)
+        n++;
+    LockSite **all = malloc((n ? n : 1) * sizeof(*all));
+    if (!all) return;
+    n = 0;
+    for (LockSite *s = __atomic_load_n(&sites, __ATOMIC_ACQUIRE); s;
+         s = s->next)
+        all[n++] = s;
+    qsort(all, n, sizeof(*all), by_wait);
+
+    fprintf(out, "lock profile, the %d longest waits of %d sites:\n",
+            top < n ? top : n, n);
+    fprintf(out, "%-18s %-32s %10s %10s %6s %10s %9s %9s %9s\n", "site",
+            "lock", "acquired", "contended", "%", "wait ms", "max us",
+            "hold us", "max us");
+    for (int i = 0; i < n && i < top; i++) {
+        LockSite *s = all[i];
+        char where[64];
+        const char *file = strrchr(s->file, '/');
+        snprintf(where, sizeof(where), "%s:%d", file ? file + 1 : s->file,
+                 s->line);
+        const char *name = s->name[0] == '&' ? s->name + 1 : s->name;
+        fprintf(out, "%-18s %-32s %10ld %10ld %6.2f %10.3f %9.1f %9.3f %9.1f\n",
+                where, name, s->acquired, s->contended,
+                s->acquired ? 100.0 * s->contended / s->acquired : 0.0,
+                s->wait_ns / 1e6, s->max_wait_ns / 1e3,
+                s->acquired ? s->hold_ns / 1e3 / s->acquired : 0.0,
+                s->max_hold_ns / 1e3);
+    }
+    free(all);
+#endif
+}
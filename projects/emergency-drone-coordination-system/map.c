@@ -1,7 +1,9 @@
 #include "headers/map.h"
 #include "headers/list.h"
+#include "headers/lockprof.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 // Global map instance (defined here, declared extern in map.h)
 Map map;
@@ -34,9 +36,60 @@ void init_map(int height, int width) {
         }
     }
 
+    // Dirty-cell log, drained by the snapshot publisher
+    map.dirty.marked = calloc(height * width, sizeof(unsigned char));
+    map.dirty.cells = malloc(sizeof(int) * height * width);
+    if (!map.dirty.marked || !map.dirty.cells) {
+        perror("Failed to allocate dirty log");
+        exit(EXIT_FAILURE);
+    }
+    map.dirty.count = 0;
+    pthread_mutex_init(&map.dirty.lock, NULL);
+
     printf("Map initialized: %dx%d\n", height, width);
 }
 
+/**
+ * @brief records that the content of a cell changed (e.g. a survivor
+ * was added or removed), so only that cell is re-read and redrawn.
+ * @param coord: cell coordinate, x is the row and y is the column
+ */
+void mark_cell_dirty(Coord coord) {
+    if (coord.x < 0 || coord.x >= map.height || coord.y < 0 ||
+        coord.y >= map.width)
+        return;
+
+    int idx = coord.x * map.width + coord.y;
+    prof_lock(&map.dirty.lock);
+    if (!map.dirty.marked[idx]) {
+        map.dirty.marked[idx] = 1;
+        map.dirty.cells[map.dirty.count++] = idx;
+    }
+    prof_unlock(&map.dirty.lock);
+}
+
+/**
+ * @brief moves up to max logged cell indices into dest and clears
+ * them from the log. Cells that do not fit stay logged for the next
+ * call.
+ * @param dest: array of at least max ints
+ * @param max
+ * @return int: number of cell indices copied into dest
+ */
+int take_dirty_cells(int *dest, int max) {
+    prof_lock(&map.dirty.lock);
+    int n = map.dirty.count < max ? map.dirty.count : max;
+    for (int i = 0; i < n; i++) {
+        dest[i] = map.dirty.cells[i];
+        map.dirty.marked[dest[i]] = 0;
+    }
+    map.dirty.count -= n;
+    memmove(map.dirty.cells, map.dirty.cells + n,
+            sizeof(int) * map.dirty.count);
+    prof_unlock(&map.dirty.lock);
+    return n;
+}
+
 void freemap() {
     for (int i = 0; i < map.height; i++) {
         for (int j = 0; j < map.width; j++) {
@@ -46,5 +99,8 @@ void freemap() {
         free(map.cells[i]);
     }
     free(map.cells);
+    free(map.dirty.marked);
+    free(map.dirty.cells);
+    pthread_mutex_destroy(&map.dirty.lock);
     printf("Map destroyed\n");
 }
\ No newline at end of file
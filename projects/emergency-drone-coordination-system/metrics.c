@@ -0,0 +1,188 @@
+/**
+ * @file metrics.c
+ * @brief per-thread counters and histograms behind log_performance().
+ *
+ * A thread records into its own shard, allocated on its first record
+ * and linked into a list that is only ever pushed to, so the reader
+ * walks it without a lock. The shard has one writer: an update is a
+ * relaxed load and store, not a locked read-modify-write, and threads
+ * never write each other's cache lines. A reader sums the shards with
+ * relaxed loads; a total may miss a record that is being made, never
+ * count one twice. Shards are not freed, the counts of a thread that
+ * exited stay in the totals.
+ */
+#include "headers/metrics.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct metrics_shard {
+    struct metrics_shard *next;
+    long counters[METRIC_COUNTERS];
+    struct {
+        long count, sum_ns, max_ns;
+        long buckets[METRIC_BUCKETS];
+    } hist[METRIC_HISTOGRAMS];
+} MetricsShard;
+
+static MetricsShard *shards;             // pushed with CAS, never popped
+static MetricsShard spare;               // for a thread calloc() failed
+static __thread MetricsShard *mine;
+static long started_ns;                  // first record, for utilization
+
+static const char *histogram_names[METRIC_HISTOGRAMS] = {
+    "survivor wait", "assign latency", "mission duration", "list lock hold"};
+
+long metrics_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static MetricsShard *shard() {
+    if (mine) return mine;
+    long zero = 0;
+    __atomic_compare_exchange_n(&started_ns, &zero, metrics_now_ns(), 0,
+                                __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    MetricsShard *s = calloc(1, sizeof(MetricsShard));
+    if (!s) return mine = &spare;  // shared: counts may be lost, not wrong
+    s->next = __atomic_load_n(&shards, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&shards, &s->next, s, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+    return mine = s;
+}
+
+/* the only writer of *p adds n; wraps instead of overflowing, so a
+ * sum of shards is right whenever the true total fits */
+static void bump(long *p, long n) {
+    unsigned long v = __atomic_load_n(p, __ATOMIC_RELAXED);
+    __atomic_store_n(p, (long)(v + (unsigned long)n), __ATOMIC_RELAXED);
+}
+
+static int bucket_of(long ns) {
+    if (ns < METRIC_SUB_BUCKETS) return ns < 0 ? 0 : (int)ns;
+    int e = 63 - __builtin_clzl(ns);  // >= 4
+    int i = (e - 4) * METRIC_SUB_BUCKETS + (int)(ns >> (e - 4));
+    return i < METRIC_BUCKETS ? i : METRIC_BUCKETS - 1;
+}
+
+/* lowest value that falls in bucket i */
+static long bucket_floor(int i) {
+    if (i < 2 * METRIC_SUB_BUCKETS) return i;
+    int e = i / METRIC_SUB_BUCKETS + 3;
+    return (long)(i % METRIC_SUB_BUCKETS + METRIC_SUB_BUCKETS) << (e - 4);
+}
+
+/**
+ * @brief adds a duration in ns to histogram h of the calling thread
+ */
+void metrics_record(MetricHistogram h, long ns) {
+    MetricsShard *s = shard();
+    bump(&s->hist[h].buckets[bucket_of(ns)], 1);
+    bump(&s->hist[h].count, 1);
+    bump(&s->hist[h].sum_ns, ns);
+    if (ns > s->hist[h].max_ns)
+        __atomic_store_n(&s->hist[h].max_ns, ns, __ATOMIC_RELAXED);
+}
+
+void metrics_add(MetricCounter c, long n) {
+    bump(&shard()->counters[c], n);
+}
+
+static MetricsShard *first_shard() {
+    return __atomic_load_n(&shards, __ATOMIC_ACQUIRE);
+}
+
+long metrics_counter(MetricCounter c) {
+    unsigned long total = __atomic_load_n(&spare.counters[c], __ATOMIC_RELAXED);
+    for (MetricsShard *s = first_shard(); s; s = s->next)
+        total += __atomic_load_n(&s->counters[c], __ATOMIC_RELAXED);
+    return (long)total;
+}
+
+/* drone time spent on missions up to now: METRIC_DRONE_BUSY_NS has the
+ * end minus the start of every finished assignment and minus the start
+ * of the running ones, which add now */
+static long busy_ns(long now) {
+    long flying = metrics_counter(METRIC_MISSIONS_ASSIGNED) -
+                   metrics_counter(METRIC_MISSIONS_COMPLETED) -
+                   metrics_counter(METRIC_MISSIONS_REQUEUED);
+    return (long)((unsigned long)metrics_counter(METRIC_DRONE_BUSY_NS) +
+                  (unsigned long)flying * now);
+}
+
+void metrics_summary(MetricHistogram h, MetricSummary *out) {
+    memset(out, 0, sizeof(*out));
+    for (MetricsShard *s = first_shard();; s = s->next) {
+        MetricsShard *from = s ? s : &spare;
+        out->count += __atomic_load_n(&from->hist[h].count, __ATOMIC_RELAXED);
+        out->sum_ns += __atomic_load_n(&from->hist[h].sum_ns, __ATOMIC_RELAXED);
+        long max = __atomic_load_n(&from->hist[h].max_ns, __ATOMIC_RELAXED);
+        if (max > out->max_ns) out->max_ns = max;
+        for (int i = 0; i < METRIC_BUCKETS; i++)
+            out->buckets[i] +=
+                __atomic_load_n(&from->hist[h].buckets[i], __ATOMIC_RELAXED);
+        if (!s) break;
+    }
+}
+
+/**
+ * @brief value at fraction p (0..1) of the recorded ones, to the
+ * bucket's precision
+ */
+long metrics_percentile(const MetricSummary *s, double p) {
+    long total = 0;
+    for (int i = 0; i < METRIC_BUCKETS; i++) total += s->buckets[i];
+    if (total == 0) return 0;
+    long rank = (long)(p * (total - 1)), seen = 0;
+    for (int i = 0; i < METRIC_BUCKETS; i++) {
+        seen += s->buckets[i];
+        if (seen > rank) {
+            long v = bucket_floor(i);
+            return v < s->max_ns ? v : s->max_ns;
+        }
+    }
+    return s->max_ns;
+}
+
+/* ns in the unit that suits it */
+static const char *duration(char *buf, size_t size, long ns) {
+    if (ns < 10000) snprintf(buf, size, "%ld ns", ns);
+    else if (ns < 10000000) snprintf(buf, size, "%.1f us", ns / 1e3);
+    else if (ns < 10000000000L) snprintf(buf, size, "%.1f ms", ns / 1e6);
+    else snprintf(buf, size, "%.1f s", ns / 1e9);
+    return buf;
+}
+
+void log_performance(FILE *out, int drones) {
+    static long last_busy, last_at;
+    if (!last_at) last_at = __atomic_load_n(&started_ns, __ATOMIC_RELAXED);
+    static MetricSummary summary;  // 8 KB, not on the caller's stack
+    char mean[24], p50[24], p99[24], max[24];
+    for (int h = 0; h < METRIC_HISTOGRAMS; h++) {
+        metrics_summary(h, &summary);
+        if (summary.count == 0) continue;
+        fprintf(out, "performance: %-16s n %-8ld mean %-10s p50 %-10s "
+                "p99 %-10s max %s\n",
+                histogram_names[h], summary.count,
+                duration(mean, sizeof(mean), summary.sum_ns / summary.count),
+                duration(p50, sizeof(p50), metrics_percentile(&summary, 0.5)),
+                duration(p99, sizeof(p99), metrics_percentile(&summary, 0.99)),
+                duration(max, sizeof(max), summary.max_ns));
+    }
+
+    long now = metrics_now_ns(), busy = busy_ns(now);
+    double utilization = 0;
+    if (last_at && drones > 0 && now > last_at)
+        utilization = (double)(busy - last_busy) / ((now - last_at) * (double)drones);
+    last_busy = busy;
+    last_at = now;
+    fprintf(out, "performance: missions opened %ld  assigned %ld  "
+            "completed %ld  requeued %ld  drone utilization %.1f%%\n",
+            metrics_counter(METRIC_MISSIONS_OPENED),
+            metrics_counter(METRIC_MISSIONS_ASSIGNED),
+            metrics_counter(METRIC_MISSIONS_COMPLETED),
+            metrics_counter(METRIC_MISSIONS_REQUEUED), utilization * 100);
+}
@@ -0,0 +1,366 @@
+/**
+ * @file mission.c
+ * @brief mission table, see mission.h.
+ *
+ * Entries live in one array. An id maps to its slot as
+ * (id - 1) % capacity; every reuse of a slot adds capacity to its id,
+ * so a stale id (say a MISSION_COMPLETE for a mission that already
+ * expired) no longer matches the slot. All lists are circular with a
+ * sentinel head, like the timer wheel slots, so every queue operation
+ * is O(1). Functions marked "caller holds missions.lock" are used by
+ * the AI while it matches missions to drones.
+ *
+ * Waiting missions are queued by region. A region's AI worker claims
+ * one, searches its drones without missions.lock and starts or
+ * unclaims it; a claimed mission stays WAITING, on the claimed list,
+ * so mission_start() takes it from there like from a queue.
+ */
+#include "headers/mission.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "headers/lockprof.h"
+#include "headers/metrics.h"
+#include "headers/trace.h"
+
+MissionTable missions;
+void (*mission_observer)(MissionEvent e, const Mission *m) = NULL;
+void (*mission_notify)(int region) = NULL;
+
+static void list_init(Mission *head) {
+    head->next = head->prev = head;
+}
+
+static void list_add(Mission *head, Mission *m) {  // at the tail
+    m->prev = head->prev;
+    m->next = head;
+    head->prev->next = m;
+    head->prev = m;
+}
+
+static void list_push(Mission *head, Mission *m) {  // at the head
+    list_add(head->next, m);
+}
+
+static void list_unlink(Mission *m) {
+    m->prev->next = m->next;
+    m->next->prev = m->prev;
+    m->next = m->prev = NULL;
+}
+
+/**
+ * @brief allocates the table
+ * @param capacity: missions waiting or assigned at once
+ * @param timeout: seconds a drone has for a mission (the ASSIGN_MISSION
+ * expiry), 0 for no deadline
+ * @return int: 0, -1 if out of memory
+ */
+int mission_init(int capacity, int timeout) {
+    memset(&missions, 0, sizeof(missions));
+    missions.slots = calloc(capacity, sizeof(Mission));
+    if (!missions.slots) return -1;
+    missions.capacity = capacity;
+    missions.timeout = timeout;
+    list_init(&missions.free);
+    list_init(&missions.deadlines);
+    for (int i = capacity - 1; i >= 0; i--) {
+        missions.slots[i].id = i + 1 - capacity;  // first use gives i + 1
+        list_push(&missions.free, &missions.slots[i]);
+    }
+    pthread_mutex_init(&missions.lock, NULL);
+    return mission_partition(1, NULL);
+}
+
+static void free_queues() {
+    for (int r = 0; r < missions.regions; r++)
+        pthread_cond_destroy(&missions.region[r].wake);
+    free(missions.region);
+    missions.region = NULL;
+    missions.regions = 0;
+}
+
+void mission_destroy() {
+    free(missions.slots);
+    free_queues();
+    pthread_mutex_destroy(&missions.lock);
+    memset(&missions, 0, sizeof(missions));
+}
+
+/**
+ * @brief gives each of `regions` map regions its own queues; a mission
+ * goes to region_of(its survivor's coord). Only before any is opened.
+ * @return int: 0, -1 if missions are open or there is no memory
+ */
+int mission_partition(int regions, int (*region_of)(Coord c)) {
+    MissionQueue *q = calloc(regions, sizeof(MissionQueue));
+    if (!q) return -1;
+    pthread_mutex_lock(&missions.lock);
+    if (missions.waiting || missions.assigned) {
+        pthread_mutex_unlock(&missions.lock);
+        free(q);
+        return -1;
+    }
+    free_queues();
+    for (int r = 0; r < regions; r++) {
+        for (int p = 0; p < PRIORITY_LEVELS; p++) list_init(&q[r].queue[p]);
+        list_init(&q[r].claimed);
+        pthread_cond_init(&q[r].wake, NULL);
+    }
+    missions.region = q;
+    missions.regions = regions;
+    missions.region_of = regions > 1 ? region_of : NULL;
+    pthread_mutex_unlock(&missions.lock);
+    return 0;
+}
+
+/* wakes the AI of region r; caller holds missions.lock */
+static void wake(int r) {
+    pthread_cond_signal(&missions.region[r].wake);
+    if (mission_notify) mission_notify(r);
+}
+
+/* counts m, just queued, as waiting and wakes its region's AI */
+static void queued(Mission *m) {
+    missions.waiting++;
+    missions.region[m->region].waiting++;
+    wake(m->region);
+}
+
+/* takes free slot m for survivor s as a waiting mission; caller holds
+ * missions.lock and has set m->id */
+static void open_mission(Mission *m, const Survivor *s) {
+    list_unlink(m);
+    m->survivor = *s;
+    if (m->survivor.priority < 0 || m->survivor.priority >= PRIORITY_LEVELS)
+        m->survivor.priority = PRIORITY_MEDIUM;
+    m->state = MISSION_WAITING;
+    m->drone = NULL;
+    m->queued = time(NULL);
+    m->opened_ns = m->queued_ns = metrics_now_ns();
+    m->region = missions.region_of ? missions.region_of(s->coord) : 0;
+    list_add(&missions.region[m->region].queue[m->survivor.priority], m);
+    metrics_add(METRIC_MISSIONS_OPENED, 1);
+    trace_async("waiting", 'b', m->id);
+    queued(m);
+}
+
+/**
+ * @brief opens a mission for a newly found survivor
+ * @return int: the mission id, -1 if the table is full
+ */
+int mission_enqueue(const Survivor *s) {
+    pthread_mutex_lock(&missions.lock);
+    Mission *m = missions.free.next;
+    if (m == &missions.free) {
+        pthread_mutex_unlock(&missions.lock);
+        fprintf(stderr, "mission table is full!\n");
+        return -1;
+    }
+    m->id += missions.capacity;
+    open_mission(m, s);
+    if (mission_observer) mission_observer(MISSION_OPENED, m);
+    int id = m->id;
+    pthread_mutex_unlock(&missions.lock);
+    return id;
+}
+
+/**
+ * @brief reopens a waiting mission under the id it had before a
+ * restart (journal recovery); not reported to mission_observer
+ * @return int: 0, -1 if the id's slot is taken
+ */
+int mission_restore(int id, const Survivor *s) {
+    if (id <= 0) return -1;
+    pthread_mutex_lock(&missions.lock);
+    Mission *m = &missions.slots[(id - 1) % missions.capacity];
+    int free = m->state == MISSION_FREE;
+    if (free) {
+        m->id = id;  // the slot's later ids follow on from it
+        open_mission(m, s);
+    }
+    pthread_mutex_unlock(&missions.lock);
+    return free ? 0 : -1;
+}
+
+/* the next waiting mission of region r, NULL if none */
+static Mission *next_in(int r) {
+    for (int p = PRIORITY_LEVELS - 1; p >= 0; p--) {
+        Mission *head = &missions.region[r].queue[p];
+        if (head->next != head) return head->next;
+    }
+    return NULL;
+}
+
+/**
+ * @brief the waiting mission to hand out next: the oldest of the
+ * highest priority, of all regions. Caller holds missions.lock.
+ * @return Mission*: NULL if none is waiting
+ */
+Mission *mission_next() {
+    Mission *best = NULL;
+    for (int r = 0; r < missions.regions; r++) {
+        Mission *m = next_in(r);
+        if (m && (!best || m->survivor.priority > best->survivor.priority ||
+                  (m->survivor.priority == best->survivor.priority &&
+                   m->queued_ns < best->queued_ns)))
+            best = m;
+    }
+    return best;
+}
+
+/**
+ * @brief takes the next waiting mission of region out of its queue, to
+ * match it without holding missions.lock. Caller holds missions.lock,
+ * then passes the mission to mission_start() or mission_unclaim().
+ * @return Mission*: NULL if none is waiting
+ */
+Mission *mission_claim(int region) {
+    Mission *m = next_in(region);
+    if (!m) return NULL;
+    list_unlink(m);
+    list_add(&missions.region[region].claimed, m);
+    return m;
+}
+
+/**
+ * @brief puts a claimed mission back in front of its priority queue.
+ * Caller holds missions.lock.
+ */
+void mission_unclaim(Mission *m) {
+    list_unlink(m);
+    list_push(&missions.region[m->region].queue[m->survivor.priority], m);
+}
+
+/**
+ * @brief moves a waiting mission to drone and starts its deadline.
+ * Caller holds missions.lock.
+ */
+void mission_start(Mission *m, Drone *drone) {
+    list_unlink(m);
+    missions.waiting--;
+    missions.region[m->region].waiting--;
+    m->state = MISSION_ASSIGNED;
+    m->drone = drone;
+    m->deadline = missions.timeout ? time(NULL) + missions.timeout : 0;
+    // one timeout for all, so appending keeps the list in deadline order
+    list_add(&missions.deadlines, m);
+    missions.assigned++;
+    m->started_ns = metrics_now_ns();
+    metrics_record(METRIC_ASSIGN_LATENCY, m->started_ns - m->queued_ns);
+    metrics_add(METRIC_MISSIONS_ASSIGNED, 1);
+    metrics_add(METRIC_DRONE_BUSY_NS, -m->started_ns);
+    trace_async("waiting", 'e', m->id);
+    trace_async("flight", 'b', m->id);
+    if (mission_observer) mission_observer(MISSION_STARTED, m);
+}
+
+/**
+ * @brief puts an assigned mission back in front of its priority queue.
+ * Caller holds missions.lock.
+ */
+void mission_requeue(Mission *m) {
+    if (m->state != MISSION_ASSIGNED) return;
+    list_unlink(m);
+    missions.assigned--;
+    m->state = MISSION_WAITING;
+    m->drone = NULL;
+    m->queued = time(NULL);
+    m->queued_ns = metrics_now_ns();
+    metrics_add(METRIC_DRONE_BUSY_NS, m->queued_ns);
+    metrics_add(METRIC_MISSIONS_REQUEUED, 1);
+    trace_async("flight", 'e', m->id);
+    trace_async("waiting", 'b', m->id);
+    list_push(&missions.region[m->region].queue[m->survivor.priority], m);
+    missions.requeued++;
+    queued(m);
+}
+
+/**
+ * @brief looks a mission up by id. Caller holds missions.lock.
+ * @return Mission*: NULL for an unknown or finished mission
+ */
+Mission *mission_find(int id) {
+    if (id <= 0) return NULL;
+    Mission *m = &missions.slots[(id - 1) % missions.capacity];
+    if (m->id != id || m->state == MISSION_FREE) return NULL;
+    return m;
+}
+
+/**
+ * @brief the drone of mission id is gone (disconnected): requeue it
+ * @return int: 0, -1 if the mission was not assigned
+ */
+int mission_lost(int id) {
+    pthread_mutex_lock(&missions.lock);
+    Mission *m = mission_find(id);
+    int found = m && m->state == MISSION_ASSIGNED;
+    if (found) mission_requeue(m);
+    pthread_mutex_unlock(&missions.lock);
+    return found ? 0 : -1;
+}
+
+/**
+ * @brief closes mission id reported done by drone
+ * @param dest: receives the rescued survivor
+ * @return int: 0, -1 if drone does not hold this mission (unknown,
+ * expired or reassigned)
+ */
+int mission_complete(int id, Drone *drone, Survivor *dest) {
+    pthread_mutex_lock(&missions.lock);
+    Mission *m = mission_find(id);
+    if (!m || m->state != MISSION_ASSIGNED || m->drone != drone) {
+        pthread_mutex_unlock(&missions.lock);
+        return -1;
+    }
+    if (mission_observer) mission_observer(MISSION_COMPLETED, m);
+    long now = metrics_now_ns();
+    metrics_record(METRIC_MISSION_DURATION, now - m->started_ns);
+    metrics_record(METRIC_SURVIVOR_WAIT, now - m->opened_ns);
+    metrics_add(METRIC_DRONE_BUSY_NS, now);
+    metrics_add(METRIC_MISSIONS_COMPLETED, 1);
+    trace_async("flight", 'e', m->id);
+    list_unlink(m);
+    missions.assigned--;
+    *dest = m->survivor;
+    m->state = MISSION_FREE;
+    m->drone = NULL;
+    list_push(&missions.free, m);
+    // the drone is free again, at the survivor: in the mission's region
+    wake(m->region);
+    pthread_mutex_unlock(&missions.lock);
+    return 0;
+}
+
+/**
+ * @brief requeues every mission whose deadline passed and releases its
+ * drone. Caller holds missions.lock; takes the drone locks. Logs
+ * nothing: the caller reports the count once it dropped the lock.
+ * @return int: missions expired
+ */
+int mission_expire(time_t now) {
+    int expired = 0;
+    Mission *m;
+    while ((m = missions.deadlines.next) != &missions.deadlines &&
+           m->deadline && m->deadline <= now) {
+        Drone *d = m->drone;
+        prof_lock(&d->lock);
+        if (d->mission_id == m->id) {
+            d->mission_id = 0;
+            if (d->status == ON_MISSION) d->status = IDLE;
+        }
+        prof_unlock(&d->lock);
+        mission_requeue(m);
+        missions.expired++;
+        expired++;
+    }
+    return expired;
+}
+
+/* wakes the AI of every region, e.g. when a drone became idle */
+void mission_wake() {
+    pthread_mutex_lock(&missions.lock);
+    for (int r = 0; r < missions.regions; r++) wake(r);
+    pthread_mutex_unlock(&missions.lock);
+}
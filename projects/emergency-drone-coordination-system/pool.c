@@ -0,0 +1,296 @@
+/**
+ * @file pool.c
+ * @brief work-stealing thread pool, see pool.h.
+ *
+ * A deque is a growable ring under its worker's mutex: the owner and
+ * submitters push at the bottom, the owner pops there too and thieves
+ * take from the top. A mutex per worker keeps a push to a busy worker
+ * off the others' locks. An idle worker runs its due timers, its own
+ * tasks, then steals, and sleeps on its condvar only when all are
+ * empty, for at most one timer tick while it has timers pending.
+ * Submitting to a busy worker also wakes a sleeping one, to steal.
+ *
+ * A timer belongs to the wheel of the worker that armed it. pool_after()
+ * from another thread or for another worker sends a task that arms it
+ * there (the deadline was fixed at the call), so a wheel is only ever
+ * touched by its thread, as with the reactors. A fired timer goes to a
+ * free list of the worker that fired it and pool_after() on a worker
+ * takes from its own list, so a periodic task allocates nothing once
+ * the lists hold a timer per task; only callers outside the pool and
+ * a growing number of timers allocate.
+ */
+#include "headers/pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "headers/timer.h"
+#include "headers/trace.h"
+
+typedef struct task {
+    void (*fn)(void *arg);
+    void *arg;
+} Task;
+
+typedef struct pool_timer {
+    Timer timer;  // first: a fired Timer * is the PoolTimer
+    Task task;
+    struct pool_timer *next_free;
+} PoolTimer;
+
+typedef struct worker {
+    int id;
+    pthread_t thread;
+    pthread_mutex_t lock;  // the deque and sleeping
+    pthread_cond_t wake;
+    Task *tasks;           // ring of size slots, [top, bottom) in use
+    unsigned long top, bottom, size;
+    int sleeping;
+    TimerWheel wheel;      // only touched by the worker's thread
+    PoolTimer *free_timers;  // fired ones, ditto
+    long executed, stolen, fired;  // by this worker, for pool_report()
+} Worker;
+
+static Worker *workers;
+static int num_workers;
+static int stopping;
+static unsigned int next_worker;  // POOL_ANY from outside the pool
+static __thread Worker *self;
+
+static unsigned long now_ticks() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000UL + ts.tv_nsec / 1000000) / POOL_TICK_MS;
+}
+
+/* pushes t at the bottom of w's deque; caller holds w->lock */
+static int push(Worker *w, Task t) {
+    if (w->bottom - w->top == w->size) {  // full: double the ring
+        Task *tasks = malloc(2 * w->size * sizeof(Task));
+        if (!tasks) return -1;
+        for (unsigned long i = w->top; i != w->bottom; i++)
+            tasks[i - w->top] = w->tasks[i % w->size];
+        free(w->tasks);
+        w->tasks = tasks;
+        w->bottom -= w->top;
+        w->top = 0;
+        w->size *= 2;
+    }
+    w->tasks[w->bottom++ % w->size] = t;
+    return 0;
+}
+
+/* the newest task of w (own) or its oldest (stealing) */
+static int take(Worker *w, int oldest, Task *t) {
+    pthread_mutex_lock(&w->lock);
+    int found = w->bottom != w->top;
+    if (found)
+        *t = oldest ? w->tasks[w->top++ % w->size]
+                    : w->tasks[--w->bottom % w->size];
+    pthread_mutex_unlock(&w->lock);
+    return found;
+}
+
+static Worker *target(int affinity) {
+    if (affinity >= 0) return &workers[affinity % num_workers];
+    if (self) return self;
+    return &workers[__atomic_fetch_add(&next_worker, 1, __ATOMIC_RELAXED) %
+                    num_workers];
+}
+
+/**
+ * @brief runs fn(arg) on a pool worker, preferably `affinity`
+ * @return int: 0, -1 if the pool is not running or out of memory
+ */
+int pool_submit(void (*fn)(void *arg), void *arg, int affinity) {
+    if (!num_workers || __atomic_load_n(&stopping, __ATOMIC_ACQUIRE))
+        return -1;
+    Worker *w = target(affinity);
+    pthread_mutex_lock(&w->lock);
+    int failed = push(w, (Task){fn, arg});
+    int asleep = w->sleeping;
+    if (asleep) pthread_cond_signal(&w->wake);
+    pthread_mutex_unlock(&w->lock);
+    if (failed) return -1;
+    if (asleep) return 0;
+
+    // w is busy: a sleeping worker can steal it meanwhile
+    for (int i = 0; i < num_workers; i++) {
+        Worker *idle = &workers[i];
+        if (idle == w || !__atomic_load_n(&idle->sleeping, __ATOMIC_RELAXED))
+            continue;
+        pthread_mutex_lock(&idle->lock);
+        pthread_cond_signal(&idle->wake);
+        pthread_mutex_unlock(&idle->lock);
+        break;
+    }
+    return 0;
+}
+
+/* runs on the worker that is to own the timer */
+static void arm(void *arg) {
+    PoolTimer *pt = arg;
+    timer_add(&self->wheel, &pt->timer, pt->timer.expires);
+}
+
+/**
+ * @brief runs fn(arg) on a pool worker in about ms milliseconds
+ * (rounded up to POOL_TICK_MS); to repeat, fn calls pool_after() again
+ * @return int: 0, -1 if the pool is not running or out of memory
+ */
+int pool_after(long ms, void (*fn)(void *arg), void *arg, int affinity) {
+    PoolTimer *pt = self ? self->free_timers : NULL;
+    if (pt) self->free_timers = pt->next_free;
+    else if (!(pt = calloc(1, sizeof(PoolTimer)))) return -1;
+    pt->task = (Task){fn, arg};
+    unsigned long expires =
+        now_ticks() + (ms + POOL_TICK_MS - 1) / POOL_TICK_MS;
+    if (self && (affinity < 0 || &workers[affinity % num_workers] == self)) {
+        timer_add(&self->wheel, &pt->timer, expires);
+        return 0;
+    }
+    pt->timer.expires = expires;
+    if (pool_submit(arm, pt, affinity) != 0) {
+        free(pt);
+        return -1;
+    }
+    return 0;
+}
+
+static void fire(Timer *t, void *arg) {
+    Worker *w = arg;
+    PoolTimer *pt = (PoolTimer *)t;
+    Task task = pt->task;
+    pt->next_free = w->free_timers;  // fn may re-arm with it
+    w->free_timers = pt;
+    w->fired++;
+    task.fn(task.arg);
+}
+
+/* another worker's oldest task, starting after w */
+static int steal(Worker *w, Task *t) {
+    for (int i = 1; i < num_workers; i++)
+        if (take(&workers[(w->id + i) % num_workers], 1, t)) return 1;
+    return 0;
+}
+
+static void *worker_loop(void *arg) {
+    Worker *w = self = arg;
+    trace_thread_name("pool");
+    while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+        wheel_advance(&w->wheel, now_ticks(), fire, w);
+        Task t;
+        int stolen = 0;
+        if (take(w, 0, &t) || (stolen = steal(w, &t))) {
+            t.fn(t.arg);
+            w->executed++;
+            w->stolen += stolen;
+            continue;
+        }
+
+        // nothing to do: sleep until a submit, or the next tick
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        if (w->wheel.count) until.tv_nsec += POOL_TICK_MS * 1000000L;
+        else until.tv_sec += 1;
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+        pthread_mutex_lock(&w->lock);
+        if (w->bottom == w->top && !stopping) {
+            __atomic_store_n(&w->sleeping, 1, __ATOMIC_RELAXED);
+            pthread_cond_timedwait(&w->wake, &w->lock, &until);
+            __atomic_store_n(&w->sleeping, 0, __ATOMIC_RELAXED);
+        }
+        pthread_mutex_unlock(&w->lock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief starts n workers
+ * @return int: 0, -1 if out of memory or already running
+ */
+int start_pool(int n) {
+    if (num_workers || n < 1) return -1;
+    workers = calloc(n, sizeof(Worker));
+    if (!workers) return -1;
+    stopping = 0;
+    for (int i = 0; i < n; i++) {
+        Worker *w = &workers[i];
+        w->id = i;
+        w->size = 256;
+        w->tasks = malloc(w->size * sizeof(Task));
+        if (!w->tasks) return -1;
+        pthread_mutex_init(&w->lock, NULL);
+        pthread_cond_init(&w->wake, NULL);
+        wheel_init(&w->wheel, now_ticks());
+    }
+    num_workers = n;  // before any worker can submit
+    for (int i = 0; i < n; i++)
+        pthread_create(&workers[i].thread, NULL, worker_loop, &workers[i]);
+    return 0;
+}
+
+/* frees the timers still pending on w's wheel, and its free list */
+static void drop_timers(Worker *w) {
+    while (w->free_timers) {
+        PoolTimer *pt = w->free_timers;
+        w->free_timers = pt->next_free;
+        free(pt);
+    }
+    for (int l = 0; l < WHEEL_LEVELS; l++)
+        for (int s = 0; s < WHEEL_SIZE; s++) {
+            Timer *head = &w->wheel.slots[l][s];
+            while (head->next != head) {
+                Timer *t = head->next;
+                timer_del(&w->wheel, t);
+                free(t);
+            }
+        }
+}
+
+/**
+ * @brief stops and joins the workers once their current tasks return;
+ * queued tasks and pending timers are dropped
+ */
+void stop_pool() {
+    if (!num_workers) return;
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < num_workers; i++) {
+        pthread_mutex_lock(&workers[i].lock);
+        pthread_cond_signal(&workers[i].wake);
+        pthread_mutex_unlock(&workers[i].lock);
+    }
+    for (int i = 0; i < num_workers; i++) pthread_join(workers[i].thread, NULL);
+    for (int i = 0; i < num_workers; i++) {
+        Worker *w = &workers[i];
+        while (w->bottom != w->top) {  // timers waiting to be armed
+            Task t = w->tasks[w->top++ % w->size];
+            if (t.fn == arm) free(t.arg);
+        }
+        drop_timers(w);
+        free(w->tasks);
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->wake);
+    }
+    free(workers);
+    workers = NULL;
+    num_workers = 0;
+}
+
+/* number of workers, 0 when the pool is not running */
+int pool_workers() {
+    return num_workers;
+}
+
+/* tasks run, stolen and timers fired by each worker */
+void pool_report(FILE *out) {
+    for (int i = 0; i < num_workers; i++)
+        fprintf(out, "pool worker %2d  executed %9ld  stolen %8ld  timers "
+                "%9ld\n", i, workers[i].executed, workers[i].stolen,
+                workers[i].fired);
+}
@@ -0,0 +1,159 @@
+/**
+ * @file protocol.c
+ * @brief formatting and parsing of the JSON messages in
+ * communication-protocol.md. Parsing is done by the tokenizer in
+ * json.c.
+ */
+#include "headers/protocol.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "headers/json.h"
+
+/**
+ * @brief parses one complete message (with or without its '\n') into
+ * msg. Connections parse incrementally with json_feed() instead.
+ * @return int: 0 on success, -1 if it is not a message of a known type
+ */
+int parse_message(const char *json, size_t len, Message *msg) {
+    JsonParser p;
+    size_t used;
+    json_init(&p, msg);
+    int rc = json_feed(&p, json, len, &used);
+    if (rc == JSON_MORE && len > 0 && json[len - 1] != '\n')
+        rc = json_feed(&p, "\n", 1, &used);
+    return rc == JSON_DONE ? 0 : -1;
+}
+
+/* encoding is "json" or "binary" (see wire.c), telemetry "udp" or ""
+ * (see telemetry.c) */
+int format_handshake(char *buf, size_t size, const char *drone_id,
+                     const char *encoding, const char *telemetry) {
+    return snprintf(buf, size,
+                    "{\"type\": \"HANDSHAKE\", \"drone_id\": \"%s\", "
+                    "\"encoding\": \"%s\", %s%s%s"
+                    "\"capabilities\": {\"max_speed\": 30, "
+                    "\"battery_capacity\": 100, \"payload\": \"medical\"}}\n",
+                    drone_id, encoding, telemetry[0] ? "\"telemetry\": \"" : "",
+                    telemetry, telemetry[0] ? "\", " : "");
+}
+
+int format_status_update(char *buf, size_t size, const char *drone_id,
+                         Coord location, const char *status, int battery,
+                         int speed) {
+    return snprintf(buf, size,
+                    "{\"type\": \"STATUS_UPDATE\", \"drone_id\": \"%s\", "
+                    "\"timestamp\": %ld, \"location\": {\"x\": %d, \"y\": %d}, "
+                    "\"status\": \"%s\", \"battery\": %d, \"speed\": %d}\n",
+                    drone_id, (long)time(NULL), location.x, location.y, status,
+                    battery, speed);
+}
+
+int format_mission_complete(char *buf, size_t size, const char *drone_id,
+                            const char *mission_id, int success) {
+    return snprintf(buf, size,
+                    "{\"type\": \"MISSION_COMPLETE\", \"drone_id\": \"%s\", "
+                    "\"mission_id\": \"%s\", \"timestamp\": %ld, "
+                    "\"success\": %s, \"details\": \"Delivered aid to "
+                    "survivor.\"}\n",
+                    drone_id, mission_id, (long)time(NULL),
+                    success ? "true" : "false");
+}
+
+int format_heartbeat_response(char *buf, size_t size, const char *drone_id) {
+    return snprintf(buf, size,
+                    "{\"type\": \"HEARTBEAT_RESPONSE\", \"drone_id\": \"%s\", "
+                    "\"timestamp\": %ld}\n",
+                    drone_id, (long)time(NULL));
+}
+
+/* telemetry_port 0: no UDP telemetry channel (see telemetry.c) */
+int format_handshake_ack(char *buf, size_t size, const char *session_id,
+                         int status_update_interval, int heartbeat_interval,
+                         const char *encoding, int telemetry_port,
+                         unsigned int telemetry_id, unsigned int telemetry_key) {
+    char telemetry[96] = "";
+    if (telemetry_port)
+        snprintf(telemetry, sizeof(telemetry),
+                 ", \"telemetry_port\": %d, \"telemetry_id\": %u, "
+                 "\"telemetry_key\": %u",
+                 telemetry_port, telemetry_id, telemetry_key);
+    return snprintf(buf, size,
+                    "{\"type\": \"HANDSHAKE_ACK\", \"session_id\": \"%s\", "
+                    "\"encoding\": \"%s\", "
+                    "\"config\": {\"status_update_interval\": %d, "
+                    "\"heartbeat_interval\": %d%s}}\n",
+                    session_id, encoding, status_update_interval,
+                    heartbeat_interval, telemetry);
+}
+
+int format_assign_mission(char *buf, size_t size, const char *mission_id,
+                          const char *priority, Coord target, long expiry) {
+    return snprintf(buf, size,
+                    "{\"type\": \"ASSIGN_MISSION\", \"mission_id\": \"%s\", "
+                    "\"priority\": \"%s\", \"target\": {\"x\": %d, \"y\": %d}, "
+                    "\"expiry\": %ld}\n",
+                    mission_id, priority, target.x, target.y, expiry);
+}
+
+int format_heartbeat(char *buf, size_t size) {
+    return snprintf(buf, size, "{\"type\": \"HEARTBEAT\", \"timestamp\": %ld}\n",
+                    (long)time(NULL));
+}
+
+int format_error(char *buf, size_t size, int code, const char *message) {
+    return snprintf(buf, size,
+                    "{\"type\": \"ERROR\", \"code\": %d, \"message\": \"%s\", "
+                    "\"timestamp\": %ld}\n",
+                    code, message, (long)time(NULL));
+}
+
+/* a new status_update_interval for one drone, see server.c */
+int format_config_update(char *buf, size_t size, int status_update_interval) {
+    return snprintf(buf, size,
+                    "{\"type\": \"CONFIG_UPDATE\", "
+                    "\"config\": {\"status_update_interval\": %d}, "
+                    "\"timestamp\": %ld}\n",
+                    status_update_interval, (long)time(NULL));
+}
+
+/**
+ * @brief formats any server -> drone or drone -> server message from
+ * its Message fields
+ * @return int: length, -1 for MSG_UNKNOWN
+ */
+int format_message(char *buf, size_t size, const Message *m) {
+    switch (m->type) {
+        case MSG_HANDSHAKE:
+            return format_handshake(buf, size, m->drone_id,
+                                    m->encoding[0] ? m->encoding : "json",
+                                    m->telemetry);
+        case MSG_STATUS_UPDATE:
+            return format_status_update(buf, size, m->drone_id, m->location,
+                                        m->status, m->battery, m->speed);
+        case MSG_MISSION_COMPLETE:
+            return format_mission_complete(buf, size, m->drone_id,
+                                           m->mission_id, m->success);
+        case MSG_HEARTBEAT_RESPONSE:
+            return format_heartbeat_response(buf, size, m->drone_id);
+        case MSG_HANDSHAKE_ACK:
+            return format_handshake_ack(buf, size, m->session_id,
+                                        m->status_update_interval,
+                                        m->heartbeat_interval,
+                                        m->encoding[0] ? m->encoding : "json",
+                                        m->telemetry_port, m->telemetry_id,
+                                        m->telemetry_key);
+        case MSG_ASSIGN_MISSION:
+            return format_assign_mission(buf, size, m->mission_id, m->priority,
+                                         m->target, m->expiry);
+        case MSG_HEARTBEAT:
+            return format_heartbeat(buf, size);
+        case MSG_ERROR:
+            return format_error(buf, size, m->code, m->error);
+        case MSG_CONFIG_UPDATE:
+            return format_config_update(buf, size, m->status_update_interval);
+        default:
+            return -1;
+    }
+}
@@ -0,0 +1,89 @@
+/**
+ * @file publisher.c
+ * @brief the simulation side of the snapshots: copies the map and the
+ * drones list into a snapshot once per tick.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "headers/drone.h"
+#include "headers/globals.h"
+#include "headers/lockprof.h"
+#include "headers/snapshot.h"
+#include "headers/stream.h"
+
+static unsigned long next_seq = 1;
+static unsigned char *occupancy;  // running copy of snapshot occupancy
+
+/* copies drone positions from the drones list into s->drones; holds
+ * drones->lock throughout and each drone's lock for its copy (see the
+ * limit in snapshot.h) */
+static void copy_drones(WorldSnapshot *s) {
+    prof_lock(&drones->lock);
+    if (drones->number_of_elements > s->drone_capacity) {
+        s->drone_capacity = drones->number_of_elements * 2;
+        free(s->drones);
+        s->drones = malloc(sizeof(DroneView) * s->drone_capacity);
+        if (!s->drones) {
+            perror("Failed to allocate snapshot drones");
+            exit(EXIT_FAILURE);
+        }
+    }
+    int n = 0;
+    for (Node *node = drones->head; node != NULL; node = node->next) {
+        Drone *d = *(Drone **)node->data;
+        prof_lock(&d->lock);
+        s->drones[n] = (DroneView){.id = d->id,
+                                   .status = d->status,
+                                   .coord = d->coord,
+                                   .target = d->target};
+        prof_unlock(&d->lock);
+        n++;
+    }
+    prof_unlock(&drones->lock);
+    s->num_drones = n;
+}
+
+/**
+ * @brief builds a snapshot of drones and survivor cells in the writer
+ * slot and makes it the latest one. Only cells in the map's dirty log
+ * are re-read, the rest of the occupancy is carried over.
+ */
+void publish_snapshot() {
+    WorldSnapshot *s = begin_snapshot();
+    int cells = s->height * s->width;
+
+    if (!occupancy) {
+        occupancy = calloc(cells, sizeof(unsigned char));
+        if (!occupancy) {
+            perror("Failed to allocate snapshot");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    s->num_dirty = take_dirty_cells(s->dirty, cells);
+    for (int k = 0; k < s->num_dirty; k++) {
+        int x = s->dirty[k] / s->width, y = s->dirty[k] % s->width;
+        List *list = map.cells[x][y].survivors;
+        prof_lock(&list->lock);
+        occupancy[s->dirty[k]] = list->number_of_elements > 0;
+        prof_unlock(&list->lock);
+    }
+    memcpy(s->occupied, occupancy, cells);
+    copy_drones(s);
+    s->seq = next_seq++;
+
+    stream_snapshot(s);  // no-op unless remote viewers are enabled
+    commit_snapshot();
+}
+
+void *snapshot_publisher(void *args) {
+    (void)args;  // Unused parameter
+    while (running) {
+        publish_snapshot();
+        usleep(SNAPSHOT_INTERVAL_MS * 1000);
+    }
+    return NULL;
+}
@@ -0,0 +1,698 @@
+/**
+ * @file reactor.c
+ * @brief edge-triggered epoll event loops for the drone server.
+ *
+ * Each reactor thread has its own epoll instance and its own listening
+ * socket on the same port (SO_REUSEPORT), so the kernel spreads new
+ * connections over the reactors and a connection stays on the thread
+ * that accepted it. Sockets are non-blocking; reads are drained until
+ * EAGAIN and cut into messages by framing.c. Replies are queued on the
+ * connection and flushed once per epoll batch, so all messages for one
+ * connection leave in a single sendmsg(); what the socket does not take
+ * stays queued until EPOLLOUT.
+ *
+ * Threads other than the owner (e.g. the AI) send through conn_send(),
+ * which puts the connection on the reactor's pending list and wakes
+ * the reactor with its eventfd.
+ *
+ * With reactor_io = IO_URING the loop of uring.c replaces epoll_wait()
+ * and the socket calls; connections, framing, the lists and the timers
+ * stay the ones here.
+ *
+ * With shm_path set the first reactor also accepts drones on that unix
+ * socket and talks to them through shared memory (shm.c). Such a
+ * connection has two fds in the epoll set: its socket, which only
+ * reports the hangup, and its doorbell eventfd. Reads and flushes go
+ * to the rings instead of the socket. Epoll backend only.
+ */
+#define _GNU_SOURCE  // accept4
+#include "headers/reactor.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "headers/globals.h"
+#include "headers/trace.h"
+#include "headers/uring.h"
+#include "headers/wire.h"
+
+Reactor reactors[MAX_REACTORS];
+int num_reactors = 0;
+IoBackend reactor_io = IO_EPOLL;
+const char *shm_path = NULL;
+static Handlers *handlers;
+
+#define READ_BUDGET 2  // recv()s per connection and turn, see read_ready()
+
+/* Open connections by fd. epoll events carry the fd, which indexes
+ * straight into the table; each entry is only written by the reactor
+ * that accepted the fd, so no lock is needed. */
+static Conn **conn_table;
+static int conn_table_size;
+
+/**
+ * @brief the open connection on fd; only valid on the reactor thread
+ * that owns fd
+ * @return Conn*: NULL if fd is not an open connection
+ */
+Conn *conn_lookup(int fd) {
+    if (fd < 0 || fd >= conn_table_size) return NULL;
+    return conn_table[fd];
+}
+
+static int open_listener(int port) {
+    struct sockaddr_in addr = {.sin_family = AF_INET,
+                               .sin_port = htons(port),
+                               .sin_addr.s_addr = htonl(INADDR_ANY)};
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int open_shm_listener(const char *path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+    unlink(path);  // left over from an earlier run
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void free_conn(Conn *c) {
+    pthread_mutex_destroy(&c->wlock);
+    outq_free(&c->out);
+    free(c);
+}
+
+/* closed and nothing refers to c any more; caller holds c->wlock */
+static int conn_done(Conn *c) {
+    return c->closed && !c->write_pending && !c->flush_queued &&
+           !c->ready_queued && !c->io_ops;
+}
+
+/* frees c if it is done, e.g. after its last io_uring request */
+void conn_release(Conn *c) {
+    pthread_mutex_lock(&c->wlock);
+    int done = conn_done(c);
+    pthread_mutex_unlock(&c->wlock);
+    if (done) free_conn(c);
+}
+
+/* puts c on the list flushed once the current epoll batch is handled;
+ * reactor thread only */
+static void queue_flush(Reactor *r, Conn *c) {
+    if (c->flush_queued) return;
+    c->flush_queued = 1;
+    c->next_flush = r->flush;
+    r->flush = c;
+}
+
+size_t conn_queue_limit = 256 * 1024;
+
+/**
+ * @brief queues msg on the connection. Safe to call from any thread
+ * while the connection is open. Everything queued for a connection
+ * during one event-loop iteration goes out in a single sendmsg().
+ * A connection whose unsent bytes would pass conn_queue_limit is shut
+ * down instead.
+ * @return int: 0 if queued, -1 if the connection is closed or full
+ */
+int conn_send(Conn *c, const char *msg, size_t len) {
+    pthread_mutex_lock(&c->wlock);
+    if (c->closed) {
+        pthread_mutex_unlock(&c->wlock);
+        return -1;
+    }
+    if (c->out.bytes + len > conn_queue_limit) {
+        // the peer stopped reading: drop it rather than buffer forever
+        if (!c->overflowed) {
+            c->overflowed = 1;
+            __atomic_add_fetch(&c->reactor->overflows, 1, __ATOMIC_RELAXED);
+            shutdown(c->fd, SHUT_RDWR);  // EPOLLHUP closes it
+        }
+        pthread_mutex_unlock(&c->wlock);
+        return -1;
+    }
+    if (outq_push(&c->out, msg, len) != 0) {
+        pthread_mutex_unlock(&c->wlock);
+        return -1;
+    }
+
+    Reactor *r = c->reactor;
+    if (pthread_equal(pthread_self(), r->thread)) {
+        queue_flush(r, c);
+    } else if (!c->write_pending) {
+        c->write_pending = 1;
+        pthread_mutex_lock(&r->pending_lock);
+        c->next_pending = r->pending;
+        r->pending = c;
+        pthread_mutex_unlock(&r->pending_lock);
+        uint64_t one = 1;
+        write(r->wake_fd, &one, sizeof(one));
+    }
+    pthread_mutex_unlock(&c->wlock);
+    return 0;
+}
+
+/**
+ * @brief asks the reactor to close the connection once the current
+ * event is handled (e.g. from on_message after a protocol error)
+ */
+void conn_close(Conn *c) {
+    shutdown(c->fd, SHUT_RD);  // shows up as EPOLLRDHUP / recv() == 0
+}
+
+static long now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+/* current time in timer wheel ticks */
+static unsigned long now_ticks() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000UL + ts.tv_nsec / 1000000) / TIMER_TICK_MS;
+}
+
+/**
+ * @brief (re)arms the connection's timer to call handlers->on_timer in
+ * ms milliseconds; call from the connection's reactor thread
+ */
+void conn_set_timer(Conn *c, int ms) {
+    Reactor *r = c->reactor;
+    timer_add(&r->wheel, &c->timer,
+              now_ticks() + (ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS);
+}
+
+/**
+ * @brief runs on_close and closes the connection. With io_uring the fd
+ * stays open until its last request completed, see uring_close().
+ */
+void conn_close_now(Reactor *r, Conn *c) {
+    if (handlers->on_close) handlers->on_close(c);
+    if (reactor_io == IO_EPOLL) epoll_ctl(r->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    timer_del(&r->wheel, &c->timer);
+    conn_table[c->fd] = NULL;  // the fd number may be reused after close
+    if (c->shm) {
+        epoll_ctl(r->epfd, EPOLL_CTL_DEL, c->shm->bell, NULL);
+        conn_table[c->shm->bell] = NULL;
+    }
+
+    pthread_mutex_lock(&c->wlock);
+    r->connections--;
+    c->closed = 1;
+    if (c->shm) {
+        shm_flush(&c->out, c->shm);  // best effort, e.g. a final ERROR
+        shm_close(c->shm);
+        c->shm = NULL;
+    } else if (reactor_io == IO_URING) {
+        uring_close(r, c);  // best effort, e.g. a final ERROR
+    } else {
+        outq_flush(&c->out, c->fd);  // best effort, e.g. a final ERROR
+    }
+    if (!c->io_ops) close(c->fd);
+    // otherwise reactor_take_pending, flush_all, read_ready or uring.c
+    // frees it
+    int done = conn_done(c);
+    pthread_mutex_unlock(&c->wlock);
+    if (done) free_conn(c);
+}
+
+/**
+ * @brief sets up an accepted connection and runs on_open
+ * @return Conn*: NULL if fd is past the table or out of memory; the
+ * caller closes fd then
+ */
+Conn *conn_open(Reactor *r, int fd) {
+    Conn *c = fd < conn_table_size ? calloc(1, sizeof(Conn)) : NULL;
+    if (!c) return NULL;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    c->fd = fd;
+    c->reactor = r;
+    c->timer.data = c;
+    frame_reader_init(&c->in);
+    pthread_mutex_init(&c->wlock, NULL);
+    conn_table[fd] = c;
+    r->connections++;
+    if (handlers->on_open) handlers->on_open(c);
+    return c;
+}
+
+static void accept_all(Reactor *r) {
+    while (1) {
+        int fd = accept4(r->listen_fd, NULL, NULL, SOCK_NONBLOCK);
+        r->syscalls++;
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            r->accept_retry = 0;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            // e.g. EMFILE: the backlog stays, and edge triggered no new
+            // event may come for it, so the loop retries every tick
+            perror("accept");
+            r->accept_retry = now_us() + TIMER_TICK_MS * 1000;
+            return;
+        }
+        struct epoll_event ev = {
+            .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+            .data.fd = fd};
+        if (fd >= conn_table_size ||
+            epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            continue;
+        }
+        if (!conn_open(r, fd)) close(fd);  // also leaves the epoll set
+    }
+}
+
+/**
+ * @brief encodes msg in the connection's negotiated encoding and
+ * queues it, see conn_send()
+ * @return int: 0 if queued, -1 if it could not be encoded or sent
+ */
+int conn_send_message(Conn *c, const Message *msg) {
+    char buf[MAX_MESSAGE];
+    int len = c->binary
+                  ? encode_binary(msg, (unsigned char *)buf, sizeof(buf))
+                  : format_message(buf, sizeof(buf), msg);
+    if (len <= 0 || len >= (int)sizeof(buf)) return -1;
+    return conn_send(c, buf, len);
+}
+
+void conn_send_error(Conn *c, int code, const char *message) {
+    Message msg = {.type = MSG_ERROR, .code = code, .timestamp = time(NULL)};
+    strncpy(msg.error, message, sizeof(msg.error) - 1);
+    conn_send_message(c, &msg);
+}
+
+/* hands out the complete messages in c->in; -1 to close c */
+static int parse_input(Reactor *r, Conn *c) {
+    Message *msg;
+    int rc;
+    // on_message may switch c->binary (HANDSHAKE) between messages
+    while ((rc = frame_next(&c->in, c->binary, &msg)) != FRAME_MORE) {
+        if (rc == FRAME_TOO_LONG) {
+            conn_send_error(c, 400, "Message too long.");
+            return -1;
+        }
+        if (rc == FRAME_INVALID) {
+            conn_send_error(c, 400, c->binary ? "Invalid frame."
+                                              : "Invalid JSON.");
+            continue;
+        }
+        handlers->on_message(c, msg);
+        r->messages++;
+    }
+    return 0;
+}
+
+/**
+ * @brief feeds n received bytes to the connection, for a backend that
+ * received them into its own buffer (io_uring provided buffers)
+ * @return int: -1 once the connection should be closed
+ */
+int conn_input(Reactor *r, Conn *c, const char *data, size_t n) {
+    while (n > 0) {
+        size_t room;
+        char *space = frame_reader_space(&c->in, &room);
+        size_t chunk = n < room ? n : room;
+        if (chunk == 0) return -1;  // cannot happen, frames fit the buffer
+        memcpy(space, data, chunk);
+        frame_reader_commit(&c->in, chunk);
+        if (parse_input(r, c) != 0) return -1;
+        data += chunk;
+        n -= chunk;
+    }
+    return 0;
+}
+
+/* reads until EAGAIN, at most READ_BUDGET recv()s, and hands out
+ * complete messages. Returns -1 once the connection should be closed,
+ * 1 if it stopped at the budget. */
+static int handle_read(Reactor *r, Conn *c) {
+    for (int i = 0; i < READ_BUDGET; i++) {
+        size_t room;
+        char *space = frame_reader_space(&c->in, &room);
+        if (c->shm) {  // 0: empty, the drone rings when it writes
+            ssize_t n = shm_recv(c->shm, space, room);
+            if (n <= 0) return n;
+            frame_reader_commit(&c->in, n);
+            if (parse_input(r, c) != 0) return -1;
+            continue;
+        }
+        ssize_t n = recv(c->fd, space, room, 0);
+        r->syscalls++;
+        if (n == 0) return -1;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        frame_reader_commit(&c->in, n);
+        if (parse_input(r, c) != 0) return -1;
+    }
+    return 1;  // budget used up, the socket may hold more
+}
+
+/* c has unread data: read on in a later iteration (reactor thread) */
+static void queue_ready(Reactor *r, Conn *c) {
+    if (c->ready_queued) return;
+    c->ready_queued = 1;
+    c->next_ready = NULL;
+    if (r->ready_tail) r->ready_tail->next_ready = c;
+    else r->ready = c;
+    r->ready_tail = c;
+}
+
+/* a local drone on the unix socket: its channel, then a connection
+ * whose socket and doorbell both lead to it */
+static void accept_shm(Reactor *r) {
+    while (1) {
+        int fd = accept4(r->shm_fd, NULL, NULL, SOCK_NONBLOCK);
+        r->syscalls++;
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept");
+            return;
+        }
+        ShmLink *l = fd < conn_table_size ? shm_accept(fd) : NULL;
+        Conn *c = l && l->bell < conn_table_size ? conn_open(r, fd) : NULL;
+        if (!c) {
+            shm_close(l);
+            close(fd);
+            continue;
+        }
+        c->shm = l;
+        conn_table[l->bell] = c;
+        // the drone never writes to the socket: any event is its hangup
+        struct epoll_event ev = {.events = EPOLLIN | EPOLLRDHUP | EPOLLET,
+                                 .data.fd = fd};
+        epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev);
+        ev.data.fd = l->bell;
+        epoll_ctl(r->epfd, EPOLL_CTL_ADD, l->bell, &ev);
+        // the HANDSHAKE may have been written before we listened
+        queue_ready(r, c);
+    }
+}
+
+/* gives up to MAX_EVENTS connections from the ready queue their next
+ * READ_BUDGET, oldest first, so a few busy drones cannot hold up the
+ * loop and everyone else's events */
+static void read_ready(Reactor *r) {
+    for (int i = 0; i < MAX_EVENTS && r->ready; i++) {
+        Conn *c = r->ready;
+        r->ready = c->next_ready;
+        if (!r->ready) r->ready_tail = NULL;
+        c->ready_queued = 0;
+        if (c->closed) {
+            conn_release(c);
+            continue;
+        }
+        int rc = handle_read(r, c);
+        if (rc < 0) conn_close_now(r, c);
+        else if (rc > 0) queue_ready(r, c);
+    }
+}
+
+/* takes over the connections that other threads sent to, after the
+ * wake_fd was read */
+void reactor_take_pending(Reactor *r) {
+    pthread_mutex_lock(&r->pending_lock);
+    Conn *c = r->pending;
+    r->pending = NULL;
+    pthread_mutex_unlock(&r->pending_lock);
+
+    while (c) {
+        Conn *next = c->next_pending;
+        pthread_mutex_lock(&c->wlock);
+        c->write_pending = 0;
+        int done = conn_done(c);
+        if (!c->closed) queue_flush(r, c);
+        pthread_mutex_unlock(&c->wlock);
+        if (done) free_conn(c);
+        c = next;
+    }
+}
+
+/* writes out every connection that got messages in this iteration */
+static void flush_all(Reactor *r) {
+    Conn *c = r->flush;
+    r->flush = NULL;
+    while (c) {
+        Conn *next = c->next_flush;
+        pthread_mutex_lock(&c->wlock);
+        c->flush_queued = 0;
+        int done = conn_done(c);
+        if (!c->closed) {
+            long writes = c->out.writes;
+            if (c->shm) {
+                if (shm_flush(&c->out, c->shm) != 0)
+                    shutdown(c->fd, SHUT_RDWR);  // EPOLLHUP closes it
+                r->syscalls += c->out.writes - writes;  // doorbells
+            } else if (reactor_io == IO_URING) {
+                uring_send(r, c);  // goes out with the next io_uring_enter()
+            } else {
+                if (outq_flush(&c->out, c->fd) != 0)
+                    shutdown(c->fd, SHUT_RDWR);  // EPOLLHUP closes it
+                r->syscalls += c->out.writes - writes;
+            }
+            r->writes += c->out.writes - writes;
+            r->replies += c->out.messages - c->counted;
+            c->counted = c->out.messages;
+            if ((long)c->out.bytes > r->max_queued)
+                r->max_queued = c->out.bytes;
+        }
+        pthread_mutex_unlock(&c->wlock);
+        if (done) free_conn(c);
+        c = next;
+    }
+}
+
+static void fire_timer(Timer *t, void *arg) {
+    Conn *c = t->data;
+    if (handlers->on_timer && handlers->on_timer(c) != 0)
+        conn_close_now(arg, c);
+}
+
+/**
+ * @brief the end of every loop iteration: timers, then one write per
+ * connection with queued messages, then the lag estimate
+ * @param busy_from: when the iteration stopped waiting, in µs
+ * @param drained: this turn cleared a backlog; the average restarts
+ */
+void reactor_end_turn(Reactor *r, long busy_from, int drained) {
+    wheel_advance(&r->wheel, now_ticks(), fire_timer, r);
+    flush_all(r);
+
+    // an event that arrives now waits about this long to be handled
+    long busy = now_us() - busy_from;
+    long lag = __atomic_load_n(&r->lag_us, __ATOMIC_RELAXED);
+    lag = drained ? busy : lag + (busy - lag) / 8;
+    __atomic_store_n(&r->lag_us, lag, __ATOMIC_RELAXED);
+    if (busy > r->max_lag_us) r->max_lag_us = busy;
+}
+
+static void *reactor_loop(void *arg) {
+    Reactor *r = arg;
+    struct epoll_event events[MAX_EVENTS];
+    trace_thread_name("reactor");
+
+    while (running) {
+        // one wakeup per tick at most; an idle wheel costs nothing more
+        int n = epoll_wait(r->epfd, events, MAX_EVENTS,
+                           r->ready                           ? 0
+                           : r->wheel.count || r->accept_retry ? TIMER_TICK_MS
+                                                               : 200);
+        r->syscalls++;
+        long busy_from = now_us();
+        if (r->accept_retry && busy_from >= r->accept_retry) accept_all(r);
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == r->listen_fd) {
+                accept_all(r);
+                continue;
+            }
+            if (fd == r->wake_fd) {
+                uint64_t count;
+                read(r->wake_fd, &count, sizeof(count));
+                r->syscalls++;
+                reactor_take_pending(r);
+                continue;
+            }
+            if (fd == r->shm_fd) {
+                accept_shm(r);
+                continue;
+            }
+            Conn *c = conn_table[fd];
+            if (!c) continue;
+            uint32_t e = events[i].events;
+            if (c->shm) {
+                if (fd == c->fd) {  // the drone hung up
+                    conn_close_now(r, c);
+                    continue;
+                }
+                shm_ack_bell(c->shm);  // new data, or room for ours
+                r->syscalls++;
+                queue_flush(r, c);
+            }
+            if (e & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                int rc = handle_read(r, c);
+                if (rc < 0) {
+                    conn_close_now(r, c);
+                    continue;
+                }
+                if (rc > 0) queue_ready(r, c);
+            }
+            if (e & EPOLLOUT) queue_flush(r, c);
+        }
+        read_ready(r);
+        reactor_end_turn(r, busy_from, 0);
+    }
+    return NULL;
+}
+
+/* epoll set with the listener and the wake eventfd */
+static int epoll_setup(Reactor *r) {
+    r->epfd = epoll_create1(0);
+    if (r->epfd < 0) return -1;
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLET,
+                             .data.fd = r->listen_fd};
+    epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->listen_fd, &ev);
+    ev.data.fd = r->wake_fd;
+    epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->wake_fd, &ev);
+    if (r->shm_fd >= 0) {
+        ev.data.fd = r->shm_fd;
+        epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->shm_fd, &ev);
+    }
+    return 0;
+}
+
+/**
+ * @brief starts n reactor threads listening on port. If the io_uring
+ * backend cannot be set up (old kernel, io_uring disabled) all
+ * reactors use epoll instead.
+ * @return int: 0 on success, -1 if a listener or epoll set fails
+ */
+int start_reactors(int n, int port, Handlers *h) {
+    handlers = h;
+    if (n > MAX_REACTORS) n = MAX_REACTORS;
+
+    // every fd the process can open gets a table entry
+    struct rlimit rl;
+    conn_table_size = MAX_FDS;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        if (rl.rlim_cur > MAX_FDS) {
+            rl.rlim_cur = MAX_FDS;
+            setrlimit(RLIMIT_NOFILE, &rl);
+        }
+        conn_table_size = rl.rlim_cur;
+    }
+    conn_table = calloc(conn_table_size, sizeof(Conn *));
+    if (!conn_table) return -1;
+    for (int i = 0; i < n; i++) {
+        Reactor *r = &reactors[i];
+        memset(r, 0, sizeof(Reactor));
+        r->id = i;
+        r->epfd = -1;
+        r->shm_fd = -1;
+        r->listen_fd = open_listener(port);
+        r->wake_fd = eventfd(0, EFD_NONBLOCK);
+        if (r->listen_fd < 0 || r->wake_fd < 0) {
+            perror("reactor setup");
+            return -1;
+        }
+        pthread_mutex_init(&r->pending_lock, NULL);
+        wheel_init(&r->wheel, now_ticks());
+
+        if (reactor_io == IO_URING && uring_setup(r) != 0) {
+            if (i > 0) return -1;
+            perror("io_uring setup, using epoll");
+            reactor_io = IO_EPOLL;
+        }
+        if (i == 0 && shm_path && reactor_io == IO_URING) {
+            fprintf(stderr, "shared memory needs --io epoll, not served\n");
+            shm_path = NULL;
+        }
+        if (i == 0 && shm_path) {
+            r->shm_fd = open_shm_listener(shm_path);
+            if (r->shm_fd < 0) {
+                perror(shm_path);
+                return -1;
+            }
+        }
+        if (reactor_io == IO_EPOLL && epoll_setup(r) != 0) {
+            perror("epoll setup");
+            return -1;
+        }
+
+        pthread_create(&r->thread, NULL,
+                       reactor_io == IO_URING ? uring_loop : reactor_loop, r);
+        num_reactors++;
+    }
+    return 0;
+}
+
+/**
+ * @brief joins the reactors once running is cleared, then closes and
+ * frees every connection still open. Nothing else may send on a
+ * connection by then (stop the AI and telemetry first); on_close is not
+ * run for these.
+ */
+void stop_reactors() {
+    // reactor_loop returns once running is cleared
+    for (int i = 0; i < num_reactors; i++)
+        pthread_join(reactors[i].thread, NULL);
+    for (int i = 0; i < num_reactors; i++) {
+        Reactor *r = &reactors[i];
+        close(r->listen_fd);
+        close(r->wake_fd);
+        if (r->shm_fd >= 0) {
+            close(r->shm_fd);
+            unlink(shm_path);
+        }
+        if (r->ring) uring_free(r);
+        else close(r->epfd);
+        pthread_mutex_destroy(&r->pending_lock);
+    }
+    num_reactors = 0;
+    // with the rings gone no request refers to a connection's buffers
+    for (int fd = 0; fd < conn_table_size; fd++) {
+        Conn *c = conn_table[fd];
+        if (!c || c->fd != fd) continue;  // a shm bell: its owner's fd
+        if (c->shm) conn_table[c->shm->bell] = NULL;
+        shm_close(c->shm);
+        close(fd);
+        conn_table[fd] = NULL;
+        free_conn(c);
+    }
+    free(conn_table);
+    conn_table = NULL;
+    conn_table_size = 0;
+}
@@ -0,0 +1,279 @@
+/**
+ * @file region.c
+ * @brief region-partitioned AI, see region.h.
+ *
+ * Each worker runs the ai_controller() loop over its own region: claim
+ * the next waiting mission, let go of missions.lock, find the closest
+ * idle drone of the region, then take the lock again to start the
+ * mission or put it back. When its own queues are empty it steals from
+ * the starved region with the most missions waiting. A region turning
+ * starved wakes the other workers; the survivor of a stolen mission may
+ * be far from the drone, but nearer than no drone at all.
+ */
+#include "headers/region.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "headers/ai.h"
+#include "headers/globals.h"
+#include "headers/lockprof.h"
+#include "headers/map.h"
+#include "headers/mission.h"
+#include "headers/pool.h"
+#include "headers/trace.h"
+
+Region *regions = NULL;
+int num_regions = 0;
+static int pooled;  // workers are pool tasks
+
+/* frees the drone lists and the regions, for init and stop */
+static void free_regions(int k) {
+    for (int r = 0; r < k; r++)
+        if (regions[r].drones) regions[r].drones->destroy(regions[r].drones);
+    free(regions);
+    regions = NULL;
+    num_regions = 0;
+}
+
+/**
+ * @brief splits the map into k bands of rows and the mission table's
+ * queues with it; before any drone is tracked or mission opened
+ * @param max_drones: capacity of each region's drone list
+ * @return int: 0, -1 if out of memory or missions are open
+ */
+int regions_init(int k, int max_drones) {
+    if (k < 1) k = 1;
+    if (k > map.height) k = map.height;  // at least a row each
+    regions = calloc(k, sizeof(Region));
+    if (!regions) return -1;
+    for (int r = 0; r < k; r++) {
+        regions[r].id = r;
+        regions[r].first_row = r * map.height / k;
+        regions[r].rows = (r + 1) * map.height / k - regions[r].first_row;
+        regions[r].drones = create_list(sizeof(Drone *), max_drones);
+        if (!regions[r].drones) {
+            free_regions(r);
+            return -1;
+        }
+    }
+    num_regions = k;
+    if (mission_partition(k, region_of) != 0) {
+        free_regions(k);
+        return -1;
+    }
+    return 0;
+}
+
+/* the region of a map cell */
+int region_of(Coord c) {
+    int r = c.x * num_regions / map.height;
+    return r < 0 ? 0 : r >= num_regions ? num_regions - 1 : r;
+}
+
+/**
+ * @brief puts d in the drone list of the region it is in, after it was
+ * added or moved. A no-op without regions and within its region.
+ */
+void region_track(Drone *d) {
+    if (!num_regions) return;
+    Region *to = &regions[region_of(d->coord)];
+    Region *from = __atomic_load_n(&d->region, __ATOMIC_ACQUIRE);
+    if (from == to) return;
+
+    // both lists, in region order
+    Region *first = from && from->id < to->id ? from : to;
+    Region *second = first == to ? from : to;
+    prof_lock(&first->drones->lock);
+    if (second) prof_lock(&second->drones->lock);
+    // unless another thread moved it meanwhile
+    if (__atomic_load_n(&d->region, __ATOMIC_RELAXED) == from) {
+        if (from) from->drones->removedata(from->drones, &d);
+        if (to->drones->add(to->drones, &d))
+            __atomic_store_n(&d->region, to, __ATOMIC_RELEASE);
+        else
+            __atomic_store_n(&d->region, NULL, __ATOMIC_RELEASE);
+    }
+    if (second) prof_unlock(&second->drones->lock);
+    prof_unlock(&first->drones->lock);
+}
+
+/* the idle drone of r closest to target, NULL if none is idle */
+static Drone *closest_idle(Region *r, Coord target) {
+    long t = trace_now();
+    Drone *closest = NULL;
+    int min_distance = -1;
+    prof_lock(&r->drones->lock);
+    for (Node *node = r->drones->head; node != NULL; node = node->next) {
+        Drone *d = *(Drone **)node->data;
+        if (d->status != IDLE) continue;
+        int dist = abs(d->coord.x - target.x) + abs(d->coord.y - target.y);
+        if (min_distance < 0 || dist < min_distance) {
+            min_distance = dist;
+            closest = d;
+        }
+    }
+    prof_unlock(&r->drones->lock);
+    trace_span("nearest_drone", t, closest ? closest->id : 0);
+    return closest;
+}
+
+/* claims a mission of the starved region with the most waiting, for
+ * r's drones; caller holds missions.lock */
+static Mission *steal(Region *r) {
+    int victim = -1, most = 0;
+    for (int v = 0; v < num_regions; v++) {
+        int waiting = missions.region[v].waiting;
+        if (v != r->id && regions[v].starved && waiting > most) {
+            victim = v;
+            most = waiting;
+        }
+    }
+    return victim < 0 ? NULL : mission_claim(victim);
+}
+
+static void schedule(int id);
+
+static void starve(Region *r) {
+    if (r->starved) return;
+    r->starved = 1;
+    for (int v = 0; v < num_regions; v++) {
+        if (v == r->id) continue;
+        pthread_cond_signal(&missions.region[v].wake);
+        if (pooled) schedule(v);
+    }
+}
+
+/* one pass over r's missions, then stolen ones; caller holds
+ * missions.lock, released while searching drones */
+static void match(Region *r) {
+    for (;;) {
+        Mission *m = mission_claim(r->id);
+        int stolen = 0;
+        if (!m) {
+            r->starved = 0;  // nothing of its own waits
+            if (!(m = steal(r))) return;
+            stolen = 1;
+        }
+        Coord target = m->survivor.coord;
+        pthread_mutex_unlock(&missions.lock);
+        Drone *d = closest_idle(r, target);
+        pthread_mutex_lock(&missions.lock);
+        if (!d) {
+            mission_unclaim(m);
+            if (!stolen) starve(r);
+            return;
+        }
+        if (assign_mission(d, m) != 0) {  // busy since: search again
+            mission_unclaim(m);
+            continue;
+        }
+        if (!stolen) r->starved = 0;
+        r->assigned++;
+        r->stolen += stolen;
+        printf("Drone %d assigned to survivor %s at (%d, %d)\n", d->id,
+               m->survivor.info, m->survivor.coord.x, m->survivor.coord.y);
+    }
+}
+
+/* ai_controller() for one region; region 0 also expires missions */
+static void *region_worker(void *arg) {
+    Region *r = arg;
+    MissionQueue *q = &missions.region[r->id];
+    trace_thread_name("ai");
+    pthread_mutex_lock(&missions.lock);
+    while (running) {
+        long t = trace_now();
+        int expired = r->id == 0 ? mission_expire(time(NULL)) : 0;
+        if (expired) {  // log unlocked; match() below sees any wakeup
+            pthread_mutex_unlock(&missions.lock);
+            printf("%d missions expired\n", expired);
+            pthread_mutex_lock(&missions.lock);
+        }
+        match(r);
+        trace_span("ai_pass", t, q->waiting);
+
+        // sleep until woken, the next deadline or a second from now
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += 1;
+        Mission *first = missions.deadlines.next;
+        if (r->id == 0 && first != &missions.deadlines && first->deadline &&
+            first->deadline < until.tv_sec) {
+            until.tv_sec = first->deadline;
+            until.tv_nsec = 0;
+        }
+        pthread_cond_timedwait(&q->wake, &missions.lock, &until);
+    }
+    pthread_mutex_unlock(&missions.lock);
+    return NULL;
+}
+
+/* one pass of region_worker() on the pool */
+static void region_task(void *arg) {
+    Region *r = arg;
+    __atomic_store_n(&r->scheduled, 0, __ATOMIC_RELEASE);  // wakes from now
+    pthread_mutex_lock(&missions.lock);
+    long t = trace_now();
+    int expired = r->id == 0 ? mission_expire(time(NULL)) : 0;
+    match(r);
+    trace_span("ai_pass", t, missions.region[r->id].waiting);
+    pthread_mutex_unlock(&missions.lock);
+    if (expired) printf("%d missions expired\n", expired);
+}
+
+/* mission_notify: a pass of region id, unless one is queued already */
+static void schedule(int id) {
+    Region *r = &regions[id];
+    if (!__atomic_exchange_n(&r->scheduled, 1, __ATOMIC_ACQ_REL))
+        pool_submit(region_task, r, id);
+}
+
+/* what the workers' one second timeout does: deadlines, drones that
+ * became idle unnoticed */
+static void regions_tick(void *arg) {
+    if (!running) return;
+    for (int r = 0; r < num_regions; r++) schedule(r);
+    pool_after(1000, regions_tick, arg, 0);
+}
+
+/* one worker thread per region in place of ai_controller(), or pool
+ * tasks if the pool runs */
+void regions_start() {
+    pooled = pool_workers() > 0;
+    if (pooled) {
+        pthread_mutex_lock(&missions.lock);
+        mission_notify = schedule;
+        pthread_mutex_unlock(&missions.lock);
+        regions_tick(NULL);
+        return;
+    }
+    for (int r = 0; r < num_regions; r++)
+        pthread_create(&regions[r].thread, NULL, region_worker, &regions[r]);
+}
+
+/* joins the workers once running is cleared (after stop_pool() for
+ * tasks), frees the regions */
+void regions_stop() {
+    if (pooled) {
+        pthread_mutex_lock(&missions.lock);
+        mission_notify = NULL;
+        pthread_mutex_unlock(&missions.lock);
+    } else {
+        mission_wake();
+    }
+    if (!pooled)
+        for (int r = 0; r < num_regions; r++)
+            pthread_join(regions[r].thread, NULL);
+    free_regions(num_regions);
+}
+
+/* missions assigned and stolen by each region's worker */
+void regions_report(FILE *out) {
+    for (int r = 0; r < num_regions; r++)
+        fprintf(out, "region %2d rows %3d-%-3d  drones %6d  assigned %8ld  "
+                "stolen %6ld\n", r, regions[r].first_row,
+                regions[r].first_row + regions[r].rows - 1,
+                regions[r].drones->number_of_elements, regions[r].assigned,
+                regions[r].stolen);
+}
@@ -0,0 +1,81 @@
+/**
+ * @file registry.c
+ * @brief drone pool and drone_id index of the server, see registry.h.
+ *
+ * Linear probing over a table kept at most half full; the full hash is
+ * stored next to each drone so a probe only compares names when the
+ * hashes match. Nothing is ever removed, so no tombstones are needed.
+ */
+#include "headers/registry.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* FNV-1a */
+static unsigned int hash_name(const char *name) {
+    unsigned int h = 2166136261u;
+    while (*name) {
+        h ^= (unsigned char)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief allocates the pool and the index
+ * @param capacity: most drones that can register
+ * @return int: 0, -1 if out of memory
+ */
+int registry_init(Registry *r, int capacity) {
+    unsigned int size = 16;
+    while (size < 2u * capacity) size <<= 1;
+    memset(r, 0, sizeof(Registry));
+    r->pool = calloc(capacity, sizeof(Drone));
+    r->slots = calloc(size, sizeof(RegistrySlot));
+    if (!r->pool || !r->slots) {
+        registry_free(r);
+        return -1;
+    }
+    r->capacity = capacity;
+    r->mask = size - 1;
+    return 0;
+}
+
+void registry_free(Registry *r) {
+    for (int i = 0; i < r->used; i++) pthread_mutex_destroy(&r->pool[i].lock);
+    free(r->pool);
+    free(r->slots);
+    memset(r, 0, sizeof(Registry));
+}
+
+/* the slot holding name, or the empty slot where it would go */
+static RegistrySlot *probe(Registry *r, const char *name, unsigned int h) {
+    for (unsigned int i = h & r->mask;; i = (i + 1) & r->mask) {
+        RegistrySlot *s = &r->slots[i];
+        if (!s->drone) return s;
+        if (s->hash == h && strcmp(s->drone->name, name) == 0) return s;
+    }
+}
+
+Drone *registry_find(Registry *r, const char *name) {
+    return probe(r, name, hash_name(name))->drone;
+}
+
+/**
+ * @brief takes the next pool record for a new drone_id and indexes it;
+ * the record is zeroed apart from id, name and its mutex
+ * @return Drone*: NULL if the pool is used up or name is already known
+ */
+Drone *registry_add(Registry *r, const char *name) {
+    unsigned int h = hash_name(name);
+    RegistrySlot *s = probe(r, name, h);
+    if (s->drone || r->used == r->capacity) return NULL;
+
+    Drone *d = &r->pool[r->used++];
+    d->id = r->used;
+    strncpy(d->name, name, sizeof(d->name) - 1);
+    pthread_mutex_init(&d->lock, NULL);
+    s->hash = h;
+    s->drone = d;
+    return d;
+}
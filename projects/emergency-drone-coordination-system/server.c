@@ -0,0 +1,618 @@
+// server.c: drone coordination server, see communication-protocol.md
+#include "headers/globals.h"
+#include "headers/map.h"
+#include "headers/drone.h"
+#include "headers/survivor.h"
+#include "headers/ai.h"
+#include "headers/journal.h"
+#include "headers/list.h"
+#include "headers/lockprof.h"
+#include "headers/metrics.h"
+#include "headers/mission.h"
+#include "headers/pool.h"
+#include "headers/protocol.h"
+#include "headers/reactor.h"
+#include "headers/region.h"
+#include "headers/registry.h"
+#include "headers/snapshot.h"
+#include "headers/stream.h"
+#include "headers/telemetry.h"
+#include "headers/trace.h"
+#include <getopt.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+List *helpedsurvivors, *drones;
+static Registry registry;  // drone records by drone_id, under drones->lock
+volatile sig_atomic_t running = 1;
+
+#define STATUS_UPDATE_INTERVAL 5  // seconds, idle drone with missions waiting
+#define MAX_STATUS_INTERVAL 30    // idle and overloaded
+#define HEARTBEAT_INTERVAL 10
+#define MAX_MISSED_HEARTBEATS 3   // then the drone is DISCONNECTED
+#define HANDSHAKE_TIMEOUT 10      // seconds to send HANDSHAKE after connect
+#define MISSION_TIMEOUT 600       // seconds until an assigned mission expires
+#define MAX_MISSIONS 1000         // mission table, also the helped list
+
+static int heartbeat_interval = HEARTBEAT_INTERVAL;
+static int mission_timeout = MISSION_TIMEOUT;
+// admission control: reactor loop lag above which STATUS_UPDATEs are
+// rate limited, and above which new drones get 503
+static int shed_lag_ms = 50;
+static int reject_lag_ms = 200;
+static int adaptive_interval = 1;  // 0: every drone keeps STATUS_UPDATE_INTERVAL
+static atomic_int next_session_id = 1;
+static int telemetry_port = 0;  // UDP STATUS_UPDATEs (telemetry.c), 0: off
+static const char *journal_dir;  // --journal (journal.c), NULL: off
+static int metrics_interval = 0;  // seconds between log_performance(), 0: off
+static volatile sig_atomic_t metrics_requested = 0;  // SIGUSR1
+static const char *trace_path;  // --trace (trace.c), NULL: off
+static int ai_regions = 0;  // --regions (region.c), 0: one ai_controller()
+static int pool_size = 0;  // --pool: generator and AI as pool tasks
+
+static const char *priority_names[] = {"low", "medium", "high"};
+
+static void stop(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+static void request_metrics(int sig) {
+    (void)sig;
+    metrics_requested = 1;
+}
+
+/* The STATUS_UPDATE interval d should use, caller holds d->lock.
+ * A drone on a mission reports about every third cell it flies, and
+ * every second close to the target; an idle drone does not move, so it
+ * only reports often enough for the AI to see it when missions wait.
+ * While the reactor lags every interval doubles. */
+static int status_interval(Conn *c, const Drone *d) {
+    if (!adaptive_interval) return STATUS_UPDATE_INTERVAL;
+    int interval;
+    if (d->status == ON_MISSION) {
+        int dist = abs(d->target.x - d->coord.x) +
+                   abs(d->target.y - d->coord.y);
+        interval = dist / 3;
+        if (interval < 1) interval = 1;
+        if (interval > STATUS_UPDATE_INTERVAL)
+            interval = STATUS_UPDATE_INTERVAL;
+    } else if (missions.waiting > 0) {  // a hint, read without the lock
+        interval = STATUS_UPDATE_INTERVAL;
+    } else {
+        interval = 3 * STATUS_UPDATE_INTERVAL;
+    }
+    if (reactor_lag_us(c->reactor) / 1000 >= shed_lag_ms) interval *= 2;
+    return interval < MAX_STATUS_INTERVAL ? interval : MAX_STATUS_INTERVAL;
+}
+
+/* sends CONFIG_UPDATE when d's interval changed, caller holds d->lock */
+static void update_interval(Conn *c, Drone *d) {
+    int interval = status_interval(c, d);
+    if (interval == d->status_interval) return;
+    d->status_interval = interval;
+    Message msg = {.type = MSG_CONFIG_UPDATE,
+                   .status_update_interval = interval};
+    conn_send_message(c, &msg);
+}
+
+/* sends ASSIGN_MISSION; runs inside assign_mission with drone->lock */
+static void send_mission(Drone *drone, const Mission *m) {
+    if (!drone->conn) return;  // disconnected since it was picked
+    Message msg = {.type = MSG_ASSIGN_MISSION,
+                   .target = m->survivor.coord,
+                   .expiry = (long)m->deadline};
+    snprintf(msg.mission_id, sizeof(msg.mission_id), "M%d", m->id);
+    strcpy(msg.priority, priority_names[m->survivor.priority]);
+    conn_send_message(drone->conn, &msg);
+    update_interval(drone->conn, drone);
+}
+
+/* "M123" -> 123, 0 if it is not one of ours */
+static int mission_number(const char *mission_id) {
+    if (mission_id[0] != 'M') return 0;
+    return atoi(mission_id + 1);
+}
+
+/* binds c to d, caller holds d->lock. The HANDSHAKE_ACK is queued
+ * before d->conn is set, so no mission can overtake it. A drone that
+ * asked for UDP telemetry gets a new key, so datagrams of its previous
+ * session no longer count. */
+static void attach(Conn *c, Drone *d, int binary, int udp) {
+    char buf[320], session_id[16];
+    snprintf(session_id, sizeof(session_id), "S%d",
+             atomic_fetch_add(&next_session_id, 1));
+    if (d->status == DISCONNECTED) d->status = IDLE;
+    d->status_interval = status_interval(c, d);
+    udp = udp && telemetry_port;
+    d->telemetry_seq = 0;
+    __atomic_store_n(&d->telemetry_key, udp ? telemetry_new_key() : 0,
+                     __ATOMIC_RELEASE);
+    int len = format_handshake_ack(buf, sizeof(buf), session_id,
+                                   d->status_interval, heartbeat_interval,
+                                   binary ? "binary" : "json",
+                                   udp ? telemetry_port : 0, d->id,
+                                   d->telemetry_key);
+    conn_send(c, buf, len);
+    c->binary = binary;  // the ACK is the last JSON message
+    c->data = d;
+    d->conn = c;
+    // first HEARTBEAT at a random point of the interval, so drones that
+    // connected together are not all checked in the same tick
+    conn_set_timer(c, 1000 + rand() % (heartbeat_interval * 1000));
+}
+
+static void handle_handshake(Conn *c, Message *msg) {
+    if (c->data) {
+        conn_send_error(c, 400, "Already registered.");
+        return;
+    }
+    if (msg->drone_id[0] == '\0') {
+        conn_send_error(c, 400, "Missing drone_id.");
+        return;
+    }
+    int binary = strcmp(msg->encoding, "binary") == 0;
+    int udp = strcmp(msg->telemetry, "udp") == 0;
+
+    prof_lock(&drones->lock);
+    Drone *d = registry_find(&registry, msg->drone_id);
+    if (d) {
+        // Reconnect of a known drone
+        prof_lock(&d->lock);
+        int in_use = d->conn != NULL;
+        if (!in_use) attach(c, d, binary, udp);
+        prof_unlock(&d->lock);
+        prof_unlock(&drones->lock);
+        if (in_use) conn_send_error(c, 400, "drone_id already connected.");
+        else mission_wake();  // an idle drone for the AI
+        return;
+    }
+
+    // room in the list first: a registry record is never given back
+    d = drones->number_of_elements < drones->capacity
+            ? registry_add(&registry, msg->drone_id)
+            : NULL;
+    if (!d || drones->add(drones, &d) == NULL) {
+        prof_unlock(&drones->lock);
+        conn_send_error(c, 503, "Server overloaded.");
+        conn_close(c);
+        return;
+    }
+    d->status = IDLE;
+    d->coord = d->target = (Coord){0, 0};
+    journal_drone(d);
+    prof_lock(&d->lock);
+    attach(c, d, binary, udp);
+    prof_unlock(&d->lock);
+    prof_unlock(&drones->lock);
+    region_track(d);
+    mission_wake();
+}
+
+/* takes a STATUS_UPDATE of d, caller holds d->lock */
+static void apply_status(Conn *c, Drone *d, Message *msg) {
+    time_t now = time(NULL);
+    if (msg->location.x >= 0 && msg->location.x < map.height &&
+        msg->location.y >= 0 && msg->location.y < map.width) {
+        d->coord = msg->location;
+    }
+    // Only MISSION_COMPLETE ends a mission; an "idle" report may have
+    // crossed the ASSIGN_MISSION on the wire
+    if (strcmp(msg->status, "idle") == 0 && d->status != ON_MISSION) {
+        d->status = IDLE;
+    }
+    localtime_r(&now, &d->last_update);
+    update_interval(c, d);
+    region_track(d);  // region locks come after drone locks
+}
+
+static void handle_status_update(Conn *c, Drone *d, Message *msg) {
+    prof_lock(&d->lock);
+    apply_status(c, d, msg);
+    prof_unlock(&d->lock);
+}
+
+/* a STATUS_UPDATE datagram; runs on the telemetry thread with d->lock */
+static void handle_telemetry(Drone *d, Message *msg) {
+    if (!d->conn) return;  // disconnected since the key was checked
+    apply_status(d->conn, d, msg);
+}
+
+static void handle_mission_complete(Conn *c, Drone *d, Message *msg) {
+    long t = trace_now();
+    time_t now = time(NULL);
+    int id = mission_number(msg->mission_id);
+    prof_lock(&d->lock);
+    int current = id != 0 && d->mission_id == id;
+    if (current) {
+        d->status = IDLE;
+        d->mission_id = 0;
+        update_interval(c, d);
+    }
+    localtime_r(&now, &d->last_update);
+    prof_unlock(&d->lock);
+    if (!current) {  // expired and taken back, or never ours
+        conn_send_error(c, 404, "Mission not found.");
+        return;
+    }
+
+    if (!msg->success) {  // someone else has to go
+        mission_lost(id);
+        return;
+    }
+    // the mission may have expired since d->lock was released
+    Survivor s;
+    if (mission_complete(id, d, &s) == 0) survivor_helped(&s);
+    trace_span("mission_complete", t, id);
+}
+
+/* a drone checking the link: HEARTBEAT answered like a ping */
+static void handle_heartbeat(Conn *c, Drone *d) {
+    Message reply = {.type = MSG_HEARTBEAT_RESPONSE, .timestamp = time(NULL)};
+    strcpy(reply.drone_id, d->name);
+    conn_send_message(c, &reply);
+}
+
+static void handle_heartbeat_response(Drone *d) {
+    time_t now = time(NULL);
+    prof_lock(&d->lock);
+    localtime_r(&now, &d->last_update);
+    prof_unlock(&d->lock);
+}
+
+/* under load a drone's STATUS_UPDATEs are taken at most once per
+ * interval; past the reject threshold none are taken */
+static int shed_status(Conn *c, Drone *d) {
+    long lag_ms = reactor_lag_us(c->reactor) / 1000;
+    time_t now = time(NULL);
+    if (lag_ms >= reject_lag_ms) return 1;
+    if (lag_ms >= shed_lag_ms && now - d->last_status < d->status_interval)
+        return 1;
+    d->last_status = now;  // only this reactor thread reads or writes it
+    return 0;
+}
+
+/* Reactor callbacks */
+static void on_open(Conn *c) {
+    conn_set_timer(c, HANDSHAKE_TIMEOUT * 1000);
+}
+
+static void on_message(Conn *c, Message *msg) {
+    c->missed_heartbeats = 0;  // any message shows the drone is alive
+    if (msg->type == MSG_HANDSHAKE) {
+        // new drones wait until the loop catches up
+        if (!c->data &&
+            reactor_lag_us(c->reactor) / 1000 >= reject_lag_ms) {
+            c->reactor->rejected++;
+            conn_send_error(c, 503, "Server overloaded.");
+            conn_close(c);
+            return;
+        }
+        handle_handshake(c, msg);
+        return;
+    }
+    Drone *d = c->data;
+    if (!d) {
+        conn_send_error(c, 400, "HANDSHAKE required.");
+        return;
+    }
+    switch (msg->type) {
+        case MSG_STATUS_UPDATE:
+            if (shed_status(c, d)) c->reactor->shed++;
+            else handle_status_update(c, d, msg);
+            break;
+        case MSG_MISSION_COMPLETE: handle_mission_complete(c, d, msg); break;
+        case MSG_HEARTBEAT_RESPONSE: handle_heartbeat_response(d); break;
+        case MSG_HEARTBEAT: handle_heartbeat(c, d); break;
+        default: conn_send_error(c, 400, "Unexpected message type.");
+    }
+}
+
+static void on_close(Conn *c) {
+    Drone *d = c->data;
+    if (!d) return;
+    // After this no other thread can reach c through the drone
+    prof_lock(&d->lock);
+    int lost_mission = d->status == ON_MISSION ? d->mission_id : 0;
+    d->conn = NULL;
+    d->telemetry_key = 0;
+    d->status = DISCONNECTED;
+    d->mission_id = 0;
+    journal_disconnect(d);
+    prof_unlock(&d->lock);
+    // back to the head of its priority queue; missions.lock comes first
+    if (lost_mission) mission_lost(lost_mission);
+}
+
+/* journal recovery, before any other thread runs: drones come back
+ * DISCONNECTED under their old ids, registered in the same order */
+static void restore_drone(const char *name, Coord coord) {
+    if (drones->number_of_elements >= drones->capacity) return;
+    Drone *d = registry_add(&registry, name);
+    if (!d || drones->add(drones, &d) == NULL) return;
+    d->status = DISCONNECTED;
+    d->coord = d->target = coord;
+    region_track(d);
+}
+
+static void restore_mission(int id, const Survivor *s) {
+    if (s->coord.x < 0 || s->coord.x >= map.height || s->coord.y < 0 ||
+        s->coord.y >= map.width || mission_restore(id, s) != 0) {
+        fprintf(stderr, "journal: mission M%d not restored\n", id);
+        return;
+    }
+    survivor_place(s);
+}
+
+static void restore_helped(const Survivor *s) {
+    survivor_remember(s);
+}
+
+/* heartbeat: 3 unanswered HEARTBEATs close the connection */
+static int on_timer(Conn *c) {
+    Drone *d = c->data;
+    if (!d) return -1;  // no HANDSHAKE in time
+    if (c->missed_heartbeats >= MAX_MISSED_HEARTBEATS) {
+        printf("Drone %s missed %d heartbeats, disconnected\n", d->name,
+               c->missed_heartbeats);
+        return -1;
+    }
+    Message msg = {.type = MSG_HEARTBEAT, .timestamp = time(NULL)};
+    conn_send_message(c, &msg);
+    c->missed_heartbeats++;
+    conn_set_timer(c, heartbeat_interval * 1000);
+    return 0;
+}
+
+static Handlers handlers = {.on_open = on_open,
+                            .on_message = on_message,
+                            .on_close = on_close,
+                            .on_timer = on_timer};
+
+static long connections() {
+    long conns = 0;
+    for (int i = 0; i < num_reactors; i++) conns += reactors[i].connections;
+    return conns;
+}
+
+/* prints connections, message rates, writes per reply and system calls
+ * per message */
+static void print_stats(long *last_messages, int seconds) {
+    static long last_syscalls;
+    long conns = 0, messages = 0, replies = 0, writes = 0, syscalls = 0;
+    long lag = 0, max_lag = 0, max_queued = 0, overflows = 0, shed = 0,
+         rejected = 0;
+    for (int i = 0; i < num_reactors; i++) {
+        Reactor *r = &reactors[i];
+        conns += r->connections;
+        messages += r->messages;
+        replies += r->replies;
+        writes += r->writes;
+        syscalls += r->syscalls;
+        long r_lag = reactor_lag_us(r);
+        if (r_lag > lag) lag = r_lag;
+        if (r->max_lag_us > max_lag) max_lag = r->max_lag_us;
+        if (r->max_queued > max_queued) max_queued = r->max_queued;
+        r->max_lag_us = r->max_queued = 0;  // per stats period
+        overflows += r->overflows;
+        shed += r->shed;
+        rejected += r->rejected;
+    }
+    long period = messages - *last_messages;
+    printf("connections: %ld  messages/s: %.1f  replies: %ld  "
+           "writes/reply: %.2f  syscalls/message: %.2f\n",
+           conns, (double)period / seconds, replies,
+           replies ? (double)writes / replies : 0.0,
+           period ? (double)(syscalls - last_syscalls) / period : 0.0);
+    *last_messages = messages;
+    last_syscalls = syscalls;
+    printf("load: lag %.1f ms (max %.1f, shed at %d, reject at %d)  "
+           "max queued: %ld KB (limit %zu)  shed: %ld  rejected: %ld  "
+           "overflows: %ld\n",
+           lag / 1000.0, max_lag / 1000.0, shed_lag_ms, reject_lag_ms,
+           max_queued / 1024, conn_queue_limit / 1024, shed, rejected,
+           overflows);
+    printf("missions waiting: %d  assigned: %d  requeued: %ld  "
+           "expired: %ld\n",
+           missions.waiting, missions.assigned, missions.requeued,
+           missions.expired);
+    if (telemetry_port) {
+        TelemetryStats *t = &telemetry_stats;
+        printf("telemetry: datagrams: %ld  per batch: %.1f  taken: %ld  "
+               "stale: %ld  invalid: %ld\n",
+               t->datagrams, t->batches ? (double)t->datagrams / t->batches : 0.0,
+               t->taken, t->stale, t->invalid);
+    }
+    if (journal_dir) {
+        JournalStats *j = &journal_stats;
+        printf("journal: records: %ld  per commit: %.1f  KB: %ld  "
+               "checkpoints: %ld  dropped: %ld\n",
+               j->records, j->commits ? (double)j->records / j->commits : 0.0,
+               j->bytes / 1024, j->checkpoints, j->dropped);
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [--port N] [--threads N] [--max-drones N]\n"
+            "          [--map HEIGHTxWIDTH] [--stream PORT] [--heartbeat SEC]\n"
+            "          [--mission-timeout SEC] [--shed-lag MS] [--reject-lag MS]\n"
+            "          [--max-queue KB] [--fixed-interval] [--io epoll|uring]\n"
+            "          [--telemetry PORT] [--shm PATH] [--journal DIR]\n"
+            "          [--metrics SEC] [--trace FILE] [--regions K]\n"
+            "          [--pool N]\n",
+            prog);
+}
+
+int main(int argc, char *argv[]) {
+    int port = SERVER_PORT, threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_drones = 20000, height = 40, width = 30, stream_port = 0;
+    static struct option longopts[] = {
+        {"port", required_argument, NULL, 'p'},
+        {"threads", required_argument, NULL, 't'},
+        {"max-drones", required_argument, NULL, 'n'},
+        {"map", required_argument, NULL, 'm'},
+        {"stream", required_argument, NULL, 's'},
+        {"heartbeat", required_argument, NULL, 'b'},
+        {"mission-timeout", required_argument, NULL, 'e'},
+        {"shed-lag", required_argument, NULL, 'l'},
+        {"reject-lag", required_argument, NULL, 'r'},
+        {"max-queue", required_argument, NULL, 'q'},
+        {"fixed-interval", no_argument, NULL, 'f'},
+        {"io", required_argument, NULL, 'i'},
+        {"telemetry", required_argument, NULL, 'u'},
+        {"shm", required_argument, NULL, 'S'},
+        {"journal", required_argument, NULL, 'j'},
+        {"metrics", required_argument, NULL, 'M'},
+        {"trace", required_argument, NULL, 'T'},
+        {"regions", required_argument, NULL, 'R'},
+        {"pool", required_argument, NULL, 'P'},
+        {NULL, 0, NULL, 0}};
+    int opt;
+    while ((opt = getopt_long(argc, argv, "p:t:n:m:s:b:e:l:r:q:fi:u:S:j:M:T:R:P:", longopts, NULL)) != -1) {
+        switch (opt) {
+            case 'p': port = atoi(optarg); break;
+            case 't': threads = atoi(optarg); break;
+            case 'n': max_drones = atoi(optarg); break;
+            case 'm':
+                if (sscanf(optarg, "%dx%d", &height, &width) != 2) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 's': stream_port = atoi(optarg); break;
+            case 'b': heartbeat_interval = atoi(optarg); break;
+            case 'e': mission_timeout = atoi(optarg); break;
+            case 'l': shed_lag_ms = atoi(optarg); break;
+            case 'r': reject_lag_ms = atoi(optarg); break;
+            case 'q': conn_queue_limit = atol(optarg) * 1024; break;
+            case 'f': adaptive_interval = 0; break;
+            case 'u': telemetry_port = atoi(optarg); break;
+            case 'S': shm_path = optarg; break;
+            case 'j': journal_dir = optarg; break;
+            case 'M': metrics_interval = atoi(optarg); break;
+            case 'T': trace_path = optarg; break;
+            case 'R': ai_regions = atoi(optarg); break;
+            case 'P': pool_size = atoi(optarg); break;
+            case 'i':
+                if (strcmp(optarg, "uring") == 0) reactor_io = IO_URING;
+                else if (strcmp(optarg, "epoll") == 0) reactor_io = IO_EPOLL;
+                else {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (threads < 1) threads = 1;
+    if (max_drones < 1) max_drones = 1;
+    if (heartbeat_interval < 1) heartbeat_interval = 1;
+    if (mission_timeout < 1) mission_timeout = 1;
+    if (conn_queue_limit < MAX_MESSAGE) conn_queue_limit = MAX_MESSAGE;
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    signal(SIGUSR1, request_metrics);  // log_performance() now
+    if (trace_path) trace_start();
+
+    // One fd per drone: lift the soft limit to the hard one
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    if (mission_init(MAX_MISSIONS, mission_timeout) != 0) {
+        fprintf(stderr, "no memory for %d missions\n", MAX_MISSIONS);
+        return 1;
+    }
+    helpedsurvivors = create_list(sizeof(Survivor), HELPED_HISTORY);
+    drones = create_list(sizeof(Drone *), max_drones);
+    if (registry_init(&registry, max_drones) != 0) {
+        fprintf(stderr, "no memory for %d drones\n", max_drones);
+        return 1;
+    }
+    init_map(height, width);
+    init_snapshots(map.height, map.width);
+    if (pool_size > 0 && ai_regions == 0) ai_regions = 1;  // AI as tasks
+    if (ai_regions > 0 && regions_init(ai_regions, max_drones) != 0) {
+        fprintf(stderr, "no memory for %d regions\n", ai_regions);
+        return 1;
+    }
+    if (stream_port && start_stream_server(stream_port) != 0) return 1;
+    if (journal_dir) {
+        JournalRestore restore = {restore_drone, restore_mission,
+                                  restore_helped};
+        if (journal_open(journal_dir, MAX_MISSIONS, max_drones, &restore) != 0)
+            return 1;
+        mission_observer = journal_mission;
+    }
+
+    mission_hook = send_mission;
+    if (telemetry_port &&
+        start_telemetry(telemetry_port, &registry, handle_telemetry) != 0)
+        return 1;
+    if (start_reactors(threads, port, &handlers) != 0) return 1;
+    printf("Listening on port %d with %d reactor threads (%s)\n", port,
+           threads, reactor_io == IO_URING ? "io_uring" : "epoll");
+    if (telemetry_port)
+        printf("UDP telemetry on port %d\n", telemetry_port);
+    if (shm_path) printf("Local drones over shared memory at %s\n", shm_path);
+
+    if (pool_size > 0 && start_pool(pool_size) != 0) {
+        fprintf(stderr, "no memory for %d pool workers\n", pool_size);
+        return 1;
+    }
+    pthread_t survivor_thread, ai_thread, snapshot_thread;
+    if (pool_workers()) pool_submit(survivor_task, NULL, POOL_ANY);
+    else pthread_create(&survivor_thread, NULL, survivor_generator, NULL);
+    if (num_regions) regions_start();
+    else pthread_create(&ai_thread, NULL, ai_controller, NULL);
+    pthread_create(&snapshot_thread, NULL, snapshot_publisher, NULL);
+
+    long last_messages = 0;
+    for (long tick = 1; running; tick++) {
+        sleep(1);  // cut short by a signal
+        if (tick % 5 == 0) print_stats(&last_messages, 5);
+        if (metrics_requested ||
+            (metrics_interval > 0 && tick % metrics_interval == 0)) {
+            metrics_requested = 0;
+            log_performance(stdout, connections());
+        }
+    }
+
+    printf("Exiting...\n");
+    log_performance(stdout, connections());
+    stop_telemetry();  // it sends on connections
+    if (pool_workers()) {  // generator and AI
+        pool_report(stdout);
+        stop_pool();
+    } else {
+        pthread_join(survivor_thread, NULL);
+    }
+    if (num_regions) {
+        regions_report(stdout);
+        regions_stop();
+    } else {
+        pthread_join(ai_thread, NULL);
+    }
+    mission_hook = NULL;  // nothing may reach conn_send past here
+    stop_reactors();
+    pthread_join(snapshot_thread, NULL);
+    stop_stream_server();
+    mission_observer = NULL;
+    journal_close();  // after the last mission change
+    freemap();
+    mission_destroy();
+    helpedsurvivors->destroy(helpedsurvivors);
+    drones->destroy(drones);
+    registry_free(&registry);
+    free_snapshots();
+    lockprof_report(stdout, 10);
+    if (trace_path) trace_write(trace_path);
+    return 0;
+}
@@ -0,0 +1,245 @@
+/**
+ * @file shm.c
+ * @brief shared-memory transport between the server and drones on the
+ * same host (server --shm PATH).
+ *
+ * A drone connects to the server's unix socket at PATH. The server
+ * answers with three file descriptors (SCM_RIGHTS): a memfd holding a
+ * ShmChannel and two eventfds, one per direction. Messages then travel
+ * through the channel's two SPSC rings as the same byte stream a TCP
+ * connection would carry, so framing.c and the protocol stay as they
+ * are. The socket only carries the setup; its hangup tells the server
+ * that the drone is gone.
+ *
+ * The eventfds are doorbells and are only written when the peer is
+ * about to sleep: a consumer that finds its ring empty sets `waiting`
+ * and checks once more, a producer that finds the ring full sets
+ * `full`. The side that changes the ring next clears the flag and
+ * writes the bell. A busy drone therefore moves its messages with no
+ * system call at all.
+ */
+#define _GNU_SOURCE  // memfd_create
+#include "headers/shm.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define RING_MASK (SHM_RING_SIZE - 1)
+
+static void ring_bell(int fd) {
+    uint64_t one = 1;
+    write(fd, &one, sizeof(one));
+}
+
+/* reads the bell so it can signal again; call when it woke this side */
+void shm_ack_bell(ShmLink *l) {
+    uint64_t count;
+    read(l->bell, &count, sizeof(count));
+}
+
+/* bytes in `in`, -1 if the peer's tail makes no sense */
+static long in_available(ShmLink *l) {
+    unsigned int tail = __atomic_load_n(&l->in->tail, __ATOMIC_ACQUIRE);
+    unsigned int n = tail - l->in_head;
+    return n > SHM_RING_SIZE ? -1 : (long)n;
+}
+
+/* room in `out`, -1 if the peer's head makes no sense */
+static long out_room(ShmLink *l) {
+    unsigned int head = __atomic_load_n(&l->out->head, __ATOMIC_ACQUIRE);
+    unsigned int used = l->out_tail - head;
+    return used > SHM_RING_SIZE ? -1 : (long)(SHM_RING_SIZE - used);
+}
+
+/**
+ * @brief copies up to room bytes out of the inbound ring, like a
+ * non-blocking recv(). An empty ring arms the peer's doorbell.
+ * @return ssize_t: bytes read, 0 if the ring is empty (wait for the
+ * bell), -1 if the peer corrupted the ring
+ */
+ssize_t shm_recv(ShmLink *l, char *buf, size_t room) {
+    long avail = in_available(l);
+    if (avail == 0) {
+        __atomic_store_n(&l->in->waiting, 1, __ATOMIC_SEQ_CST);
+        avail = in_available(l);  // the producer may have missed the flag
+    }
+    if (avail <= 0) return avail;
+
+    size_t n = (size_t)avail < room ? (size_t)avail : room;
+    size_t at = l->in_head & RING_MASK;
+    size_t first = n < SHM_RING_SIZE - at ? n : SHM_RING_SIZE - at;
+    memcpy(buf, l->in->data + at, first);
+    memcpy(buf + first, l->in->data, n - first);
+    l->in_head += n;
+    __atomic_store_n(&l->in->head, l->in_head, __ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&l->in->full, 0, __ATOMIC_SEQ_CST))
+        ring_bell(l->peer_bell);
+    return n;
+}
+
+/* copies len bytes into the outbound ring, as many as fit */
+static size_t ring_put(ShmLink *l, const char *data, size_t len, size_t room) {
+    size_t n = len < room ? len : room;
+    size_t at = l->out_tail & RING_MASK;
+    size_t first = n < SHM_RING_SIZE - at ? n : SHM_RING_SIZE - at;
+    memcpy(l->out->data + at, data, first);
+    memcpy(l->out->data, data + first, n - first);
+    l->out_tail += n;
+    return n;
+}
+
+/**
+ * @brief moves as much of q as fits into the outbound ring, then rings
+ * the peer if it waits. What does not fit stays queued; the peer rings
+ * back once it made room. q->writes counts the doorbells.
+ * @return int: 0, -1 if the peer corrupted the ring
+ */
+int shm_flush(OutQueue *q, ShmLink *l) {
+    size_t moved = 0;
+    while (q->head) {
+        long room = out_room(l);
+        if (room < 0) return -1;
+        if (room == 0) {
+            __atomic_store_n(&l->out->full, 1, __ATOMIC_SEQ_CST);
+            room = out_room(l);  // the consumer may have missed the flag
+            if (room <= 0) break;
+        }
+        OutBlock *b = q->head;
+        size_t n = ring_put(l, b->data + b->start, b->end - b->start, room);
+        // published before `full` can be set, so the consumer sees it
+        __atomic_store_n(&l->out->tail, l->out_tail, __ATOMIC_SEQ_CST);
+        outq_consume(q, n);
+        moved += n;
+    }
+    if (moved == 0) return 0;
+    if (__atomic_exchange_n(&l->out->waiting, 0, __ATOMIC_SEQ_CST)) {
+        ring_bell(l->peer_bell);
+        q->writes++;
+    }
+    return 0;
+}
+
+static ShmLink *link_new(ShmChannel *ch, int server) {
+    ShmLink *l = calloc(1, sizeof(ShmLink));
+    if (!l) return NULL;
+    l->ch = ch;
+    l->in = server ? &ch->up : &ch->down;
+    l->out = server ? &ch->down : &ch->up;
+    l->in_head = __atomic_load_n(&l->in->head, __ATOMIC_ACQUIRE);
+    l->out_tail = __atomic_load_n(&l->out->tail, __ATOMIC_ACQUIRE);
+    return l;
+}
+
+void shm_close(ShmLink *l) {
+    if (!l) return;
+    munmap(l->ch, sizeof(ShmChannel));
+    close(l->bell);
+    close(l->peer_bell);
+    free(l);
+}
+
+/**
+ * @brief creates the channel for a drone that connected to the unix
+ * socket and sends it the memfd and both eventfds
+ * @return ShmLink*: the server's side, NULL on failure (close sock)
+ */
+ShmLink *shm_accept(int sock) {
+    int mem = memfd_create("drone-channel", MFD_CLOEXEC);
+    int up_bell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);    // the server's
+    int down_bell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);  // the drone's
+    ShmChannel *ch = MAP_FAILED;
+    if (mem >= 0 && up_bell >= 0 && down_bell >= 0 &&
+        ftruncate(mem, sizeof(ShmChannel)) == 0)
+        ch = mmap(NULL, sizeof(ShmChannel), PROT_READ | PROT_WRITE,
+                  MAP_SHARED, mem, 0);
+    ShmLink *l = ch != MAP_FAILED ? link_new(ch, 1) : NULL;
+    if (l) {
+        ch->magic = SHM_MAGIC;  // the memfd starts zeroed
+        l->bell = up_bell;
+        l->peer_bell = down_bell;
+
+        int fds[3] = {mem, up_bell, down_bell};
+        char control[CMSG_SPACE(sizeof(fds))];
+        char byte = 0;
+        struct iovec iov = {&byte, 1};
+        struct msghdr mh = {.msg_iov = &iov,
+                            .msg_iovlen = 1,
+                            .msg_control = control,
+                            .msg_controllen = sizeof(control)};
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(fds));
+        memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+        if (sendmsg(sock, &mh, MSG_NOSIGNAL) != 1) {
+            shm_close(l);  // closes both bells
+            close(mem);
+            return NULL;
+        }
+        close(mem);  // the mapping stays
+        return l;
+    }
+    if (ch != MAP_FAILED) munmap(ch, sizeof(ShmChannel));
+    if (mem >= 0) close(mem);
+    if (up_bell >= 0) close(up_bell);
+    if (down_bell >= 0) close(down_bell);
+    return NULL;
+}
+
+/**
+ * @brief connects to the server's unix socket and maps the channel it
+ * sends back
+ * @return ShmLink*: the drone's side, NULL on failure
+ */
+ShmLink *shm_connect(const char *path, int *sock) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return NULL;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    int fds[3];
+    char control[CMSG_SPACE(sizeof(fds))];
+    char byte;
+    struct iovec iov = {&byte, 1};
+    struct msghdr mh = {.msg_iov = &iov,
+                        .msg_iovlen = 1,
+                        .msg_control = control,
+                        .msg_controllen = sizeof(control)};
+    ssize_t n;
+    while ((n = recvmsg(fd, &mh, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR)
+        ;
+    struct cmsghdr *cm = n == 1 ? CMSG_FIRSTHDR(&mh) : NULL;
+    if (!cm || cm->cmsg_type != SCM_RIGHTS ||
+        cm->cmsg_len != CMSG_LEN(sizeof(fds))) {
+        close(fd);  // e.g. 503: the server closed instead
+        return NULL;
+    }
+    memcpy(fds, CMSG_DATA(cm), sizeof(fds));
+    ShmChannel *ch = mmap(NULL, sizeof(ShmChannel), PROT_READ | PROT_WRITE,
+                          MAP_SHARED, fds[0], 0);
+    close(fds[0]);
+    ShmLink *l = NULL;
+    if (ch != MAP_FAILED && ch->magic == SHM_MAGIC) l = link_new(ch, 0);
+    if (!l) {
+        if (ch != MAP_FAILED) munmap(ch, sizeof(ShmChannel));
+        close(fds[1]);
+        close(fds[2]);
+        close(fd);
+        return NULL;
+    }
+    l->bell = fds[2];
+    l->peer_bell = fds[1];
+    *sock = fd;
+    return l;
+}
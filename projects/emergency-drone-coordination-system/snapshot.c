@@ -0,0 +1,75 @@
+/**
+ * @file snapshot.c
+ * @brief lock-free triple buffer of world snapshots between the
+ * simulation (single writer) and the view (single reader).
+ *
+ * The writer fills slots[back], then atomically exchanges it with the
+ * shared middle slot and keeps the old middle as its next back. The
+ * reader exchanges its front slot with the middle only when the middle
+ * is marked fresh. Each side owns its slot exclusively between swaps.
+ */
+#include "headers/snapshot.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRESH 4       // set in middle when the writer published
+#define SLOT_MASK 3
+
+static WorldSnapshot slots[3];
+static atomic_int middle = 1;
+static int back = 0;   // writer's slot
+static int front = 2;  // reader's slot
+
+void init_snapshots(int height, int width) {
+    int cells = height * width;
+    for (int i = 0; i < 3; i++) {
+        memset(&slots[i], 0, sizeof(WorldSnapshot));
+        slots[i].height = height;
+        slots[i].width = width;
+        slots[i].occupied = calloc(cells, sizeof(unsigned char));
+        slots[i].dirty = malloc(sizeof(int) * cells);
+        if (!slots[i].occupied || !slots[i].dirty) {
+            perror("Failed to allocate snapshot");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/**
+ * @brief returns the writer's private slot. Fill it, then call
+ * commit_snapshot(). Only one thread may act as the writer.
+ */
+WorldSnapshot *begin_snapshot() {
+    return &slots[back];
+}
+
+/**
+ * @brief makes the slot returned by begin_snapshot() the latest one,
+ * without waiting for the reader
+ */
+void commit_snapshot() {
+    back = atomic_exchange(&middle, back | FRESH) & SLOT_MASK;
+}
+
+/**
+ * @brief returns the most recently published snapshot, without
+ * waiting. The snapshot stays valid until the next call.
+ * @return const WorldSnapshot*: NULL before the first publish
+ */
+const WorldSnapshot *latest_snapshot() {
+    if (atomic_load(&middle) & FRESH) {
+        front = atomic_exchange(&middle, front) & SLOT_MASK;
+    }
+    return slots[front].seq ? &slots[front] : NULL;
+}
+
+void free_snapshots() {
+    for (int i = 0; i < 3; i++) {
+        free(slots[i].drones);
+        free(slots[i].occupied);
+        free(slots[i].dirty);
+    }
+}
@@ -0,0 +1,493 @@
+/**
+ * @file stream.c
+ * @brief binary world stream from the simulation to remote viewers.
+ *
+ * Every message is a varint payload length followed by the payload.
+ * A viewer first gets a keyframe (encode_frame), then one delta per
+ * published snapshot:
+ *   'D' seq num_drones changed_drones
+ *       changed_drones * (index_gap mask [id] [status]
+ *                         [zz(dx) zz(dy)] [zz(dtx) zz(dty)])
+ *       added_runs * (gap length) removed_runs * (gap length)
+ * where mask tells which fields follow, coordinates are zigzag deltas
+ * against the previous message, and survivor cells are sorted runs of
+ * consecutive cell indices. A quiet tick costs a handful of bytes.
+ */
+#include "headers/stream.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "headers/codec.h"
+#include "headers/globals.h"
+
+typedef struct viewer {
+    int fd;
+    int needs_keyframe;
+    unsigned char *pending;  // bytes not yet accepted by the socket
+    size_t pending_len;
+    size_t pending_cap;
+} Viewer;
+
+static Viewer viewers[STREAM_MAX_VIEWERS];
+static int num_viewers = 0;
+static pthread_mutex_t viewers_lock = PTHREAD_MUTEX_INITIALIZER;
+static int listen_fd = -1;
+static pthread_t accept_thread;
+
+/* state of the previous message, deltas are taken against it */
+static DroneView *prev_drones = NULL;
+static int prev_num_drones = 0, prev_capacity = 0;
+
+static unsigned char *msg = NULL;  // encode buffer
+static size_t msg_cap = 0;
+
+static void reserve(unsigned char **buf, size_t *cap, size_t need) {
+    if (need <= *cap) return;
+    size_t newcap = *cap ? *cap : 4096;
+    while (newcap < need) newcap *= 2;
+    unsigned char *tmp = realloc(*buf, newcap);
+    if (!tmp) {
+        perror("Failed to grow stream buffer");
+        exit(EXIT_FAILURE);
+    }
+    *buf = tmp;
+    *cap = newcap;
+}
+
+static void *accept_viewers(void *args) {
+    (void)args;  // Unused parameter
+    struct pollfd pfd = {.fd = listen_fd, .events = POLLIN};
+    while (running) {
+        if (poll(&pfd, 1, 200) <= 0) continue;
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        pthread_mutex_lock(&viewers_lock);
+        if (num_viewers == STREAM_MAX_VIEWERS) {
+            close(fd);
+        } else {
+            viewers[num_viewers++] = (Viewer){.fd = fd, .needs_keyframe = 1};
+            printf("Viewer connected (fd %d)\n", fd);
+        }
+        pthread_mutex_unlock(&viewers_lock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief listens for viewers on the given port. From then on every
+ * stream_snapshot() call is sent to them.
+ * @return int: 0 on success, -1 if the port cannot be bound
+ */
+int start_stream_server(int port) {
+    struct sockaddr_in addr = {.sin_family = AF_INET,
+                               .sin_port = htons(port),
+                               .sin_addr.s_addr = htonl(INADDR_ANY)};
+    int one = 1;
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("stream socket");
+        return -1;
+    }
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(listen_fd, 8) < 0) {
+        perror("stream bind/listen");
+        close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+    pthread_create(&accept_thread, NULL, accept_viewers, NULL);
+    printf("Streaming world to viewers on port %d\n", port);
+    return 0;
+}
+
+/* runs of consecutive cell indices with the given occupancy */
+static size_t put_cell_runs(const WorldSnapshot *snap, unsigned char value,
+                            unsigned char *buf) {
+    size_t len = 0;
+    int runs = 0, last = 0;
+    unsigned char counter[VARINT_MAX];
+    unsigned char *body = buf + VARINT_MAX;  // count is patched in front
+
+    for (int k = 0; k < snap->num_dirty; k++) {
+        int idx = snap->dirty[k];
+        if (snap->occupied[idx] != value) continue;
+        int end = idx + 1;
+        // extend the run while the next dirty index is adjacent
+        while (k + 1 < snap->num_dirty && snap->dirty[k + 1] == end &&
+               snap->occupied[end] == value) {
+            end++;
+            k++;
+        }
+        len += put_varint(body + len, idx - last);
+        len += put_varint(body + len, end - idx);
+        last = end;
+        runs++;
+    }
+    int n = put_varint(counter, runs);
+    memmove(buf + n, body, len);
+    memcpy(buf, counter, n);
+    return n + len;
+}
+
+static int cmp_int(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+/* which fields of d differ from old, see DELTA_* */
+static int drone_mask(const DroneView *d, const DroneView *old) {
+    int mask = 0;
+    if (d->id != old->id) mask |= DELTA_ID;
+    if (d->status != old->status) mask |= DELTA_STATUS;
+    if (d->coord.x != old->coord.x || d->coord.y != old->coord.y)
+        mask |= DELTA_COORD;
+    if (d->target.x != old->target.x || d->target.y != old->target.y)
+        mask |= DELTA_TARGET;
+    return mask;
+}
+
+/* encodes a delta message payload against prev_drones into msg */
+static size_t encode_delta(const WorldSnapshot *snap) {
+    reserve(&msg, &msg_cap,
+            1 + 3 * VARINT_MAX + (size_t)snap->num_drones * 7 * VARINT_MAX +
+                (size_t)snap->num_dirty * 2 * VARINT_MAX + 4 * VARINT_MAX);
+    const DroneView zero = {0};
+    int changed = 0;
+    for (int i = 0; i < snap->num_drones; i++) {
+        const DroneView *old = i < prev_num_drones ? &prev_drones[i] : &zero;
+        if (drone_mask(&snap->drones[i], old)) changed++;
+    }
+
+    size_t len = 0;
+    msg[len++] = STREAM_DELTA;
+    len += put_varint(msg + len, (unsigned int)snap->seq);
+    len += put_varint(msg + len, snap->num_drones);
+    len += put_varint(msg + len, changed);
+    int last = 0;
+    for (int i = 0; i < snap->num_drones; i++) {
+        const DroneView *d = &snap->drones[i];
+        const DroneView *old = i < prev_num_drones ? &prev_drones[i] : &zero;
+        int mask = drone_mask(d, old);
+        if (!mask) continue;
+
+        len += put_varint(msg + len, i - last);
+        msg[len++] = (unsigned char)mask;
+        if (mask & DELTA_ID) len += put_varint(msg + len, d->id);
+        if (mask & DELTA_STATUS) len += put_varint(msg + len, d->status);
+        if (mask & DELTA_COORD) {
+            len += put_varint(msg + len, zigzag(d->coord.x - old->coord.x));
+            len += put_varint(msg + len, zigzag(d->coord.y - old->coord.y));
+        }
+        if (mask & DELTA_TARGET) {
+            len += put_varint(msg + len, zigzag(d->target.x - old->target.x));
+            len += put_varint(msg + len, zigzag(d->target.y - old->target.y));
+        }
+        last = i;
+    }
+
+    len += put_cell_runs(snap, 1, msg + len);
+    len += put_cell_runs(snap, 0, msg + len);
+    return len;
+}
+
+/* queues a length-prefixed message and sends what the socket takes */
+static int viewer_send(Viewer *v, const unsigned char *payload,
+                       size_t len) {
+    unsigned char prefix[VARINT_MAX];
+    int n = put_varint(prefix, len);
+    if (len > STREAM_MAX_MESSAGE ||
+        v->pending_len + n + len > STREAM_MAX_PENDING)
+        return -1;
+    reserve(&v->pending, &v->pending_cap, v->pending_len + n + len);
+    memcpy(v->pending + v->pending_len, prefix, n);
+    memcpy(v->pending + v->pending_len + n, payload, len);
+    v->pending_len += n + len;
+
+    while (v->pending_len > 0) {
+        ssize_t sent = send(v->fd, v->pending, v->pending_len, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return -1;
+        }
+        memmove(v->pending, v->pending + sent, v->pending_len - sent);
+        v->pending_len -= sent;
+    }
+    return 0;
+}
+
+/**
+ * @brief sends the snapshot to all viewers: a keyframe to new ones, a
+ * delta to the rest. Called by the publisher before the snapshot is
+ * committed. Never blocks; a viewer that cannot keep up is dropped.
+ */
+void stream_snapshot(const WorldSnapshot *snap) {
+    if (listen_fd < 0) return;
+
+    pthread_mutex_lock(&viewers_lock);
+    size_t delta_len = 0;
+    if (num_viewers > 0) {
+        // dirty indices arrive in change order, runs need them sorted
+        qsort(snap->dirty, snap->num_dirty, sizeof(int), cmp_int);
+        delta_len = encode_delta(snap);
+    }
+    for (int i = 0; i < num_viewers; i++) {
+        Viewer *v = &viewers[i];
+        int rc;
+        if (v->needs_keyframe) {
+            unsigned char *frame = malloc(
+                1 + frame_max_size(snap->height, snap->width,
+                                   snap->num_drones));
+            if (!frame) continue;
+            frame[0] = STREAM_KEYFRAME;
+            size_t frame_len = 1 + encode_frame(snap, frame + 1);
+            rc = viewer_send(v, frame, frame_len);
+            free(frame);
+            v->needs_keyframe = 0;
+        } else {
+            rc = viewer_send(v, msg, delta_len);
+        }
+        if (rc != 0) {
+            printf("Viewer dropped (fd %d)\n", v->fd);
+            close(v->fd);
+            free(v->pending);
+            viewers[i--] = viewers[--num_viewers];
+        }
+    }
+    pthread_mutex_unlock(&viewers_lock);
+
+    // remember this snapshot's drones for the next delta
+    if (snap->num_drones > prev_capacity) {
+        prev_capacity = snap->num_drones * 2;
+        prev_drones = realloc(prev_drones, sizeof(DroneView) * prev_capacity);
+        if (!prev_drones) {
+            perror("Failed to allocate stream state");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memcpy(prev_drones, snap->drones, sizeof(DroneView) * snap->num_drones);
+    prev_num_drones = snap->num_drones;
+}
+
+void stop_stream_server() {
+    if (listen_fd < 0) return;
+    pthread_join(accept_thread, NULL);  // exits once running is cleared
+    close(listen_fd);
+    listen_fd = -1;
+    for (int i = 0; i < num_viewers; i++) {
+        close(viewers[i].fd);
+        free(viewers[i].pending);
+    }
+    num_viewers = 0;
+    free(prev_drones);
+    free(msg);
+}
+
+/* ---------------------------------------------------------------- */
+/* viewer side                                                      */
+/* ---------------------------------------------------------------- */
+
+int stream_connect(const char *host, int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET,
+                               .sin_port = htons(port),
+                               .sin_addr.s_addr = inet_addr(host)};
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("stream connect");
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static unsigned char *in = NULL;  // receive buffer
+static size_t in_len = 0, in_cap = 0;
+
+/* applies added (value 1) or removed (value 0) cell runs to mirror */
+static int apply_cell_runs(const unsigned char *buf, size_t len,
+                           WorldSnapshot *m, unsigned char value) {
+    size_t pos = 0;
+    unsigned int runs, gap, run;
+    int k, cells = m->height * m->width, idx = 0;
+    if ((k = get_varint(buf, len, &runs)) <= 0) return -1;
+    pos += k;
+    for (unsigned int r = 0; r < runs; r++) {
+        if ((k = get_varint(buf + pos, len - pos, &gap)) <= 0) return -1;
+        pos += k;
+        if ((k = get_varint(buf + pos, len - pos, &run)) <= 0) return -1;
+        pos += k;
+        // compared before adding, so a huge varint cannot wrap idx
+        if (gap > (unsigned int)(cells - idx)) return -1;
+        idx += gap;
+        if (run > (unsigned int)(cells - idx)) return -1;
+        // dirty holds each cell once: added and removed runs of a
+        // well-formed delta never name more cells than that together
+        if (run > (unsigned int)(cells - m->num_dirty)) return -1;
+        for (int c = idx; c < idx + (int)run; c++) {
+            m->occupied[c] = value;
+            m->dirty[m->num_dirty++] = c;
+        }
+        idx += run;
+    }
+    return (int)pos;
+}
+
+static int apply_delta(const unsigned char *buf, size_t len,
+                       WorldSnapshot *m) {
+    size_t pos = 0;
+    unsigned int seq, num_drones, changed, gap, v;
+    int k, index = 0;
+
+#define NEXT(var)                                                  \
+    do {                                                           \
+        if ((k = get_varint(buf + pos, len - pos, &(var))) <= 0)   \
+            return -1;                                             \
+        pos += k;                                                  \
+    } while (0)
+
+    NEXT(seq);
+    NEXT(num_drones);
+    if (num_drones > INT_MAX / sizeof(DroneView)) return -1;
+    if ((int)num_drones > m->drone_capacity) {
+        DroneView *grown = realloc(m->drones, sizeof(DroneView) * num_drones);
+        if (!grown) return -1;  // m->drones and its capacity still hold
+        m->drones = grown;
+        memset(m->drones + m->drone_capacity, 0,
+               sizeof(DroneView) * (num_drones - m->drone_capacity));
+        m->drone_capacity = num_drones;
+    }
+    for (int i = num_drones; i < m->num_drones; i++) {
+        m->drones[i] = (DroneView){0};  // deltas of regrown slots start at 0
+    }
+    m->num_drones = num_drones;
+
+    NEXT(changed);
+    for (unsigned int c = 0; c < changed; c++) {
+        NEXT(gap);
+        if (gap >= (unsigned int)(m->num_drones - index)) return -1;
+        index += gap;
+        if (pos >= len) return -1;
+        DroneView *d = &m->drones[index];
+        int mask = buf[pos++];
+        if (mask & DELTA_ID) {
+            NEXT(v);
+            d->id = v;
+        }
+        if (mask & DELTA_STATUS) {
+            NEXT(v);
+            d->status = v;
+        }
+        if (mask & DELTA_COORD) {
+            NEXT(v);
+            d->coord.x += unzigzag(v);
+            NEXT(v);
+            d->coord.y += unzigzag(v);
+        }
+        if (mask & DELTA_TARGET) {
+            NEXT(v);
+            d->target.x += unzigzag(v);
+            NEXT(v);
+            d->target.y += unzigzag(v);
+        }
+    }
+#undef NEXT
+
+    m->num_dirty = 0;
+    if ((k = apply_cell_runs(buf + pos, len - pos, m, 1)) < 0) return -1;
+    pos += k;
+    if ((k = apply_cell_runs(buf + pos, len - pos, m, 0)) < 0) return -1;
+    m->seq = seq;
+    return 0;
+}
+
+/**
+ * @brief blocks until one whole message arrived and applies it to the
+ * mirror. The first message must be a keyframe, it sizes the mirror.
+ * @return int: 0 on success, -1 on a closed connection or bad message
+ */
+int stream_apply_next(int fd, WorldSnapshot *mirror) {
+    while (1) {
+        unsigned int msg_len;
+        int k = get_varint(in, in_len, &msg_len);
+        if (k < 0 || (k > 0 && msg_len > STREAM_MAX_MESSAGE)) return -1;
+        size_t total = (size_t)k + msg_len;  // in size_t: no wrap
+        if (k > 0 && in_len >= total) {
+            const unsigned char *payload = in + k;
+            int rc = -1;
+            if (msg_len > 0 && payload[0] == STREAM_KEYFRAME) {
+                int cells = mirror->height * mirror->width;
+                rc = decode_frame(payload + 1, msg_len - 1, mirror);
+                if (rc == 0 && mirror->height * mirror->width != cells) {
+                    free(mirror->dirty);
+                    mirror->dirty =
+                        malloc(sizeof(int) * mirror->height * mirror->width);
+                    if (!mirror->dirty) rc = -1;
+                }
+            } else if (msg_len > 0 && payload[0] == STREAM_DELTA &&
+                       mirror->occupied) {
+                rc = apply_delta(payload + 1, msg_len - 1, mirror);
+            }
+            in_len -= total;
+            memmove(in, in + total, in_len);
+            return rc;
+        }
+
+        reserve(&in, &in_cap, in_len + 65536);
+        ssize_t n = recv(fd, in + in_len, in_cap - in_len, 0);
+        if (n <= 0) return -1;
+        in_len += n;
+    }
+}
+
+/**
+ * @brief copies the mirror into the local snapshots for the view
+ */
+void publish_mirror(const WorldSnapshot *mirror) {
+    WorldSnapshot *s = begin_snapshot();
+    int cells = s->height * s->width;
+    if (mirror->height * mirror->width != cells) return;
+
+    if (mirror->num_drones > s->drone_capacity) {
+        s->drone_capacity = mirror->num_drones * 2;
+        free(s->drones);
+        s->drones = malloc(sizeof(DroneView) * s->drone_capacity);
+        if (!s->drones) {
+            perror("Failed to allocate snapshot drones");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memcpy(s->drones, mirror->drones,
+           sizeof(DroneView) * mirror->num_drones);
+    s->num_drones = mirror->num_drones;
+    memcpy(s->occupied, mirror->occupied, cells);
+    memcpy(s->dirty, mirror->dirty, sizeof(int) * mirror->num_dirty);
+    s->num_dirty = mirror->num_dirty;
+    s->seq = mirror->seq;
+    commit_snapshot();
+}
+
+/**
+ * @brief viewer thread: applies messages from the server to the mirror
+ * and publishes each result until the connection ends.
+ * @param args: StreamConn*
+ */
+void *stream_receiver(void *args) {
+    StreamConn *conn = args;
+    while (running && stream_apply_next(conn->fd, conn->mirror) == 0) {
+        publish_mirror(conn->mirror);
+    }
+    running = 0;
+    return NULL;
+}
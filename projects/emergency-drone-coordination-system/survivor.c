@@ -8,7 +8,12 @@
 #include <unistd.h>
 
 #include "headers/globals.h"
+#include "headers/lockprof.h"
 #include "headers/map.h"
+#include "headers/metrics.h"
+#include "headers/mission.h"
+#include "headers/pool.h"
+#include "headers/trace.h"
 
 Survivor *create_survivor(Coord *coord, char *info,
                           struct tm *discovery_time) {
@@ -24,54 +29,115 @@ Survivor *create_survivor(Coord *coord, char *info,
     return s;
 }
 
-void *survivor_generator(void *args) {
-    (void)args;  // Unused parameter
+/* adds a survivor awaiting help to its map cell's list (a copy) */
+void survivor_place(const Survivor *s) {
+    List *cell = map.cells[s->coord.x][s->coord.y].survivors;
+    prof_lock(&cell->lock);
+    long locked = metrics_now_ns();
+    cell->add(cell, (void *)s);
+    metrics_record(METRIC_LIST_LOCK_HOLD, metrics_now_ns() - locked);
+    prof_unlock(&cell->lock);
+    mark_cell_dirty(s->coord);
+}
+
+/* one new survivor; returns the seconds until the next */
+static int spawn_survivor() {
     time_t t;
     struct tm discovery_time;
+    long t0 = trace_now();
+    // Generate random survivor
+    // x indexes map rows (height), y indexes columns (width)
+    Coord coord = {.x = rand() % map.height,
+                   .y = rand() % map.width};
+
+    char info[25];
+    snprintf(info, sizeof(info), "SURV-%04d", rand() % 10000);
+
+    time(&t);
+    localtime_r(&t, &discovery_time);
 
-    while (1) {
-        // Generate random survivor
-        Coord coord = {.x = rand() % map.width,
-                       .y = rand() % map.height};
-
-        char info[25];
-        snprintf(info, sizeof(info), "SURV-%04d", rand() % 10000);
-
-        time(&t);
-        localtime_r(&t, &discovery_time);
-
-        // Create and add to lists
-        Survivor *s = create_survivor(&coord, info, &discovery_time);
-        if (!s) continue;
-
-        // Add to global survivor list
-        pthread_mutex_lock(&survivors->lock);
-        survivors->add(survivors, s);
-        pthread_mutex_unlock(&survivors->lock);
-
-        // Add to map cell's survivor list
-        pthread_mutex_lock(
-            &map.cells[coord.x][coord.y].survivors->lock);
-        map.cells[coord.x][coord.y].survivors->add(
-            map.cells[coord.x][coord.y].survivors, s);
-        pthread_mutex_unlock(
-            &map.cells[coord.x][coord.y].survivors->lock);
-
-        printf("New survivor at (%d,%d): %s\n", coord.x, coord.y,
-               info);
-        sleep(rand() % 3 + 2);  // Generate every 2-5 seconds
+    // Create and add to lists
+    Survivor *s = create_survivor(&coord, info, &discovery_time);
+    if (!s) return 1;
+    s->priority = rand() % PRIORITY_LEVELS;
+
+    // Open a mission for it, the AI picks it up from there
+    int id = mission_enqueue(s);
+    if (id < 0) {
+        free(s);
+        return 1;
     }
+
+    survivor_place(s);
+    free(s);  // both lists hold copies
+    trace_span("survivor_add", t0, id);
+
+    printf("New survivor at (%d,%d): %s\n", coord.x, coord.y, info);
+    return rand() % 3 + 2;  // Generate every 2-5 seconds
+}
+
+void *survivor_generator(void *args) {
+    (void)args;  // Unused parameter
+    trace_thread_name("survivor_generator");
+    while (running) sleep(spawn_survivor());
     return NULL;
 }
 
+/* survivor_generator() as a pool task (pool.h), re-armed after each */
+void survivor_task(void *arg) {
+    if (running) pool_after(spawn_survivor() * 1000L, survivor_task, arg,
+                            POOL_ANY);
+}
+
 void survivor_cleanup(Survivor *s) {
     // Remove from map cell
-    pthread_mutex_lock(
-        &map.cells[s->coord.x][s->coord.y].survivors->lock);
-    map.cells[s->coord.x][s->coord.y].survivors->removedata(
-        map.cells[s->coord.x][s->coord.y].survivors, s);
-    pthread_mutex_unlock(
-        &map.cells[s->coord.x][s->coord.y].survivors->lock);
+    List *cell = map.cells[s->coord.x][s->coord.y].survivors;
+    prof_lock(&cell->lock);
+    cell->removedata(cell, s);
+    prof_unlock(&cell->lock);
+    mark_cell_dirty(s->coord);
 
     free(s);
-}
\ No newline at end of file
+}
+
+/* compares the fields that identify a survivor, not its padding */
+static int same_survivor(const Survivor *a, const Survivor *b) {
+    const struct tm *ta = &a->discovery_time, *tb = &b->discovery_time;
+    return strcmp(a->info, b->info) == 0 && ta->tm_sec == tb->tm_sec &&
+           ta->tm_min == tb->tm_min && ta->tm_hour == tb->tm_hour &&
+           ta->tm_yday == tb->tm_yday && ta->tm_year == tb->tm_year;
+}
+
+/* moves a rescued survivor from its map cell to helpedsurvivors */
+void survivor_helped(Survivor *s) {
+    List *cell = map.cells[s->coord.x][s->coord.y].survivors;
+    prof_lock(&cell->lock);
+    long locked = metrics_now_ns();
+    for (Node *node = cell->head; node != NULL; node = node->next) {
+        Survivor *c = (Survivor *)node->data;
+        if (same_survivor(c, s)) {
+            cell->removenode(cell, node);
+            break;
+        }
+    }
+    metrics_record(METRIC_LIST_LOCK_HOLD, metrics_now_ns() - locked);
+    prof_unlock(&cell->lock);
+    mark_cell_dirty(s->coord);
+
+    time_t now = time(NULL);
+    localtime_r(&now, &s->helped_time);
+    s->status = 1;
+    prof_lock(&helpedsurvivors->lock);
+    locked = metrics_now_ns();
+    survivor_remember(s);
+    metrics_record(METRIC_LIST_LOCK_HOLD, metrics_now_ns() - locked);
+    prof_unlock(&helpedsurvivors->lock);
+}
+
+/* adds s to helpedsurvivors, dropping the oldest (the tail) when it is
+ * full; caller holds its lock, or runs before the other threads */
+void survivor_remember(const Survivor *s) {
+    if (helpedsurvivors->number_of_elements >= helpedsurvivors->capacity)
+        helpedsurvivors->removenode(helpedsurvivors, helpedsurvivors->tail);
+    helpedsurvivors->add(helpedsurvivors, (void *)s);
+}
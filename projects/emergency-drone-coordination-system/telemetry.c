@@ -0,0 +1,138 @@
+/**
+ * @file telemetry.c
+ * @brief UDP channel for STATUS_UPDATEs (server --telemetry PORT).
+ *
+ * A STATUS_UPDATE is periodic and the next one supersedes it, so it
+ * needs neither TCP's retransmits nor its ordering: a lost update is
+ * replaced by the next, and one stuck behind a lost segment is stale
+ * by the time it arrives. A drone that sends "telemetry": "udp" in its
+ * HANDSHAKE gets a telemetry_id (its registry record) and a random
+ * telemetry_key for this session in HANDSHAKE_ACK, and from then on
+ * sends its STATUS_UPDATEs as datagrams (see wire.h).
+ *
+ * One thread receives them, up to TELEMETRY_BATCH per recvmmsg(). A
+ * datagram is taken if its key is the drone's current one and its
+ * sequence number is newer than the last one taken; anything older was
+ * overtaken on the way and is dropped. When the server falls behind
+ * the socket buffer overflows and the kernel drops datagrams, which
+ * replaces the reactors' shedding for this channel. Missions, ACKs and
+ * heartbeats stay on the TCP connection.
+ */
+#define _GNU_SOURCE  // recvmmsg
+#include "headers/telemetry.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "headers/globals.h"
+#include "headers/lockprof.h"
+#include "headers/wire.h"
+
+#define TELEMETRY_RCVBUF (4 << 20)
+
+TelemetryStats telemetry_stats;
+
+static int sock = -1;
+static pthread_t thread;
+static Registry *drones_by_id;
+static void (*handler)(Drone *d, Message *msg);
+
+/* a random session key, never 0 (0 means no UDP channel) */
+unsigned int telemetry_new_key() {
+    unsigned int key = 0;
+    while (key == 0)
+        if (getrandom(&key, sizeof(key), 0) != sizeof(key)) key = rand();
+    return key;
+}
+
+static void take(const unsigned char *buf, size_t len) {
+    unsigned int id, key, seq;
+    Message msg;
+    if (decode_telemetry(buf, len, &id, &key, &seq, &msg) != 0 || id < 1 ||
+        id > (unsigned int)drones_by_id->capacity || key == 0) {
+        telemetry_stats.invalid++;
+        return;
+    }
+    Drone *d = &drones_by_id->pool[id - 1];
+    // a record gets its first key after its lock is set up
+    if (__atomic_load_n(&d->telemetry_key, __ATOMIC_ACQUIRE) != key) {
+        telemetry_stats.invalid++;
+        return;
+    }
+    prof_lock(&d->lock);
+    if (d->telemetry_key != key) {  // reconnected meanwhile
+        telemetry_stats.invalid++;
+    } else if ((int)(seq - d->telemetry_seq) <= 0) {
+        telemetry_stats.stale++;
+    } else {
+        d->telemetry_seq = seq;
+        handler(d, &msg);
+        telemetry_stats.taken++;
+    }
+    prof_unlock(&d->lock);
+}
+
+static void *receive(void *arg) {
+    (void)arg;
+    static unsigned char bufs[TELEMETRY_BATCH][TELEMETRY_MAX];
+    struct iovec iov[TELEMETRY_BATCH];
+    struct mmsghdr msgs[TELEMETRY_BATCH];
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < TELEMETRY_BATCH; i++) {
+        iov[i] = (struct iovec){bufs[i], sizeof(bufs[i])};
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    while (running) {
+        // blocks for the first datagram (at most SO_RCVTIMEO), then
+        // takes whatever else is queued
+        int n = recvmmsg(sock, msgs, TELEMETRY_BATCH, MSG_WAITFORONE, NULL);
+        if (n <= 0) continue;  // timeout or EINTR: check running
+        telemetry_stats.batches++;
+        telemetry_stats.datagrams += n;
+        for (int i = 0; i < n; i++) take(bufs[i], msgs[i].msg_len);
+    }
+    return NULL;
+}
+
+/**
+ * @brief opens the UDP port and starts the receiving thread
+ * @param registry: drones by telemetry_id (their record)
+ * @return int: 0, -1 if the port cannot be bound
+ */
+int start_telemetry(int port, Registry *registry,
+                    void (*on_status)(Drone *d, Message *msg)) {
+    struct sockaddr_in addr = {.sin_family = AF_INET,
+                               .sin_port = htons(port),
+                               .sin_addr.s_addr = htonl(INADDR_ANY)};
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("telemetry port");
+        if (sock >= 0) close(sock);
+        sock = -1;
+        return -1;
+    }
+    int rcvbuf = TELEMETRY_RCVBUF;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct timeval timeout = {.tv_usec = 200000};  // to notice !running
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    drones_by_id = registry;
+    handler = on_status;
+    pthread_create(&thread, NULL, receive, NULL);
+    return 0;
+}
+
+void stop_telemetry() {
+    if (sock < 0) return;
+    pthread_join(thread, NULL);  // returns once running is cleared
+    close(sock);
+    sock = -1;
+}
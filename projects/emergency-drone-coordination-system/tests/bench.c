@@ -0,0 +1,323 @@
+/* microbenchmarks of the simulator's data structures and of mission
+ * assignment, for tracking regressions across builds:
+ *
+ *   list_add_pop      add + pop at the head of a List holding `fill`
+ *   list_removedata   removedata + add of an element in the middle
+ *   list_shared       add + pop under list->lock from `threads` threads
+ *   nearest_drone     find_closest_idle_drone() over `drones` drones
+ *   map_cell_update   a survivor added to and removed from a map cell,
+ *                     both logged as dirty, the log drained per tick
+ *   assignment        enqueue, match, assign and complete one mission
+ *                     with `drones` idle drones, as the AI does
+ *   assignment_traced the same with tracing on (trace.h), few enough
+ *                     that no event is dropped
+ *   regions           `regions` AI workers (region.h) assigning a
+ *                     backlog spread evenly over the map to 10000 idle
+ *                     drones, until all are assigned
+ *
+ * One row per benchmark and parameter, CSV by default:
+ *   build,benchmark,param,value,ops,ns_per_op,ops_per_sec
+ *
+ * usage: bench [--json] [--quick]
+ */
+#include "../headers/ai.h"
+#include "../headers/globals.h"
+#include "../headers/list.h"
+#include "../headers/map.h"
+#include "../headers/mission.h"
+#include "../headers/region.h"
+#include "../headers/survivor.h"
+#include "../headers/trace.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef BENCH_BUILD
+#define BENCH_BUILD "unknown"
+#endif
+
+List *helpedsurvivors, *drones;
+volatile sig_atomic_t running = 1;
+
+static int json, quick, rows;
+static volatile long sink;  // keeps results alive
+
+static long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static void report(const char *bench, const char *param, long value,
+                   long ops, long ns) {
+    double per_op = (double)ns / ops, per_sec = ops * 1e9 / ns;
+    if (json)
+        printf("%s  {\"build\": \"%s\", \"benchmark\": \"%s\", \"param\": "
+               "\"%s\", \"value\": %ld, \"ops\": %ld, \"ns_per_op\": %.2f, "
+               "\"ops_per_sec\": %.0f}",
+               rows ? ",\n" : "[\n", BENCH_BUILD, bench, param, value, ops,
+               per_op, per_sec);
+    else
+        printf("%s,%s,%s,%ld,%ld,%.2f,%.0f\n", BENCH_BUILD, bench, param,
+               value, ops, per_op, per_sec);
+    rows++;
+}
+
+/* stdout to /dev/null while on, so init_map()'s messages stay out of
+ * the results */
+static void quiet(int on) {
+    static int saved = -1;
+    fflush(stdout);
+    if (on) {
+        int devnull = open("/dev/null", O_WRONLY);
+        saved = dup(1);
+        dup2(devnull, 1);
+        close(devnull);
+    } else if (saved >= 0) {
+        dup2(saved, 1);
+        close(saved);
+    }
+}
+
+static long scaled(long ops) {
+    return quick ? ops / 10 : ops;
+}
+
+static Survivor survivor(int i) {
+    Survivor s = {.priority = i % PRIORITY_LEVELS,
+                  .coord = {i % map.height, (i / map.height) % map.width}};
+    snprintf(s.info, sizeof(s.info), "SURV-%d", i);
+    return s;
+}
+
+static void bench_list_add_pop(int fill) {
+    List *l = create_list(sizeof(Survivor), fill + 1);
+    for (int i = 0; i < fill; i++) {
+        Survivor s = survivor(i);
+        l->add(l, &s);
+    }
+    long ops = scaled(2000000);
+    Survivor s = survivor(0), out;
+    long t0 = now_ns();
+    for (long i = 0; i < ops; i++) {
+        s.coord.x = i;
+        l->add(l, &s);
+        l->pop(l, &out);
+        sink += out.coord.x;
+    }
+    report("list_add_pop", "fill", fill, ops, now_ns() - t0);
+    l->destroy(l);
+}
+
+static void bench_list_removedata(int fill) {
+    List *l = create_list(sizeof(Survivor), fill);
+    Survivor *all = malloc(fill * sizeof(Survivor));
+    for (int i = 0; i < fill; i++) {
+        all[i] = survivor(i);
+        l->add(l, &all[i]);
+    }
+    long ops = scaled(fill >= 10000 ? 2000 : 1000000);  // O(fill) each
+    long t0 = now_ns();
+    for (long i = 0; i < ops; i++) {
+        // the element added longest ago of the middle half
+        Survivor *s = &all[(fill / 4 + i) % fill];
+        sink += l->removedata(l, s);
+        l->add(l, s);
+    }
+    report("list_removedata", "fill", fill, ops, now_ns() - t0);
+    free(all);
+    l->destroy(l);
+}
+
+static List *shared;
+static long per_thread;
+
+static void *list_worker(void *arg) {
+    Survivor s = survivor((int)(long)arg), out;
+    for (long i = 0; i < per_thread; i++) {
+        pthread_mutex_lock(&shared->lock);
+        shared->add(shared, &s);
+        pthread_mutex_unlock(&shared->lock);
+        pthread_mutex_lock(&shared->lock);
+        shared->pop(shared, &out);
+        pthread_mutex_unlock(&shared->lock);
+    }
+    return NULL;
+}
+
+static void bench_list_shared(int threads) {
+    shared = create_list(sizeof(Survivor), 1000 + threads);
+    for (int i = 0; i < 1000; i++) {
+        Survivor s = survivor(i);
+        shared->add(shared, &s);
+    }
+    per_thread = scaled(1000000) / threads;
+    pthread_t *t = malloc(threads * sizeof(pthread_t));
+    long t0 = now_ns();
+    for (long i = 0; i < threads; i++)
+        pthread_create(&t[i], NULL, list_worker, (void *)i);
+    for (int i = 0; i < threads; i++) pthread_join(t[i], NULL);
+    report("list_shared", "threads", threads, per_thread * threads,
+           now_ns() - t0);
+    free(t);
+    shared->destroy(shared);
+}
+
+/* n idle drones spread over the map, in the global drones list */
+static Drone *make_fleet(int n) {
+    Drone *fleet = calloc(n, sizeof(Drone));
+    drones = create_list(sizeof(Drone *), n);
+    srand(1);
+    for (int i = 0; i < n; i++) {
+        Drone *d = &fleet[i];
+        d->id = i + 1;
+        d->status = IDLE;
+        d->coord = (Coord){rand() % map.height, rand() % map.width};
+        pthread_mutex_init(&d->lock, NULL);
+        drones->add(drones, &d);
+    }
+    return fleet;
+}
+
+static void free_fleet(Drone *fleet, int n) {
+    for (int i = 0; i < n; i++) pthread_mutex_destroy(&fleet[i].lock);
+    free(fleet);
+    drones->destroy(drones);
+}
+
+static void bench_nearest_drone(int n) {
+    Drone *fleet = make_fleet(n);
+    long ops = scaled(n >= 10000 ? 20000 : 200000);
+    long t0 = now_ns();
+    for (long i = 0; i < ops; i++) {
+        Coord target = {i % map.height, (i / 7) % map.width};
+        sink += find_closest_idle_drone(target)->id;
+    }
+    report("nearest_drone", "drones", n, ops, now_ns() - t0);
+    free_fleet(fleet, n);
+}
+
+static void bench_map_cell_update(int cells) {
+    long ops = scaled(1000000);
+    int *dirty = malloc(map.height * map.width * sizeof(int));
+    long t0 = now_ns();
+    for (long i = 0; i < ops; i++) {
+        Survivor s = survivor(i % cells);
+        survivor_place(&s);
+        List *cell = map.cells[s.coord.x][s.coord.y].survivors;
+        pthread_mutex_lock(&cell->lock);
+        sink += cell->removedata(cell, &s);
+        pthread_mutex_unlock(&cell->lock);
+        mark_cell_dirty(s.coord);
+        if (i % cells == 0)
+            sink += take_dirty_cells(dirty, map.height * map.width);
+    }
+    report("map_cell_update", "cells", cells, ops, now_ns() - t0);
+    free(dirty);
+}
+
+static void bench_assignment(const char *name, int n, long ops) {
+    Drone *fleet = make_fleet(n);
+    mission_init(1000, 600);
+    long t0 = now_ns();
+    for (long i = 0; i < ops; i++) {
+        Survivor s = survivor(i);
+        mission_enqueue(&s);
+        pthread_mutex_lock(&missions.lock);
+        Mission *m = mission_next();
+        Drone *d = find_closest_idle_drone(m->survivor.coord);
+        assign_mission(d, m);
+        pthread_mutex_unlock(&missions.lock);
+
+        // the drone arrives at once
+        Survivor done;
+        pthread_mutex_lock(&d->lock);
+        int id = d->mission_id;
+        d->status = IDLE;
+        d->mission_id = 0;
+        pthread_mutex_unlock(&d->lock);
+        sink += mission_complete(id, d, &done);
+    }
+    report(name, "drones", n, ops, now_ns() - t0);
+    mission_destroy();
+    free_fleet(fleet, n);
+}
+
+static int region_assigned;
+
+static void count_assignment(Drone *drone, const Mission *m) {
+    (void)drone;
+    (void)m;
+    __atomic_add_fetch(&region_assigned, 1, __ATOMIC_RELEASE);
+}
+
+static void bench_regions(int k) {
+    int n = 10000;
+    long ops = scaled(5000);
+    Drone *fleet = make_fleet(n);
+    mission_init(ops, 600);
+    regions_init(k, n);
+    for (int i = 0; i < n; i++) region_track(&fleet[i]);
+    for (long i = 0; i < ops; i++) {
+        Survivor s = survivor(i);
+        mission_enqueue(&s);
+    }
+    region_assigned = 0;
+    mission_hook = count_assignment;
+    quiet(1);  // workers log every assignment
+    long t0 = now_ns();
+    regions_start();
+    while (__atomic_load_n(&region_assigned, __ATOMIC_ACQUIRE) < ops)
+        usleep(100);
+    long ns = now_ns() - t0;
+    running = 0;
+    regions_stop();
+    running = 1;
+    quiet(0);
+    mission_hook = NULL;
+    report("regions", "regions", k, ops, ns);
+    mission_destroy();
+    free_fleet(fleet, n);
+}
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) json = 1;
+        else if (strcmp(argv[i], "--quick") == 0) quick = 1;
+        else {
+            fprintf(stderr, "usage: %s [--json] [--quick]\n", argv[0]);
+            return 1;
+        }
+    }
+    quiet(1);
+    init_map(40, 30);
+    quiet(0);
+    if (!json) printf("build,benchmark,param,value,ops,ns_per_op,ops_per_sec\n");
+    helpedsurvivors = create_list(sizeof(Survivor), 1000);
+    int fills[] = {10, 1000, 100000};
+    for (int i = 0; i < 3; i++) bench_list_add_pop(fills[i]);
+    for (int i = 0; i < 3; i++) bench_list_removedata(fills[i]);
+    for (int t = 1; t <= 8; t *= 2) bench_list_shared(t);
+    int fleets[] = {100, 1000, 10000};
+    for (int i = 0; i < 3; i++) bench_nearest_drone(fleets[i]);
+    bench_map_cell_update(10);
+    bench_map_cell_update(map.height * map.width);
+    for (int i = 0; i < 3; i++)
+        bench_assignment("assignment", fleets[i],
+                         scaled(fleets[i] >= 10000 ? 20000 : 200000));
+    for (int k = 1; k <= 8; k *= 2) bench_regions(k);
+    trace_start();  // 6 events per mission, 32768 per thread; stays on
+    bench_assignment("assignment_traced", 1000, 5000);
+    if (json) printf("\n]\n");
+
+    helpedsurvivors->destroy(helpedsurvivors);
+    quiet(1);
+    freemap();
+    quiet(0);
+    return 0;
+}
@@ -0,0 +1,177 @@
+/* fault injection for the mission table (mission.c) and the AI
+ * (ai.c): a fleet of drones gets a mission each, except for a reserve
+ * of idle ones. Then 10% of the fleet drops at once, the way on_close()
+ * in server.c handles a lost connection, and the time until every lost
+ * mission is assigned again is measured. A second round lets missions
+ * pass their deadline instead. Detecting a dead drone (socket error or
+ * missed heartbeats) is not part of the numbers.
+ *
+ * usage: failover [drones=1000] [drop%=10] [idle%=20]
+ */
+#include "../headers/ai.h"
+#include "../headers/globals.h"
+#include "../headers/mission.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+List *helpedsurvivors, *drones;
+volatile sig_atomic_t running = 1;
+Map map = {.height = 40, .width = 30};
+
+static long *assigned_ns;  // last assignment of each mission slot
+static int *order;         // priorities in the order missions went out
+static int assignments;
+
+static long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/* runs on the AI thread with drone->lock held, like send_mission() */
+static void record(Drone *drone, const Mission *m) {
+    (void)drone;
+    assigned_ns[(m->id - 1) % missions.capacity] = now_ns();
+    order[assignments % missions.capacity] = m->survivor.priority;
+    __atomic_add_fetch(&assignments, 1, __ATOMIC_RELEASE);
+}
+
+static int assigned() {
+    return __atomic_load_n(&assignments, __ATOMIC_ACQUIRE);
+}
+
+static int cmp_long(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+/* waits until `target` assignments were made, at most 5 s */
+static int wait_for(int target) {
+    for (int i = 0; i < 5000 && assigned() < target; i++) usleep(1000);
+    return assigned() >= target;
+}
+
+/* reassignment latency of the missions in ids[], from t0 */
+static int report(const char *what, int *ids, int n, long t0, int first) {
+    long *lat = malloc(n * sizeof(long));
+    for (int i = 0; i < n; i++)
+        lat[i] = assigned_ns[(ids[i] - 1) % missions.capacity] - t0;
+    qsort(lat, n, sizeof(long), cmp_long);
+
+    // requeued missions went out highest priority first
+    int sorted = 1;
+    for (int i = first + 1; i < first + n; i++)
+        if (order[i % missions.capacity] > order[(i - 1) % missions.capacity])
+            sorted = 0;
+    fprintf(stderr, "%-8s %d missions  p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms  "
+           "priority order %s\n",
+           what, n, lat[n / 2] / 1e6, lat[n * 99 / 100] / 1e6,
+           lat[n - 1] / 1e6, sorted ? "kept" : "BROKEN");
+    free(lat);
+    return sorted;
+}
+
+int main(int argc, char *argv[]) {
+    int n = argc > 1 ? atoi(argv[1]) : 1000;
+    int drop = n * (argc > 2 ? atoi(argv[2]) : 10) / 100;
+    int busy = n - n * (argc > 3 ? atoi(argv[3]) : 20) / 100;
+    if (drop < 1 || drop > busy) {
+        fprintf(stderr, "need 1 <= dropped <= busy drones\n");
+        return 1;
+    }
+
+    // the AI logs every assignment; keep the results on stderr only
+    freopen("/dev/null", "w", stdout);
+
+    drones = create_list(sizeof(Drone *), n);
+    mission_init(n, 0);
+    assigned_ns = calloc(n, sizeof(long));
+    order = calloc(n, sizeof(int));
+    mission_hook = record;
+
+    Drone *fleet = calloc(n, sizeof(Drone));
+    for (int i = 0; i < n; i++) {
+        Drone *d = &fleet[i];
+        d->id = i;
+        d->status = IDLE;
+        d->coord = (Coord){rand() % map.height, rand() % map.width};
+        pthread_mutex_init(&d->lock, NULL);
+        drones->add(drones, &d);
+    }
+
+    pthread_t ai;
+    pthread_create(&ai, NULL, ai_controller, NULL);
+    for (int i = 0; i < busy; i++) {
+        Survivor s = {.priority = rand() % PRIORITY_LEVELS,
+                      .coord = {rand() % map.height, rand() % map.width}};
+        snprintf(s.info, sizeof(s.info), "SURV-%04d", i);
+        mission_enqueue(&s);
+    }
+    if (!wait_for(busy)) {
+        fprintf(stderr, "only %d of %d missions assigned\n", assigned(), busy);
+        return 1;
+    }
+
+    // round 1: drop `drop` busy drones at once
+    // (holding missions.lock so the AI sees them all together)
+    int *ids = malloc(drop * sizeof(int));
+    int lost = 0, first = assigned();
+    pthread_mutex_lock(&missions.lock);
+    long t0 = now_ns();
+    for (int i = 0; i < n && lost < drop; i++) {
+        Drone *d = &fleet[i];
+        pthread_mutex_lock(&d->lock);
+        int id = d->status == ON_MISSION ? d->mission_id : 0;
+        if (id) {
+            d->status = DISCONNECTED;
+            d->mission_id = 0;
+        }
+        pthread_mutex_unlock(&d->lock);
+        Mission *m = mission_find(id);
+        if (m) {
+            mission_requeue(m);
+            ids[lost++] = id;
+        }
+    }
+    pthread_mutex_unlock(&missions.lock);
+    int ok = wait_for(first + lost);
+    long total = now_ns() - t0;
+    fprintf(stderr, "%d drones, %d busy, %d dropped at once\n", n, busy, lost);
+    if (ok) ok = report("dropped", ids, lost, t0, first);
+    fprintf(stderr, "all reassigned after %.3f ms, %ld requeued\n", total / 1e6,
+           missions.requeued);
+
+    // round 2: the same number of missions runs past its deadline; the
+    // AI sleeps until the earliest deadline, which just moved to now
+    pthread_mutex_lock(&missions.lock);
+    int expired = 0;
+    time_t now = time(NULL);
+    first = assigned();
+    for (Mission *m = missions.deadlines.next;
+         m != &missions.deadlines && expired < drop; m = m->next) {
+        m->deadline = now;  // still in deadline order
+        ids[expired++] = m->id;
+    }
+    t0 = now_ns();
+    pthread_mutex_unlock(&missions.lock);
+    mission_wake();
+    if (ok) ok = wait_for(first + expired);
+    if (ok) ok = report("expired", ids, expired, t0, first);
+    fprintf(stderr, "%ld expired\n", missions.expired);
+
+    running = 0;
+    mission_wake();
+    pthread_join(ai, NULL);
+    for (int i = 0; i < n; i++) pthread_mutex_destroy(&fleet[i].lock);
+    free(fleet);
+    free(ids);
+    free(assigned_ns);
+    free(order);
+    mission_destroy();
+    drones->destroy(drones);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+#!/bin/sh
+# epoll vs io_uring backend of server.out, side by side: the same
+# loadgen fleet against each, reporting server CPU per 1000 inbound
+# messages, system calls per message and the loadgen's round trips.
+#
+# usage: sh tests/iobench.sh [sizes="1000 10000 50000"] [seconds=30]
+#        (after make server loadgen)
+# Beyond about 28000 connections one client address runs out of
+# ephemeral ports, so the fleet is split over loadgens that connect to
+# 127.0.0.1, 127.0.0.2, ... Every size needs that many fds in the
+# server: sizes above `ulimit -Hn` are skipped.
+SIZES=${1:-"1000 10000 50000"}
+SECONDS_RUN=${2:-30}
+PORT=${PORT:-9700}
+PER_CLIENT=15000
+LOG=$(mktemp -d)
+trap 'kill $SERVER 2>/dev/null; rm -rf "$LOG"' EXIT
+HZ=$(getconf CLK_TCK)
+LIMIT=$(ulimit -Hn)
+
+cpu_ticks() {  # utime + stime of pid $1
+    awk '{print $14 + $15}' "/proc/$1/stat"
+}
+
+printf "%-7s %-6s %10s %12s %10s %12s %12s %7s\n" backend drones msgs/s \
+    "cpu ms/1k" "syscalls" "rtt p50 ms" "rtt p99 ms" errors
+for n in $SIZES; do
+    if [ "$n" -ge "$LIMIT" ]; then
+        echo "$n drones: skipped, the fd limit is $LIMIT"
+        continue
+    fi
+    for io in epoll uring; do
+        stdbuf -oL ./server.out --port "$PORT" --max-drones "$n" --io "$io" \
+            > "$LOG/server" 2>&1 &
+        SERVER=$!
+        sleep 0.5
+        t0=$(cpu_ticks $SERVER)
+        left=$n i=0 pids=""
+        while [ "$left" -gt 0 ]; do
+            part=$((left < PER_CLIENT ? left : PER_CLIENT))
+            ./loadgen.out --port "$PORT" --host "127.0.0.$((i + 1))" \
+                --drones "$part" --seconds "$SECONDS_RUN" --connect-rate 2000 \
+                --id-base $((i * PER_CLIENT)) > "$LOG/client$i" 2>&1 &
+            pids="$pids $!"
+            left=$((left - part))
+            i=$((i + 1))
+        done
+        wait $pids
+        t1=$(cpu_ticks $SERVER)
+        stats=$(grep "^connections:" "$LOG/server" | tail -2 | head -1)
+        kill -INT $SERVER
+        wait $SERVER 2>/dev/null
+
+        cat "$LOG"/client* | awk -v io="$io" -v n="$n" -v hz="$HZ" \
+            -v cpu=$((t1 - t0)) -v stats="$stats" '
+            /^sent/ { sent += $2; gsub(/[(\/s)]/, "", $4); rate += $4 }
+            /^round-trip/ { p50 = $3 > p50 ? $3 : p50; p99 = $7 > p99 ? $7 : p99 }
+            /^errors/ { errors += $2 }
+            END {
+                split(stats, f, "syscalls/message: ")
+                printf "%-7s %-6d %10.0f %12.3f %10s %12.2f %12.2f %7d\n",
+                       io, n, rate, sent ? cpu * 1000 / hz / (sent / 1000) : 0,
+                       f[2], p50, p99, errors
+            }'
+        rm -f "$LOG"/client*
+        PORT=$((PORT + 1))
+    done
+done
@@ -0,0 +1,271 @@
+/* crash recovery through the mission journal (journal.c): a child
+ * process drives the mission table (mission.c) the way the server does,
+ * with journal_mission() as its observer, and is killed without closing
+ * the journal. The parent recovers the directory and checks that the
+ * open missions, helped survivors and drones came back under their ids,
+ * with a torn record at the end of the journal ignored. Then recovery
+ * time is measured against the length of the journal tail, and the
+ * cost of a record on the caller's side against the commits it took.
+ *
+ * usage: journaltest [dir=/tmp/journaltest]
+ */
+#include "../headers/journal.h"
+#include "../headers/mission.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MISSIONS 1000
+#define DRONES 100
+
+static Drone fleet[DRONES];
+static int restored_drones, restored_missions, restored_helped;
+static int restored_ids[MISSIONS];
+static char restored_names[DRONES][16];
+
+static long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static void on_drone(const char *name, Coord coord) {
+    (void)coord;
+    if (restored_drones < DRONES)
+        snprintf(restored_names[restored_drones], 16, "%s", name);
+    restored_drones++;
+}
+
+static void on_mission(int id, const Survivor *s) {
+    (void)s;
+    if (restored_missions < MISSIONS) restored_ids[restored_missions] = id;
+    restored_missions++;
+}
+
+static void on_helped(const Survivor *s) {
+    (void)s;
+    restored_helped++;
+}
+
+static JournalRestore restore = {on_drone, on_mission, on_helped};
+
+static int open_journal(const char *dir) {
+    restored_drones = restored_missions = restored_helped = 0;
+    return journal_open(dir, MISSIONS, DRONES, &restore);
+}
+
+static void clear(const char *dir) {
+    char cmd[300];
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", dir);
+    if (system(cmd) != 0) perror(cmd);
+}
+
+static Survivor survivor(int i) {
+    Survivor s = {.priority = i % PRIORITY_LEVELS,
+                  .coord = {i % 40, i % 30}};
+    time_t t = time(NULL);
+    localtime_r(&t, &s.discovery_time);
+    snprintf(s.info, sizeof(s.info), "SURV-%04d", i % 10000);
+    return s;
+}
+
+/* one round of the server's work: a drone completes its mission, a
+ * new one opens and the drone gets the first waiting one */
+static void step(int i) {
+    Drone *d = &fleet[i % DRONES];
+    if (d->mission_id) {
+        Survivor done;
+        mission_complete(d->mission_id, d, &done);
+        d->mission_id = 0;
+    }
+    Survivor s = survivor(i);
+    mission_enqueue(&s);
+    pthread_mutex_lock(&missions.lock);
+    Mission *m = mission_next();
+    if (m) {
+        mission_start(m, d);
+        d->mission_id = m->id;
+    }
+    pthread_mutex_unlock(&missions.lock);
+}
+
+/* a fleet with nothing to do, and a backlog of waiting missions */
+static void start_fleet(int backlog) {
+    for (int i = 0; i < DRONES; i++) {
+        fleet[i] = (Drone){.id = i + 1};
+        snprintf(fleet[i].name, sizeof(fleet[i].name), "D%d", i + 1);
+        journal_drone(&fleet[i]);
+    }
+    for (int i = 0; i < backlog; i++) {
+        Survivor s = survivor(i);
+        mission_enqueue(&s);
+    }
+}
+
+/* sends stdout (journal_open()'s report) to /dev/null, or back */
+static void quiet(int on) {
+    static int saved = -1;
+    fflush(stdout);
+    if (on && saved < 0) {
+        int devnull = open("/dev/null", O_WRONLY);
+        saved = dup(1);
+        dup2(devnull, 1);
+        close(devnull);
+    } else if (!on && saved >= 0) {
+        dup2(saved, 1);
+        close(saved);
+        saved = -1;
+    }
+}
+
+/* the latest journal generation in dir */
+static void latest_journal(const char *dir, char *path, size_t size) {
+    DIR *dp = opendir(dir);
+    unsigned int best = 0, gen;
+    struct dirent *e;
+    while (dp && (e = readdir(dp)))
+        if (sscanf(e->d_name, "journal.%u", &gen) == 1 && gen > best)
+            best = gen;
+    if (dp) closedir(dp);
+    snprintf(path, size, "%s/journal.%u", dir, best);
+}
+
+/* child: registers the fleet, runs `rounds` steps, syncs, tears the
+ * last record and dies without journal_close(); reports to report_fd
+ * what recovery has to find */
+static void crash_after(const char *dir, int rounds, int tear, int report_fd) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        quiet(1);
+        if (open_journal(dir) != 0) _exit(2);
+        mission_init(MISSIONS, 600);
+        mission_observer = journal_mission;
+        start_fleet(200);
+        for (int i = 0; i < rounds; i++) step(i);
+        journal_sync();
+        if (tear) {
+            char path[300];
+            latest_journal(dir, path, sizeof(path));
+            int fd = open(path, O_WRONLY | O_APPEND);
+            unsigned char torn[] = {40, 0, 3, 1, 2, 3, 4, 9, 9};
+            if (fd < 0 || write(fd, torn, sizeof(torn)) < 0) _exit(3);
+            close(fd);
+        }
+        if (report_fd >= 0)
+            dprintf(report_fd, "%d %d %ld\n",
+                    missions.waiting + missions.assigned, missions.assigned,
+                    journal_stats.records);
+        kill(getpid(), SIGKILL);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+}
+
+static int check_recovery(const char *dir) {
+    clear(dir);
+    int fds[2];
+    if (pipe(fds) != 0) return 0;
+    crash_after(dir, 3000, 1, fds[1]);
+    close(fds[1]);
+    char line[100] = "";
+    ssize_t n = read(fds[0], line, sizeof(line) - 1);
+    close(fds[0]);
+    int open_missions = -1, were_assigned = -1;
+    long records = 0;
+    if (n <= 0 || sscanf(line, "%d %d %ld", &open_missions, &were_assigned,
+                         &records) != 3) {
+        fprintf(stderr, "child did not report\n");
+        return 0;
+    }
+
+    mission_init(MISSIONS, 600);
+    if (open_journal(dir) != 0) return 0;
+    journal_close();
+    int ids_ok = 1;
+    for (int i = 0; i < restored_missions && i < MISSIONS; i++)
+        if (restored_ids[i] <= 0) ids_ok = 0;
+    for (int i = 0; i < restored_drones && i < DRONES; i++) {
+        char want[16];
+        snprintf(want, sizeof(want), "D%d", i + 1);
+        if (strcmp(restored_names[i], want) != 0) ids_ok = 0;
+    }
+    int ok = restored_missions == open_missions && restored_drones == DRONES &&
+             restored_helped > 0 && ids_ok;
+    fprintf(stderr, "recovery: %ld records before the crash, %d open missions "
+            "(%d assigned), %d drones, %d helped: %s\n",
+            records, restored_missions, were_assigned, restored_drones,
+            restored_helped, ok ? "ok" : "MISMATCH");
+
+    // a second start finds the checkpoint the first one wrote
+    int first = restored_missions;
+    mission_destroy();
+    mission_init(MISSIONS, 600);
+    open_journal(dir);
+    journal_close();
+    ok &= restored_missions == first;
+    fprintf(stderr, "restart:  %d open missions from the checkpoint: %s\n",
+            restored_missions, restored_missions == first ? "ok" : "MISMATCH");
+    mission_destroy();
+    return ok;
+}
+
+/* recovery time for a tail of `rounds` steps after the checkpoint */
+static void time_recovery(const char *dir, int rounds) {
+    clear(dir);
+    crash_after(dir, rounds, 0, -1);
+    quiet(1);
+    long t0 = now_ns();
+    open_journal(dir);
+    long t1 = now_ns();
+    journal_close();
+    quiet(0);
+    fprintf(stderr, "tail of %6d rounds: recovery %8.2f ms, %ld records "
+            "replayed\n", rounds, (t1 - t0) / 1e6, journal_stats.replayed);
+}
+
+/* caller-side cost of a record and how many went into one commit */
+static void time_appends(const char *dir, int rounds) {
+    clear(dir);
+    quiet(1);
+    open_journal(dir);
+
+    long elapsed[2];
+    for (int journaled = 0; journaled < 2; journaled++) {
+        mission_init(MISSIONS, 600);
+        mission_observer = journaled ? journal_mission : NULL;
+        start_fleet(200);
+        long t0 = now_ns();
+        for (int i = 0; i < rounds; i++) step(i);
+        elapsed[journaled] = now_ns() - t0;
+        mission_observer = NULL;
+        mission_destroy();
+    }
+    journal_sync();
+    fprintf(stderr, "%d rounds: %.0f ns per round without the journal, "
+            "%.0f ns with it; %ld records in %ld commits (%.1f per fsync)\n",
+            rounds, (double)elapsed[0] / rounds, (double)elapsed[1] / rounds,
+            journal_stats.records, journal_stats.commits,
+            journal_stats.commits
+                ? (double)journal_stats.records / journal_stats.commits
+                : 0.0);
+    journal_close();
+    quiet(0);
+}
+
+int main(int argc, char *argv[]) {
+    const char *dir = argc > 1 ? argv[1] : "/tmp/journaltest";
+    int ok = check_recovery(dir);
+    for (int rounds = 1000; rounds <= 64000; rounds *= 4)
+        time_recovery(dir, rounds);
+    time_appends(dir, 20000);
+    clear(dir);
+    return ok ? 0 : 1;
+}
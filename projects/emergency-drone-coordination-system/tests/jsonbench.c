@@ -0,0 +1,95 @@
+/* throughput of the incremental JSON parser (json.c) on one core.
+ * A stream of drone -> server messages is fed in chunks of different
+ * sizes, as recv() would return them; every chunking has to yield the
+ * same messages.
+ *
+ * usage: jsonbench [messages=200000]
+ */
+#include "../headers/json.h"
+#include "../headers/protocol.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now_s() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* parses buf in chunks of chunk bytes; returns messages parsed and
+ * a checksum over their fields */
+static long parse_stream(const char *buf, size_t len, size_t chunk,
+                         long *checksum) {
+    JsonParser p;
+    Message msg;
+    long count = 0;
+    json_init(&p, &msg);
+    *checksum = 0;
+    for (size_t off = 0; off < len; off += chunk) {
+        size_t n = len - off < chunk ? len - off : chunk, pos = 0;
+        while (pos < n) {
+            size_t used;
+            int rc = json_feed(&p, buf + off + pos, n - pos, &used);
+            pos += used;
+            if (rc == JSON_DONE) {
+                count++;
+                *checksum += msg.type * 7 + msg.location.x * 31 +
+                             msg.location.y + msg.battery + msg.success +
+                             msg.drone_id[1];
+            } else if (rc != JSON_MORE) {
+                return -1;
+            }
+        }
+    }
+    return count;
+}
+
+int main(int argc, char *argv[]) {
+    int n = argc > 1 ? atoi(argv[1]) : 200000;
+    char *buf = malloc((size_t)n * MAX_MESSAGE);
+    size_t len = 0;
+
+    for (int i = 0; i < n; i++) {
+        char id[16];
+        snprintf(id, sizeof(id), "D%d", i % 10000);
+        char *out = buf + len;
+        switch (i % 10) {
+            case 0:
+                len += format_heartbeat_response(out, MAX_MESSAGE, id);
+                break;
+            case 1:
+                len += format_mission_complete(out, MAX_MESSAGE, id, "M42",
+                                               i % 3 != 0);
+                break;
+            default:
+                len += format_status_update(out, MAX_MESSAGE, id,
+                                            (Coord){i % 40, i % 30},
+                                            i % 2 ? "idle" : "busy", i % 101,
+                                            10);
+        }
+    }
+
+    size_t chunks[] = {len, 4096, 1460, 64, 7, 1};
+    long expected = -1, expected_sum = 0;
+    printf("%d messages, %.1f MB\n", n, len / 1e6);
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        long sum;
+        double t0 = now_s();
+        long count = parse_stream(buf, len, chunks[c], &sum);
+        double t = now_s() - t0;
+        if (count != n || (expected >= 0 && sum != expected_sum)) {
+            printf("chunk %zu: parsed %ld messages, checksum %ld != %ld\n",
+                   chunks[c], count, sum, expected_sum);
+            return 1;
+        }
+        expected = count;
+        expected_sum = sum;
+        printf("chunk %7zu B: %10.0f msgs/s  %7.1f MB/s\n", chunks[c],
+               count / t, len / t / 1e6);
+    }
+    free(buf);
+    return 0;
+}
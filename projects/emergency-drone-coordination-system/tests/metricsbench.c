@@ -0,0 +1,101 @@
+/* metrics.c under contention: N threads record into one histogram and
+ * one counter at once, against the same done with a shared mutex and
+ * with atomic adds on shared memory. Checks that no record is lost and
+ * that percentiles land within a bucket of the exact ones.
+ *
+ * usage: metricsbench [threads=4] [records per thread=2000000]
+ */
+#include "../headers/metrics.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int per_thread;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static long shared_count, shared_sum;
+
+/* durations 1 ns .. ~1 ms, spread over many buckets */
+static long sample(long i) {
+    return 1 + (i * 2654435761L) % 1000000;
+}
+
+static void *per_thread_metrics(void *arg) {
+    (void)arg;
+    for (long i = 0; i < per_thread; i++) {
+        metrics_record(METRIC_ASSIGN_LATENCY, sample(i));
+        metrics_add(METRIC_MISSIONS_ASSIGNED, 1);
+    }
+    return NULL;
+}
+
+static void *mutex_shared(void *arg) {
+    (void)arg;
+    for (long i = 0; i < per_thread; i++) {
+        pthread_mutex_lock(&lock);
+        shared_count++;
+        shared_sum += sample(i);
+        pthread_mutex_unlock(&lock);
+    }
+    return NULL;
+}
+
+static void *atomic_shared(void *arg) {
+    (void)arg;
+    for (long i = 0; i < per_thread; i++) {
+        __atomic_add_fetch(&shared_count, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&shared_sum, sample(i), __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static double run(void *(*fn)(void *), int threads) {
+    pthread_t *t = malloc(threads * sizeof(pthread_t));
+    long t0 = metrics_now_ns();
+    for (int i = 0; i < threads; i++) pthread_create(&t[i], NULL, fn, NULL);
+    for (int i = 0; i < threads; i++) pthread_join(t[i], NULL);
+    long elapsed = metrics_now_ns() - t0;
+    free(t);
+    return (double)elapsed / ((double)threads * per_thread);
+}
+
+static int cmp_long(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    per_thread = argc > 2 ? atoi(argv[2]) : 2000000;
+    if (threads < 1 || per_thread < 1) return 1;
+
+    printf("%d threads x %d records\n", threads, per_thread);
+    printf("per-thread shards  %6.1f ns/record\n", run(per_thread_metrics, threads));
+    printf("shared mutex       %6.1f ns/record\n", run(mutex_shared, threads));
+    shared_count = shared_sum = 0;
+    printf("shared atomics     %6.1f ns/record\n", run(atomic_shared, threads));
+
+    MetricSummary *s = malloc(sizeof(MetricSummary));
+    metrics_summary(METRIC_ASSIGN_LATENCY, s);
+    long expected = (long)threads * per_thread;
+    int ok = s->count == expected &&
+             metrics_counter(METRIC_MISSIONS_ASSIGNED) == expected;
+
+    // exact percentiles of one thread's samples, all threads record the same
+    long *exact = malloc(per_thread * sizeof(long));
+    for (long i = 0; i < per_thread; i++) exact[i] = sample(i);
+    qsort(exact, per_thread, sizeof(long), cmp_long);
+    double ps[] = {0.5, 0.9, 0.99};
+    for (int i = 0; i < 3; i++) {
+        long want = exact[(long)(ps[i] * (per_thread - 1))];
+        long got = metrics_percentile(s, ps[i]);
+        double err = (double)labs(got - want) / want;
+        ok &= err <= 1.0 / METRIC_SUB_BUCKETS;
+        printf("p%-4g exact %7ld  histogram %7ld  error %.2f%%\n",
+               ps[i] * 100, want, got, err * 100);
+    }
+    printf("records: %ld of %ld: %s\n", s->count, expected, ok ? "ok" : "LOST");
+    free(exact);
+    free(s);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+/* the thread pool (pool.c) against a thread per entity, the model of
+ * drone.c without --pool:
+ *
+ *   ticks   N drones each move one step every PERIOD_MS for SECONDS,
+ *           from their own thread (a usleep loop) or as self re-arming
+ *           pool timers. Ticks done against the ideal, context switches
+ *           and CPU time of the process (getrusage).
+ *   tasks   short tasks from one thread: pool_submit() against a
+ *           thread created and joined per task.
+ *
+ * usage: poolbench [workers=online CPUs] [seconds=1]
+ */
+#include "../headers/pool.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../headers/globals.h"
+
+#define PERIOD_MS 10
+
+volatile sig_atomic_t running = 1;
+
+typedef struct entity {
+    int id;
+    int x, y, tx, ty;  // position and target, like a Drone
+    long ticks;
+    pthread_mutex_t lock;
+} Entity;
+
+static long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+typedef struct usage {
+    long ns, cpu_us, voluntary, involuntary;
+} Usage;
+
+static Usage usage_now() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);  // all threads of the process
+    return (Usage){now_ns(),
+                   ru.ru_utime.tv_sec * 1000000L + ru.ru_utime.tv_usec +
+                       ru.ru_stime.tv_sec * 1000000L + ru.ru_stime.tv_usec,
+                   ru.ru_nvcsw, ru.ru_nivcsw};
+}
+
+/* a drone_behavior() step: move toward the target, pick a new one */
+static void step(Entity *e) {
+    pthread_mutex_lock(&e->lock);
+    e->x += (e->x < e->tx) - (e->x > e->tx);
+    e->y += (e->y < e->ty) - (e->y > e->ty);
+    if (e->x == e->tx && e->y == e->ty) {
+        e->tx = (e->tx * 7 + 3) % 40;
+        e->ty = (e->ty * 5 + 1) % 30;
+    }
+    e->ticks++;
+    pthread_mutex_unlock(&e->lock);
+}
+
+static void *entity_thread(void *arg) {
+    Entity *e = arg;
+    while (running) {
+        step(e);
+        usleep(PERIOD_MS * 1000);
+    }
+    return NULL;
+}
+
+static void entity_task(void *arg) {
+    Entity *e = arg;
+    step(e);
+    if (running) pool_after(PERIOD_MS, entity_task, e, e->id);
+}
+
+static void report(const char *model, int n, long ticks, Usage a,
+                   Usage b) {
+    double elapsed = (b.ns - a.ns) / 1e9;
+    double ideal = (double)n * 1000 / PERIOD_MS * elapsed;
+    printf("%-7s %5d drones  %9.0f ticks/s (%5.1f%% of ideal)  "
+           "csw %8ld vol %7ld invol  cpu %6.0f ms\n",
+           model, n, ticks / elapsed, 100 * ticks / ideal,
+           b.voluntary - a.voluntary, b.involuntary - a.involuntary,
+           (b.cpu_us - a.cpu_us) / 1e3);
+}
+
+static void bench_ticks(int n, int workers, int seconds) {
+    Entity *es = calloc(n, sizeof(Entity));
+    pthread_t *threads = malloc(n * sizeof(pthread_t));
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 64 * 1024);
+    for (int pooled = 0; pooled < 2; pooled++) {
+        for (int i = 0; i < n; i++) {
+            es[i] = (Entity){.id = i, .tx = i % 40, .ty = i % 30};
+            pthread_mutex_init(&es[i].lock, NULL);
+        }
+        running = 1;
+        if (pooled) start_pool(workers);
+        Usage a = usage_now();
+        int started = 0;
+        for (int i = 0; i < n; i++) {
+            if (pooled) {
+                pool_after(i % PERIOD_MS, entity_task, &es[i], i);
+            } else if (pthread_create(&threads[i], &attr, entity_thread,
+                                      &es[i]) == 0) {
+                started++;
+            }
+        }
+        sleep(seconds);
+        running = 0;
+        Usage b = usage_now();
+        long ticks = 0;
+        for (int i = 0; i < n; i++) {
+            pthread_mutex_lock(&es[i].lock);
+            ticks += es[i].ticks;
+            pthread_mutex_unlock(&es[i].lock);
+        }
+        if (pooled) stop_pool();
+        for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+        if (!pooled && started < n)
+            printf("threads: only %d of %d started\n", started, n);
+        report(pooled ? "pool" : "threads", n, ticks, a, b);
+        for (int i = 0; i < n; i++) pthread_mutex_destroy(&es[i].lock);
+    }
+    pthread_attr_destroy(&attr);
+    free(threads);
+    free(es);
+}
+
+static long done;
+
+static void count_task(void *arg) {
+    (void)arg;
+    __atomic_add_fetch(&done, 1, __ATOMIC_RELEASE);
+}
+
+static void *count_thread(void *arg) {
+    count_task(arg);
+    return NULL;
+}
+
+static void bench_tasks(int workers) {
+    long n = 1000000;
+    start_pool(workers);
+    done = 0;
+    Usage a = usage_now();
+    for (long i = 0; i < n; i++) pool_submit(count_task, NULL, POOL_ANY);
+    while (__atomic_load_n(&done, __ATOMIC_ACQUIRE) < n) usleep(100);
+    Usage b = usage_now();
+    pool_report(stdout);
+    stop_pool();
+    printf("pool    %7ld tasks    %9.0f tasks/s  csw %8ld vol %7ld invol\n",
+           n, n * 1e9 / (b.ns - a.ns), b.voluntary - a.voluntary,
+           b.involuntary - a.involuntary);
+
+    n = 10000;  // a thread per task
+    a = usage_now();
+    for (long i = 0; i < n; i++) {
+        pthread_t t;
+        pthread_create(&t, NULL, count_thread, NULL);
+        pthread_join(t, NULL);
+    }
+    b = usage_now();
+    printf("threads %7ld tasks    %9.0f tasks/s  csw %8ld vol %7ld invol\n",
+           n, n * 1e9 / (b.ns - a.ns), b.voluntary - a.voluntary,
+           b.involuntary - a.involuntary);
+}
+
+int main(int argc, char *argv[]) {
+    int workers = argc > 1 ? atoi(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+    int seconds = argc > 2 ? atoi(argv[2]) : 1;
+    if (workers < 1 || seconds < 1) {
+        fprintf(stderr, "usage: %s [workers] [seconds]\n", argv[0]);
+        return 1;
+    }
+    printf("%d pool workers, a step every %d ms for %d s\n", workers,
+           PERIOD_MS, seconds);
+    int fleets[] = {100, 1000, 2000};  // 2000 threads saturate a core
+    for (int i = 0; i < 3; i++) bench_ticks(fleets[i], workers, seconds);
+    bench_tasks(workers);
+    return 0;
+}
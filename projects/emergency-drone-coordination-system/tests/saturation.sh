@@ -0,0 +1,45 @@
+#!/bin/sh
+# drives server.out past saturation and checks its admission control:
+# a flood of STATUS_UPDATEs against one reactor thread must be shed,
+# drones connecting during the flood must get ERROR 503, and once the
+# flood is over new drones must register again without errors.
+#
+# usage: sh tests/saturation.sh [port=9400]   (after make server loadgen)
+#        KEEP=1 keeps the logs in the temporary directory
+#        IO=uring runs the server on its io_uring backend
+PORT=${1:-9400}
+LOG=$(mktemp -d)
+trap 'kill $SERVER 2>/dev/null; [ -n "$KEEP" ] || rm -rf "$LOG"' EXIT
+
+stdbuf -oL ./server.out --port "$PORT" --threads 1 --shed-lag 5 --reject-lag 20 \
+    --io "${IO:-epoll}" > "$LOG/server" 2>&1 &
+SERVER=$!
+sleep 0.5
+
+# 8000 drones asking for a STATUS_UPDATE every 10 ms
+./loadgen.out --port "$PORT" --drones 4000 --seconds 10 --status-interval 10 \
+    --connect-rate 4000 > "$LOG/flood1" 2>&1 &
+FLOOD1=$!
+./loadgen.out --port "$PORT" --drones 4000 --seconds 10 --status-interval 10 \
+    --connect-rate 4000 --id-base 4000 > "$LOG/flood2" 2>&1 &
+FLOOD2=$!
+sleep 4
+./loadgen.out --port "$PORT" --drones 500 --seconds 3 --connect-rate 500 \
+    --id-base 100000 > "$LOG/during" 2>&1
+wait $FLOOD1 $FLOOD2
+sleep 6  # a stats period, and time for the loop to settle
+./loadgen.out --port "$PORT" --drones 500 --seconds 3 --connect-rate 500 \
+    --id-base 200000 > "$LOG/after" 2>&1
+AFTER=$?
+
+rejected=$(sed -n 's/.*503: \([0-9]*\).*/\1/p' "$LOG/during")
+shed=$(grep "^load:" "$LOG/server" | tail -1 | sed 's/.*shed: \([0-9]*\).*/\1/')
+echo "during the flood: $rejected of 500 new drones got 503"
+echo "server shed $shed STATUS_UPDATEs"
+grep "^load:" "$LOG/server" | tail -1
+echo "after the flood: $(grep '^errors' "$LOG/after")"
+
+[ "${rejected:-0}" -gt 0 ] && [ "${shed:-0}" -gt 0 ] && [ "$AFTER" -eq 0 ] &&
+    kill -0 $SERVER && echo PASS && exit 0
+echo FAIL
+exit 1
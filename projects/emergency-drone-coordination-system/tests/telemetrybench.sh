@@ -0,0 +1,61 @@
+#!/bin/sh
+# STATUS_UPDATEs over TCP (JSON and binary), the UDP telemetry channel
+# and shared memory: the same loadgen fleet, every drone reporting
+# every interval ms, against each. Reports server CPU per 100k updates and
+# how many updates the server took.
+#
+# usage: sh tests/telemetrybench.sh [drones=2000] [seconds=20] [interval=100]
+#        (after make server loadgen)
+DRONES=${1:-2000}
+SECONDS_RUN=${2:-20}
+INTERVAL=${3:-100}
+PORT=${PORT:-9750}
+LOG=$(mktemp -d)
+trap 'kill $SERVER 2>/dev/null; rm -rf "$LOG"' EXIT
+HZ=$(getconf CLK_TCK)
+
+cpu_ticks() {  # utime + stime of pid $1
+    awk '{print $14 + $15}' "/proc/$1/stat"
+}
+
+printf "%-12s %10s %10s %14s %10s\n" transport updates/s taken \
+    "cpu ms/100k" "lost %"
+for transport in json binary udp shm; do
+    case $transport in
+        json) flags="" ;;
+        binary) flags="--binary" ;;
+        udp) flags="--binary --udp" ;;
+        shm) flags="--binary --shm $LOG/shm" ;;
+    esac
+    # no heartbeats or pings: only STATUS_UPDATEs load the server
+    stdbuf -oL ./server.out --port "$PORT" --telemetry $((PORT + 1)) \
+        --shm "$LOG/shm" --max-drones "$DRONES" --heartbeat 3600 --fixed-interval \
+        > "$LOG/server" 2>&1 &
+    SERVER=$!
+    sleep 0.5
+    t0=$(cpu_ticks $SERVER)
+    ./loadgen.out --port "$PORT" --drones "$DRONES" --seconds "$SECONDS_RUN" \
+        --status-interval "$INTERVAL" --ping-interval 0 --connect-rate 2000 \
+        $flags > "$LOG/client" 2>&1
+    t1=$(cpu_ticks $SERVER)
+    sleep 5.5  # one more stats line with the final counts
+    kill -INT $SERVER
+    wait $SERVER 2>/dev/null
+
+    # taken: UDP updates the server handed on; TCP ones all arrive, but
+    # the server may shed some
+    taken=$(awk -v t="$transport" -v sent="$(awk '/^status/ { print $2 }' \
+        "$LOG/client")" '
+        /^telemetry:/ { udp = $8 }
+        /^load:/ { split($0, f, "shed: "); shed = f[2] + 0 }
+        END { print t == "udp" ? udp : sent - shed }' "$LOG/server")
+    awk -v t="$transport" -v hz="$HZ" -v cpu=$((t1 - t0)) -v taken="$taken" \
+        -v secs="$SECONDS_RUN" '
+        /^status/ { updates = $2 }
+        END {
+            printf "%-12s %10.0f %10d %14.1f %10.2f\n", t, updates / secs,
+                   taken, taken ? cpu * 1000 / hz / (taken / 100000) : 0,
+                   updates ? 100 * (updates - taken) / updates : 0
+        }' "$LOG/client"
+    PORT=$((PORT + 2))
+done
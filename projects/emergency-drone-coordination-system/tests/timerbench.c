@@ -0,0 +1,87 @@
+/* heartbeat deadlines of many drones on the timer wheel (timer.c).
+ * Every drone re-arms its timer each heartbeat interval, as the server
+ * does, and every timer must fire exactly on its tick. The same
+ * schedule driven by a scan over all drones per tick is timed for
+ * comparison.
+ *
+ * usage: timerbench [drones=100000] [seconds=600]
+ */
+#include "../headers/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define TICK_MS 100
+#define INTERVAL (10000 / TICK_MS)  // 10 s heartbeat
+
+static double now_s() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long late;  // timers that did not fire on their tick
+
+static void fire(Timer *t, void *arg) {
+    TimerWheel *w = arg;
+    if (t->expires != w->now) late++;
+    timer_add(w, t, w->now + INTERVAL);
+}
+
+int main(int argc, char *argv[]) {
+    int n = argc > 1 ? atoi(argv[1]) : 100000;
+    long ticks = (argc > 2 ? atol(argv[2]) : 600) * 1000 / TICK_MS;
+
+    static TimerWheel w;
+    Timer *timers = calloc(n, sizeof(Timer));
+    wheel_init(&w, 0);
+    double t0 = now_s();
+    for (int i = 0; i < n; i++) timer_add(&w, &timers[i], 1 + rand() % INTERVAL);
+    double t1 = now_s();
+
+    long fired = 0;
+    for (long tick = 1; tick <= ticks; tick++)
+        fired += wheel_advance(&w, tick, fire, &w);
+    double t2 = now_s();
+
+    // the same deadlines kept in an array and scanned every tick
+    unsigned long *deadline = malloc(n * sizeof(unsigned long));
+    for (int i = 0; i < n; i++) deadline[i] = 1 + rand() % INTERVAL;
+    long scanned = 0;
+    double t3 = now_s();
+    for (long tick = 1; tick <= ticks; tick++) {
+        for (int i = 0; i < n; i++) {
+            if (deadline[i] == (unsigned long)tick) {
+                deadline[i] = tick + INTERVAL;
+                scanned++;
+            }
+        }
+    }
+    double t4 = now_s();
+
+    // an idle wheel: nothing due for a long time
+    static TimerWheel idle;
+    Timer far = {0};
+    wheel_init(&idle, 0);
+    timer_add(&idle, &far, 1UL << 30);
+    double t5 = now_s();
+    for (long tick = 1; tick <= ticks; tick++)
+        wheel_advance(&idle, tick, fire, &idle);
+    double t6 = now_s();
+
+    printf("%d drones, %ld ticks of %d ms (%ld s simulated)\n", n, ticks,
+           TICK_MS, ticks * TICK_MS / 1000);
+    printf("schedule:      %6.1f ns/timer\n", (t1 - t0) * 1e9 / n);
+    printf("timer wheel:   %ld fired, %ld late, %6.1f ns/fire, "
+           "%.3f%% of one core\n",
+           fired, late, (t2 - t1) * 1e9 / fired,
+           100 * (t2 - t1) / (ticks * TICK_MS / 1000.0));
+    printf("full scan:     %ld fired, %6.1f ns/fire, %.3f%% of one core\n",
+           scanned, (t4 - t3) * 1e9 / scanned,
+           100 * (t4 - t3) / (ticks * TICK_MS / 1000.0));
+    printf("idle wheel:    %6.1f ns/tick\n", (t6 - t5) * 1e9 / ticks);
+    free(timers);
+    free(deadline);
+    return late != 0 || fired != scanned;
+}
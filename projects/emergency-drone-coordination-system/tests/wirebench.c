@@ -0,0 +1,94 @@
+/* encode/decode cost per message of the JSON and the binary encoding
+ * for the messages sent most often.
+ *
+ * usage: wirebench [iterations=1000000]
+ */
+#include "../headers/protocol.h"
+#include "../headers/wire.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench(const char *name, const Message *m, int iterations) {
+    char json[MAX_MESSAGE];
+    unsigned char bin[MAX_MESSAGE];
+    Message out;
+    long sink = 0;
+    int json_len = 0, bin_len = 0;
+
+    double t0 = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        json_len = format_message(json, sizeof(json), m);
+        sink += json[json_len - 2];
+    }
+    double t1 = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        parse_message(json, json_len - 1, &out);  // without '\n'
+        sink += out.location.x + out.target.y;
+    }
+    double t2 = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        bin_len = encode_binary(m, bin, sizeof(bin));
+        sink += bin[bin_len - 1];
+    }
+    double t3 = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        decode_binary(bin + WIRE_HEADER, bin_len - WIRE_HEADER, &out);
+        sink += out.location.x + out.target.y;
+    }
+    double t4 = now_ns();
+
+    printf("%-15s json   %4d B  encode %7.1f ns  decode %7.1f ns\n", name,
+           json_len, (t1 - t0) / iterations, (t2 - t1) / iterations);
+    printf("%-15s binary %4d B  encode %7.1f ns  decode %7.1f ns\n", "",
+           bin_len, (t3 - t2) / iterations, (t4 - t3) / iterations);
+    if (sink == 42) printf("\n");  // keeps the loops from being dropped
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    Message status = {.type = MSG_STATUS_UPDATE,
+                      .drone_id = "D1234",
+                      .timestamp = time(NULL),
+                      .location = {17, 23},
+                      .status = "idle",
+                      .battery = 87,
+                      .speed = 10};
+    Message mission = {.type = MSG_ASSIGN_MISSION,
+                       .mission_id = "M5678",
+                       .priority = "medium",
+                       .target = {31, 4},
+                       .expiry = time(NULL) + 600};
+    Message heartbeat = {.type = MSG_HEARTBEAT, .timestamp = time(NULL)};
+
+    // round trip check before timing
+    Message *all[] = {&status, &mission, &heartbeat};
+    for (int i = 0; i < 3; i++) {
+        unsigned char bin[MAX_MESSAGE];
+        Message out;
+        int len = encode_binary(all[i], bin, sizeof(bin));
+        if (len < 0 || decode_binary(bin + WIRE_HEADER, len - WIRE_HEADER,
+                                     &out) != 0 ||
+            out.type != all[i]->type || out.location.x != all[i]->location.x ||
+            out.target.y != all[i]->target.y ||
+            out.expiry != all[i]->expiry) {
+            printf("round trip of message %d failed\n", i);
+            return 1;
+        }
+    }
+
+    printf("%d iterations per row\n", iterations);
+    bench("STATUS_UPDATE", &status, iterations);
+    bench("ASSIGN_MISSION", &mission, iterations);
+    bench("HEARTBEAT", &heartbeat, iterations);
+    return 0;
+}
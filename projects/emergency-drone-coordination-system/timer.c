@@ -0,0 +1,135 @@
+/**
+ * @file timer.c
+ * @brief hierarchical timer wheel for per-connection deadlines
+ * (heartbeats), see timer.h.
+ *
+ * A timer due in less than WHEEL_SIZE ticks sits in level 0 at slot
+ * expires % WHEEL_SIZE and fires when the wheel reaches that slot. A
+ * later timer sits in the level whose slot width covers the delay;
+ * whenever level 0 wraps around, the next slot of level 1 is emptied
+ * and its timers are added again, now landing in level 0 (and likewise
+ * for higher levels). Only timers that are due or being cascaded are
+ * ever touched, so 100k idle heartbeats cost nothing between ticks.
+ */
+#include "headers/timer.h"
+
+#include <stddef.h>
+
+static void list_init(Timer *head) {
+    head->next = head->prev = head;
+}
+
+static void list_add(Timer *head, Timer *t) {
+    t->prev = head->prev;
+    t->next = head;
+    head->prev->next = t;
+    head->prev = t;
+}
+
+static void list_unlink(Timer *t) {
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = t->prev = NULL;
+}
+
+void wheel_init(TimerWheel *w, unsigned long now) {
+    w->now = now;
+    w->count = 0;
+    for (int l = 0; l < WHEEL_LEVELS; l++)
+        for (int s = 0; s < WHEEL_SIZE; s++) list_init(&w->slots[l][s]);
+}
+
+int timer_pending(const Timer *t) {
+    return t->next != NULL;
+}
+
+/* puts t into the slot for its expiry, t->expires >= w->now. While
+ * cascading, expires == now lands in the level 0 slot handled next. */
+static void place(TimerWheel *w, Timer *t) {
+    unsigned long expires = t->expires;
+    unsigned long delta = expires - w->now;
+
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 &&
+           delta >= 1UL << (WHEEL_BITS * (level + 1)))
+        level++;
+    if (delta >= 1UL << (WHEEL_BITS * WHEEL_LEVELS))  // beyond the wheel
+        expires = w->now + (1UL << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+
+    int slot = (expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    list_add(&w->slots[level][slot], t);
+}
+
+/**
+ * @brief schedules t at absolute tick expires (re-arms a pending t);
+ * a tick that has already passed fires on the next one
+ */
+void timer_add(TimerWheel *w, Timer *t, unsigned long expires) {
+    if (timer_pending(t)) list_unlink(t);
+    else w->count++;
+    if ((long)(expires - w->now) <= 0) expires = w->now + 1;
+    t->expires = expires;
+    place(w, t);
+}
+
+void timer_del(TimerWheel *w, Timer *t) {
+    if (!timer_pending(t)) return;
+    list_unlink(t);
+    w->count--;
+}
+
+/* re-places the timers of one higher-level slot */
+static void cascade(TimerWheel *w, int level) {
+    int slot = (w->now >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    Timer *head = &w->slots[level][slot];
+    Timer pending;
+    if (head->next == head) return;
+
+    // take the whole list first, place() may put timers back here
+    pending.next = head->next;
+    pending.prev = head->prev;
+    pending.next->prev = pending.prev->next = &pending;
+    list_init(head);
+    while (pending.next != &pending) {
+        Timer *t = pending.next;
+        list_unlink(t);
+        place(w, t);
+    }
+}
+
+/**
+ * @brief processes every tick up to now and calls fire for each timer
+ * that expired. fire may add or delete any timer, including t.
+ * @return long: timers fired
+ */
+long wheel_advance(TimerWheel *w, unsigned long now,
+                   void (*fire)(Timer *t, void *arg), void *arg) {
+    long fired = 0;
+    if (w->count == 0) {  // nothing to cascade or fire
+        if ((long)(now - w->now) > 0) w->now = now;
+        return 0;
+    }
+    while ((long)(now - w->now) > 0) {
+        w->now++;
+        for (int l = 1; l < WHEEL_LEVELS; l++) {
+            if ((w->now >> (WHEEL_BITS * (l - 1))) & WHEEL_MASK) break;
+            cascade(w, l);
+        }
+
+        Timer *head = &w->slots[0][w->now & WHEEL_MASK];
+        Timer due;
+        if (head->next == head) continue;
+        due.next = head->next;
+        due.prev = head->prev;
+        due.next->prev = due.prev->next = &due;
+        list_init(head);
+        while (due.next != &due) {
+            Timer *t = due.next;
+            list_unlink(t);
+            w->count--;
+            fire(t, arg);
+            fired++;
+        }
+    }
+    return fired;
+}
@@ -0,0 +1,158 @@
+/**
+ * @file trace.c
+ * @brief per-thread trace buffers and Chrome trace-event export.
+ *
+ * A thread appends events to its own buffer, allocated on its first
+ * event and pushed onto a list that is never popped, like the metrics
+ * shards. The buffer has one writer: it fills the event, then
+ * publishes the new count with a release store, so trace_write() can
+ * read a running thread's events up to the count it loads. A full
+ * buffer drops further events and counts them.
+ *
+ * Output is the JSON object format: "X" events for spans, "i" for
+ * instants, "b"/"e" async events for the lifecycle of a mission (one
+ * track per mission id, so its waiting and flight slices line up
+ * whichever threads recorded them) and "M" events for thread names.
+ */
+#include "headers/trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define TRACE_EVENTS 32768  // per thread, 1 MB
+
+typedef struct trace_event {
+    const char *name;
+    long ts, dur;  // ns since trace_start()
+    long arg;      // span and instant argument, async id
+    char phase;
+} TraceEvent;
+
+typedef struct trace_buffer {
+    struct trace_buffer *next;
+    int tid;
+    const char *name;
+    int count;
+    long dropped;
+    TraceEvent events[TRACE_EVENTS];
+} TraceBuffer;
+
+int trace_enabled = 0;
+static long epoch;
+static TraceBuffer *buffers;
+static int next_tid;
+static __thread TraceBuffer *mine;
+static __thread const char *pending_name;  // named before the first event
+
+long trace_clock() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec - epoch;
+}
+
+static TraceBuffer *buffer() {
+    if (mine) return mine;
+    TraceBuffer *b = calloc(1, sizeof(TraceBuffer));
+    if (!b) return NULL;
+    b->tid = __atomic_add_fetch(&next_tid, 1, __ATOMIC_RELAXED);
+    b->name = pending_name;
+    b->next = __atomic_load_n(&buffers, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&buffers, &b->next, b, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+    return mine = b;
+}
+
+static void record(const char *name, char phase, long ts, long dur,
+                   long arg) {
+    if (!__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED)) return;
+    TraceBuffer *b = buffer();
+    if (!b) return;
+    if (b->count == TRACE_EVENTS) {
+        b->dropped++;
+        return;
+    }
+    b->events[b->count] = (TraceEvent){name, ts, dur, arg, phase};
+    __atomic_store_n(&b->count, b->count + 1, __ATOMIC_RELEASE);
+}
+
+void trace_span(const char *name, long start, long arg) {
+    if (!start) return;  // tracing was off when it began
+    long now = trace_clock();
+    record(name, 'X', start, now - start, arg);
+}
+
+void trace_instant(const char *name, long arg) {
+    record(name, 'i', trace_clock(), 0, arg);
+}
+
+void trace_async(const char *name, char phase, long id) {
+    record(name, phase, trace_clock(), 0, id);
+}
+
+/* names the calling thread in the trace, e.g. "ai" */
+void trace_thread_name(const char *name) {
+    if (mine) mine->name = name;
+    else pending_name = name;
+}
+
+/**
+ * @brief starts recording; timestamps count from here
+ */
+void trace_start() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    epoch = ts.tv_sec * 1000000000L + ts.tv_nsec - 1;  // trace_now() > 0
+    __atomic_store_n(&trace_enabled, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief writes every event recorded so far to path as a Chrome trace
+ * @return int: 0, -1 if path cannot be written
+ */
+int trace_write(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        perror(path);
+        return -1;
+    }
+    long events = 0, dropped = 0;
+    fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    const char *sep = "";
+    for (TraceBuffer *b = __atomic_load_n(&buffers, __ATOMIC_ACQUIRE); b;
+         b = b->next) {
+        int pid = 1, count = __atomic_load_n(&b->count, __ATOMIC_ACQUIRE);
+        if (b->name) {
+            fprintf(out, "%s{\"ph\": \"M\", \"name\": \"thread_name\", "
+                    "\"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                    sep, pid, b->tid, b->name);
+            sep = ",\n";
+        }
+        for (int i = 0; i < count; i++, sep = ",\n") {
+            TraceEvent *e = &b->events[i];
+            fprintf(out, "%s{\"ph\": \"%c\", \"name\": \"%s\", \"cat\": "
+                    "\"drones\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f",
+                    sep, e->phase, e->name, pid, b->tid, e->ts / 1e3);
+            switch (e->phase) {
+                case 'X':
+                    fprintf(out, ", \"dur\": %.3f, \"args\": {\"id\": %ld}}",
+                            e->dur / 1e3, e->arg);
+                    break;
+                case 'i':
+                    fprintf(out, ", \"s\": \"t\", \"args\": {\"id\": %ld}}",
+                            e->arg);
+                    break;
+                default:  // async: the id groups the slices of one mission
+                    fprintf(out, ", \"id\": %ld}", e->arg);
+            }
+        }
+        events += count;
+        dropped += b->dropped;
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    printf("trace: %ld events to %s, %ld dropped on full buffers\n", events,
+           path, dropped);
+    return 0;
+}
@@ -0,0 +1,415 @@
+/**
+ * @file uring.c
+ * @brief io_uring event loop for the drone server, the alternative to
+ * the epoll loop of reactor.c (server --io uring).
+ *
+ * Each reactor owns one ring, set up with the raw system calls. The
+ * listener has a multishot ACCEPT and every connection one multishot
+ * RECV that takes its buffers from a ring of provided buffers, so once
+ * armed neither costs a system call per event. Replies queued during a
+ * turn leave as one SEND per connection (its first OutBlock), and all
+ * SQEs of a turn are submitted by the io_uring_enter() that also waits
+ * for the next completions: an iteration of the loop is one system call
+ * however many connections it serves.
+ *
+ * A request carries its Conn (or Reactor) in user_data with the kind of
+ * request in the low bits. The fd of a closed connection stays open
+ * until its last request completed (Conn.io_ops), so the number cannot
+ * be reused while a completion for it is still on the way.
+ *
+ * Needs Linux 6.0 for multishot RECV; uring_setup() tries one first, as
+ * on 5.19 the ring and its buffers work but every such RECV fails with
+ * EINVAL, and the server then uses epoll. Sockets and the wake eventfd are
+ * blocking: io_uring waits for them itself and would otherwise hand
+ * back EAGAIN.
+ */
+#include "headers/uring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "headers/globals.h"
+#include "headers/trace.h"
+
+#define RING_SQ 4096      // SQEs per turn before an extra submit
+#define RING_CQ 65536     // completions: a SEND and a RECV per connection
+#define RING_BUFS 4096    // provided buffers, a power of 2
+#define RING_BUF_SIZE 2048
+#define BUF_GROUP 0
+
+// user_data = pointer | kind
+enum { OP_ACCEPT = 1, OP_WAKE, OP_RECV, OP_SEND, OP_CANCEL };
+#define OP_MASK 7
+
+// Conn.io_ops
+#define IO_RECV 1
+#define IO_SEND 2
+
+typedef struct ring {
+    int fd;
+    void *mem;                  // SQ and CQ ring, one mapping
+    size_t mem_len;
+    struct io_uring_sqe *sqes;
+    size_t sqes_len;
+    unsigned *sq_head, *sq_tail, sq_mask, sq_entries;
+    unsigned sq_local;          // tail including SQEs not yet published
+    unsigned *cq_head, *cq_tail, cq_mask;
+    struct io_uring_cqe *cqes;
+    struct io_uring_buf_ring *bufs;
+    char *buf_mem;
+    unsigned short buf_tail;    // provided buffers handed back so far
+    uint64_t wake_count;        // eventfd read target
+    int accept_armed;
+    long accept_retry;          // µs, after an accept error
+} Ring;
+
+static long now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+/* submits the SQEs queued so far and, with wait, blocks until one
+ * completion or timeout_ms */
+static void ring_enter(Reactor *r, Ring *q, int wait, int timeout_ms) {
+    __atomic_store_n(q->sq_tail, q->sq_local, __ATOMIC_RELEASE);
+    unsigned submit = q->sq_local - __atomic_load_n(q->sq_head,
+                                                    __ATOMIC_ACQUIRE);
+    struct __kernel_timespec ts = {.tv_sec = timeout_ms / 1000,
+                                   .tv_nsec = timeout_ms % 1000 * 1000000L};
+    struct io_uring_getevents_arg arg = {.ts = (uint64_t)(uintptr_t)&ts};
+    syscall(__NR_io_uring_enter, q->fd, submit, wait ? 1 : 0,
+            IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    r->syscalls++;
+}
+
+/* the next free SQE, zeroed; submits first when the SQ is full */
+static struct io_uring_sqe *get_sqe(Reactor *r, Ring *q) {
+    while (q->sq_local - __atomic_load_n(q->sq_head, __ATOMIC_ACQUIRE) ==
+           q->sq_entries)
+        ring_enter(r, q, 0, 0);
+    struct io_uring_sqe *sqe = &q->sqes[q->sq_local++ & q->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+/* hands buffer bid back to the kernel; published once per turn */
+static void recycle(Ring *q, int bid) {
+    struct io_uring_buf *b = &q->bufs->bufs[q->buf_tail & (RING_BUFS - 1)];
+    b->addr = (uint64_t)(uintptr_t)(q->buf_mem + (size_t)bid * RING_BUF_SIZE);
+    b->len = RING_BUF_SIZE;
+    b->bid = bid;
+    q->buf_tail++;
+}
+
+static void arm_accept(Reactor *r, Ring *q) {
+    struct io_uring_sqe *sqe = get_sqe(r, q);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = r->listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = (uintptr_t)r | OP_ACCEPT;
+    q->accept_armed = 1;
+}
+
+static void arm_wake(Reactor *r, Ring *q) {
+    struct io_uring_sqe *sqe = get_sqe(r, q);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = r->wake_fd;
+    sqe->addr = (uintptr_t)&q->wake_count;
+    sqe->len = sizeof(q->wake_count);
+    sqe->user_data = (uintptr_t)r | OP_WAKE;
+}
+
+static void arm_recv(Reactor *r, Conn *c) {
+    struct io_uring_sqe *sqe = get_sqe(r, r->ring);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = c->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUF_GROUP;
+    sqe->user_data = (uintptr_t)c | OP_RECV;
+    c->io_ops |= IO_RECV;
+}
+
+/**
+ * @brief starts a SEND of c's first queued block unless one is in
+ * flight; its completion starts the next. Caller holds c->wlock.
+ */
+void uring_send(Reactor *r, Conn *c) {
+    OutBlock *b = c->out.head;
+    if ((c->io_ops & IO_SEND) || !b) return;
+    struct io_uring_sqe *sqe = get_sqe(r, r->ring);
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = c->fd;
+    // outq_push() only appends, so these bytes stay put until consumed
+    sqe->addr = (uintptr_t)(b->data + b->start);
+    sqe->len = b->end - b->start;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uintptr_t)c | OP_SEND;
+    c->io_ops |= IO_SEND;
+    c->out.writes++;
+}
+
+/**
+ * @brief backend part of conn_close_now(): cancels the RECV and sends
+ * what is still queued. Caller holds c->wlock; the fd is closed once
+ * c->io_ops is 0.
+ */
+void uring_close(Reactor *r, Conn *c) {
+    if (c->io_ops & IO_RECV) {
+        struct io_uring_sqe *sqe = get_sqe(r, r->ring);
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = (uintptr_t)c | OP_RECV;
+        sqe->user_data = OP_CANCEL;  // no Conn: c may be gone by then
+    }
+    uring_send(r, c);
+}
+
+/* a request of closed c completed: close and free it after the last */
+static void io_done(Conn *c) {
+    if (!c->closed || c->io_ops) return;
+    close(c->fd);
+    conn_release(c);
+}
+
+static void on_accept(Reactor *r, Ring *q, struct io_uring_cqe *cqe) {
+    if (cqe->res >= 0) {
+        Conn *c = conn_open(r, cqe->res);
+        if (c) arm_recv(r, c);
+        else close(cqe->res);
+    } else if (cqe->res != -EINTR && cqe->res != -ECONNABORTED) {
+        fprintf(stderr, "accept: %s\n", strerror(-cqe->res));  // e.g. EMFILE
+    }
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        // an error ends the multishot ACCEPT: retry a tick later
+        q->accept_armed = 0;
+        q->accept_retry = now_us() + TIMER_TICK_MS * 1000;
+    }
+}
+
+static void on_recv(Reactor *r, Ring *q, Conn *c, struct io_uring_cqe *cqe) {
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        if (cqe->res > 0 && !c->closed &&
+            conn_input(r, c, q->buf_mem + (size_t)bid * RING_BUF_SIZE,
+                       cqe->res) != 0)
+            conn_close_now(r, c);
+        recycle(q, bid);
+    }
+    if (cqe->flags & IORING_CQE_F_MORE) return;
+    c->io_ops &= ~IO_RECV;
+    if (c->closed) io_done(c);
+    // out of buffers (or the multishot just ended): arm it again
+    else if (cqe->res > 0 || cqe->res == -ENOBUFS) arm_recv(r, c);
+    else conn_close_now(r, c);  // 0: peer or conn_close() shut it
+}
+
+static void on_send(Reactor *r, Conn *c, struct io_uring_cqe *cqe) {
+    pthread_mutex_lock(&c->wlock);
+    c->io_ops &= ~IO_SEND;
+    if (cqe->res > 0) {
+        outq_consume(&c->out, cqe->res);
+        uring_send(r, c);  // the rest, also after close (best effort)
+    } else if (!c->closed) {
+        shutdown(c->fd, SHUT_RDWR);  // the RECV ends and closes it
+    }
+    pthread_mutex_unlock(&c->wlock);
+    io_done(c);
+}
+
+static void complete(Reactor *r, Ring *q, struct io_uring_cqe *cqe) {
+    void *ptr = (void *)(uintptr_t)(cqe->user_data & ~(uint64_t)OP_MASK);
+    switch (cqe->user_data & OP_MASK) {
+        case OP_ACCEPT: on_accept(r, q, cqe); break;
+        case OP_WAKE:
+            reactor_take_pending(r);
+            if (running) arm_wake(r, q);
+            break;
+        case OP_RECV: on_recv(r, q, ptr, cqe); break;
+        case OP_SEND: on_send(r, ptr, cqe); break;
+        default: break;  // OP_CANCEL
+    }
+}
+
+void *uring_loop(void *arg) {
+    Reactor *r = arg;
+    Ring *q = r->ring;
+    trace_thread_name("reactor");
+    arm_accept(r, q);
+    arm_wake(r, q);
+    long backlog_from = 0;  // start of the turns the CQ was not empty after
+
+    while (running) {
+        if (!q->accept_armed && now_us() >= q->accept_retry)
+            arm_accept(r, q);
+        unsigned head = *q->cq_head;
+        int idle = head == __atomic_load_n(q->cq_tail, __ATOMIC_ACQUIRE);
+        if (idle || q->sq_local != *q->sq_tail)
+            ring_enter(r, q, idle, r->wheel.count ? TIMER_TICK_MS : 200);
+        long busy_from = now_us();
+
+        // at most an epoll_wait() batch, so timers and flushes keep up
+        unsigned tail = __atomic_load_n(q->cq_tail, __ATOMIC_ACQUIRE);
+        if (tail - head > MAX_EVENTS) tail = head + MAX_EVENTS;
+        for (; head != tail; head++) {
+            complete(r, q, &q->cqes[head & q->cq_mask]);
+            // frees the CQ slot right away, for SQEs submitted meanwhile
+            __atomic_store_n(q->cq_head, head + 1, __ATOMIC_RELEASE);
+        }
+        __atomic_store_n(&q->bufs->tail, q->buf_tail, __ATOMIC_RELEASE);
+
+        // with completions left over, one arriving now waits for all of
+        // them: the lag runs from the first turn of the backlog. A drained
+        // backlog no longer delays anyone; left in the average a long one
+        // would keep new drones out for many idle turns.
+        int behind = head != __atomic_load_n(q->cq_tail, __ATOMIC_ACQUIRE);
+        if (behind && !backlog_from) backlog_from = busy_from;
+        reactor_end_turn(r, behind ? backlog_from : busy_from,
+                         backlog_from && !behind);
+        if (!behind) backlog_from = 0;
+    }
+    return NULL;
+}
+
+/* a multishot RECV of one byte and EOF on a socketpair
+ * @return int: 0 if it works, -1 with errno set if it does not */
+static int probe_recv(Reactor *r, Ring *q) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) return -1;
+    int rc = -1, done = 0;
+    errno = ETIMEDOUT;
+    if (write(sv[1], "", 1) == 1 && shutdown(sv[1], SHUT_WR) == 0) {
+        struct io_uring_sqe *sqe = get_sqe(r, q);
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = sv[0];
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUF_GROUP;
+        sqe->user_data = OP_CANCEL;  // nothing to do on completion
+        // the byte, then the end of the multishot at EOF
+        for (int turn = 0; turn < 3 && !done; turn++) {
+            ring_enter(r, q, 1, 1000);
+            unsigned head = *q->cq_head;
+            unsigned tail = __atomic_load_n(q->cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail && !done; head++) {
+                struct io_uring_cqe *cqe = &q->cqes[head & q->cq_mask];
+                if (cqe->flags & IORING_CQE_F_BUFFER)
+                    recycle(q, cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+                if (cqe->res < 0) {
+                    errno = -cqe->res;  // EINVAL before Linux 6.0
+                    done = 1;
+                } else if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                    rc = 0;
+                    done = 1;
+                }
+            }
+            __atomic_store_n(q->cq_head, head, __ATOMIC_RELEASE);
+        }
+        __atomic_store_n(&q->bufs->tail, q->buf_tail, __ATOMIC_RELEASE);
+    }
+    int err = errno;
+    close(sv[0]);
+    close(sv[1]);
+    errno = err;
+    return rc;
+}
+
+static int clear_nonblock(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+}
+
+/**
+ * @brief creates r's ring and registers its provided buffers
+ * @return int: 0, -1 with errno set if io_uring is not available
+ */
+int uring_setup(Reactor *r) {
+    Ring *q = calloc(1, sizeof(Ring));
+    if (!q) return -1;
+    r->ring = q;
+    struct io_uring_params p = {
+        .flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN,
+        .cq_entries = RING_CQ};
+    q->fd = syscall(__NR_io_uring_setup, RING_SQ, &p);
+    if (q->fd < 0 && errno == EINVAL) {  // before 5.19: no COOP_TASKRUN
+        p.flags &= ~IORING_SETUP_COOP_TASKRUN;
+        q->fd = syscall(__NR_io_uring_setup, RING_SQ, &p);
+    }
+    if (q->fd < 0) goto fail;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) ||
+        !(p.features & IORING_FEAT_EXT_ARG)) {
+        errno = ENOSYS;
+        goto fail;
+    }
+
+    size_t sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    q->mem_len = sq_len > cq_len ? sq_len : cq_len;
+    q->mem = mmap(NULL, q->mem_len, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, q->fd, IORING_OFF_SQ_RING);
+    q->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    q->sqes = mmap(NULL, q->sqes_len, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, q->fd, IORING_OFF_SQES);
+    if (q->mem == MAP_FAILED || q->sqes == MAP_FAILED) goto fail;
+    char *mem = q->mem;
+    q->sq_head = (unsigned *)(mem + p.sq_off.head);
+    q->sq_tail = (unsigned *)(mem + p.sq_off.tail);
+    q->sq_mask = *(unsigned *)(mem + p.sq_off.ring_mask);
+    q->sq_entries = p.sq_entries;
+    q->sq_local = *q->sq_tail;
+    unsigned *array = (unsigned *)(mem + p.sq_off.array);
+    for (unsigned i = 0; i < p.sq_entries; i++) array[i] = i;  // SQE i
+    q->cq_head = (unsigned *)(mem + p.cq_off.head);
+    q->cq_tail = (unsigned *)(mem + p.cq_off.tail);
+    q->cq_mask = *(unsigned *)(mem + p.cq_off.ring_mask);
+    q->cqes = (struct io_uring_cqe *)(mem + p.cq_off.cqes);
+
+    // the buffer ring must be page aligned
+    q->bufs = mmap(NULL, RING_BUFS * sizeof(struct io_uring_buf),
+                   PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    q->buf_mem = malloc((size_t)RING_BUFS * RING_BUF_SIZE);
+    if (q->bufs == MAP_FAILED || !q->buf_mem) goto fail;
+    struct io_uring_buf_reg reg = {.ring_addr = (uintptr_t)q->bufs,
+                                   .ring_entries = RING_BUFS,
+                                   .bgid = BUF_GROUP};
+    if (syscall(__NR_io_uring_register, q->fd, IORING_REGISTER_PBUF_RING,
+                &reg, 1) < 0)
+        goto fail;
+    for (int bid = 0; bid < RING_BUFS; bid++) recycle(q, bid);
+    __atomic_store_n(&q->bufs->tail, q->buf_tail, __ATOMIC_RELEASE);
+    if (probe_recv(r, q) != 0) goto fail;
+
+    if (clear_nonblock(r->listen_fd) != 0 || clear_nonblock(r->wake_fd) != 0)
+        goto fail;
+    return 0;
+
+fail: {
+        int err = errno;
+        uring_free(r);
+        errno = err;
+        return -1;
+    }
+}
+
+void uring_free(Reactor *r) {
+    Ring *q = r->ring;
+    if (!q) return;
+    if (q->fd > 0) close(q->fd);
+    if (q->mem && q->mem != MAP_FAILED) munmap(q->mem, q->mem_len);
+    if (q->sqes && q->sqes != MAP_FAILED) munmap(q->sqes, q->sqes_len);
+    if (q->bufs && q->bufs != MAP_FAILED)
+        munmap(q->bufs, RING_BUFS * sizeof(struct io_uring_buf));
+    free(q->buf_mem);
+    free(q);
+    r->ring = NULL;
+}
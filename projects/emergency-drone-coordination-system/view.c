@@ -1,17 +1,56 @@
-// #include "headers/view.h"
+#include "headers/view.h"
+
 #include <SDL2/SDL.h>
+#include <stdlib.h>
 
 #include "headers/drone.h"
-#include "headers/map.h"
-#include "headers/survivor.h"
+#include "headers/snapshot.h"
 
-#define CELL_SIZE 20  // Pixels per map cell
+#define CELL_SIZE 20     // Max pixels per map cell
+#define MIN_GRID_CELL 4  // No grid lines below this cell size
 
 // SDL globals
 SDL_Window* window = NULL;
 SDL_Renderer* renderer = NULL;
 SDL_Event event;
 int window_width, window_height;
+static int map_height, map_width;  // in cells
+int cell_size = CELL_SIZE;  // Shrinks so large maps fit the display
+
+/* Survivor cells are kept in map_texture and only the cells listed
+ * as dirty in the snapshot are repainted each frame; the grid never
+ * changes, so it is drawn once into grid_texture. A frame is then two
+ * texture copies plus the drones, whatever the map size.
+ * The view reads the world only through latest_snapshot(), it never
+ * takes a simulation lock. */
+SDL_Texture* map_texture = NULL;
+SDL_Texture* grid_texture = NULL;
+static unsigned long drawn_seq = 0;  // snapshot seq map_texture shows
+static int full_redraw = 1;      // repaint every cell (first frame, reset)
+static int grid_ready = 0;
+
+/* Draw calls are batched per color: cells are collected into rect
+ * arrays and submitted with one SDL_RenderFillRects, mission lines
+ * are collected into one triangle list. */
+#define LOD_CELL_SIZE 3  // Level of detail mode at or below this size
+
+typedef struct rectbatch {
+    SDL_Rect *rects;
+    SDL_Point *points;  // cell centers, used in level of detail mode
+    int count;
+    int capacity;
+} RectBatch;
+
+typedef struct linebatch {
+    SDL_Vertex *vertices;  // 4 per line (a thin quad)
+    int *indices;          // 6 per line (two triangles)
+    int count;             // number of lines
+    int capacity;          // in lines
+} LineBatch;
+
+static RectBatch red_cells, black_cells, idle_drones, busy_drones;
+static LineBatch mission_lines;
+int lod_mode = 0;  // toggled with 'l', forced on for tiny cells
 
 // Colors
 const SDL_Color BLACK = {0, 0, 0, 255};
@@ -20,15 +59,27 @@ const SDL_Color BLUE = {0, 0, 255, 255};
 const SDL_Color GREEN = {0, 255, 0, 255};
 const SDL_Color WHITE = {255, 255, 255, 255};
 
-int init_sdl_window() {
-    window_width = map.width * CELL_SIZE;
-    window_height = map.height * CELL_SIZE;
+int init_sdl_window(int height, int width) {
+    map_height = height;
+    map_width = width;
 
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
         fprintf(stderr, "SDL_Init Error: %s\n", SDL_GetError());
         return 1;
     }
 
+    // Fit the map into 90% of the desktop
+    SDL_DisplayMode dm;
+    if (SDL_GetDesktopDisplayMode(0, &dm) == 0) {
+        int fit_w = dm.w * 9 / 10 / map_width;
+        int fit_h = dm.h * 9 / 10 / map_height;
+        if (fit_w < cell_size) cell_size = fit_w;
+        if (fit_h < cell_size) cell_size = fit_h;
+        if (cell_size < 1) cell_size = 1;
+    }
+    window_width = map_width * cell_size;
+    window_height = map_height * cell_size;
+
     window =
         SDL_CreateWindow("Drone Simulator", SDL_WINDOWPOS_CENTERED,
                          SDL_WINDOWPOS_CENTERED, window_width,
@@ -40,8 +91,8 @@ int init_sdl_window() {
         return 1;
     }
 
-    renderer =
-        SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    renderer = SDL_CreateRenderer(
+        window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE);
     if (!renderer) {
         SDL_DestroyWindow(window);
         fprintf(stderr, "SDL_CreateRenderer Error: %s\n",
@@ -50,74 +101,197 @@ int init_sdl_window() {
         return 1;
     }
 
+    map_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+                                    SDL_TEXTUREACCESS_TARGET,
+                                    window_width, window_height);
+    grid_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+                                     SDL_TEXTUREACCESS_TARGET,
+                                     window_width, window_height);
+    if (!map_texture || !grid_texture) {
+        fprintf(stderr, "SDL_CreateTexture Error: %s\n",
+                SDL_GetError());
+        quit_all();
+        return 1;
+    }
+    SDL_SetTextureBlendMode(grid_texture, SDL_BLENDMODE_BLEND);
+    if (cell_size <= LOD_CELL_SIZE) lod_mode = 1;
+
     return 0;
 }
 
+/* reallocs *array to hold newcap elements of the given size */
+static void grow(void **array, int newcap, size_t size) {
+    void *tmp = realloc(*array, newcap * size);
+    if (!tmp) {
+        perror("Failed to grow draw batch");
+        exit(EXIT_FAILURE);
+    }
+    *array = tmp;
+}
+
+/* adds cell (x, y) to the batch, both as a rect and as a center point */
+static void batch_cell(RectBatch *b, int x, int y) {
+    if (b->count == b->capacity) {
+        b->capacity = b->capacity ? b->capacity * 2 : 256;
+        grow((void **)&b->rects, b->capacity, sizeof(SDL_Rect));
+        grow((void **)&b->points, b->capacity, sizeof(SDL_Point));
+    }
+    b->rects[b->count] = (SDL_Rect){.x = y * cell_size,
+                                    .y = x * cell_size,
+                                    .w = cell_size,
+                                    .h = cell_size};
+    b->points[b->count] = (SDL_Point){.x = y * cell_size + cell_size / 2,
+                                      .y = x * cell_size + cell_size / 2};
+    b->count++;
+}
+
+/* submits the batch with a single draw call and empties it */
+static void flush_cells(RectBatch *b, SDL_Color color, int as_points) {
+    if (b->count == 0) return;
+    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b,
+                           color.a);
+    if (as_points)
+        SDL_RenderDrawPoints(renderer, b->points, b->count);
+    else
+        SDL_RenderFillRects(renderer, b->rects, b->count);
+    b->count = 0;
+}
+
+/* adds a line between the centers of cells from and to */
+static void batch_line(LineBatch *b, Coord from, Coord to,
+                       SDL_Color color) {
+    float x0 = from.y * cell_size + cell_size / 2.0f;
+    float y0 = from.x * cell_size + cell_size / 2.0f;
+    float x1 = to.y * cell_size + cell_size / 2.0f;
+    float y1 = to.x * cell_size + cell_size / 2.0f;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    if (b->count == b->capacity) {
+        b->capacity = b->capacity ? b->capacity * 2 : 256;
+        grow((void **)&b->vertices, b->capacity * 4, sizeof(SDL_Vertex));
+        grow((void **)&b->indices, b->capacity * 6, sizeof(int));
+    }
+    // Half-pixel normal turns the line into a 1 px wide quad
+    float dx = x1 - x0, dy = y1 - y0;
+    float len = SDL_sqrtf(dx * dx + dy * dy);
+    float nx = len > 0 ? -dy / len * 0.5f : 0.5f;
+    float ny = len > 0 ? dx / len * 0.5f : 0.0f;
+    SDL_Vertex *v = &b->vertices[b->count * 4];
+    v[0] = (SDL_Vertex){{x0 + nx, y0 + ny}, color, {0, 0}};
+    v[1] = (SDL_Vertex){{x0 - nx, y0 - ny}, color, {0, 0}};
+    v[2] = (SDL_Vertex){{x1 + nx, y1 + ny}, color, {0, 0}};
+    v[3] = (SDL_Vertex){{x1 - nx, y1 - ny}, color, {0, 0}};
+    int base = b->count * 4;
+    int *idx = &b->indices[b->count * 6];
+    idx[0] = base;     idx[1] = base + 1; idx[2] = base + 2;
+    idx[3] = base + 1; idx[4] = base + 3; idx[5] = base + 2;
+    b->count++;
+#else
+    // No geometry API before SDL 2.0.18: one call per line
+    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b,
+                           color.a);
+    SDL_RenderDrawLine(renderer, (int)x0, (int)y0, (int)x1, (int)y1);
+#endif
+}
+
+static void flush_lines(LineBatch *b) {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    if (b->count > 0)
+        SDL_RenderGeometry(renderer, NULL, b->vertices, b->count * 4,
+                           b->indices, b->count * 6);
+#endif
+    b->count = 0;
+}
+
 void draw_cell(int x, int y, SDL_Color color) {
-    SDL_Rect rect = {.x = y * CELL_SIZE,
-                     .y = x * CELL_SIZE,
-                     .w = CELL_SIZE,
-                     .h = CELL_SIZE};
+    SDL_Rect rect = {.x = y * cell_size,
+                     .y = x * cell_size,
+                     .w = cell_size,
+                     .h = cell_size};
     SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b,
                            color.a);
     SDL_RenderFillRect(renderer, &rect);
 }
 
-void draw_drones() {
-    for (int i = 0; i < num_drones; i++) {
-        pthread_mutex_lock(&drone_fleet[i].lock);
-        SDL_Color color =
-            (drone_fleet[i].status == IDLE) ? BLUE : GREEN;
-        draw_cell(drone_fleet[i].coord.x, drone_fleet[i].coord.y,
-                  color);
-
-        // Draw mission line if on mission
-        if (drone_fleet[i].status == ON_MISSION) {
-            SDL_SetRenderDrawColor(renderer, GREEN.r, GREEN.g,
-                                   GREEN.b, GREEN.a);
-            SDL_RenderDrawLine(
-                renderer,
-                drone_fleet[i].coord.y * CELL_SIZE + CELL_SIZE / 2,
-                drone_fleet[i].coord.x * CELL_SIZE + CELL_SIZE / 2,
-                drone_fleet[i].target.y * CELL_SIZE + CELL_SIZE / 2,
-                drone_fleet[i].target.x * CELL_SIZE + CELL_SIZE / 2);
+void draw_drones(const WorldSnapshot *snap) {
+    for (int i = 0; i < snap->num_drones; i++) {
+        const DroneView *d = &snap->drones[i];
+        if (d->status == IDLE) {
+            batch_cell(&idle_drones, d->coord.x, d->coord.y);
+        } else {
+            batch_cell(&busy_drones, d->coord.x, d->coord.y);
+        }
+
+        // Mission lines are left out in level of detail mode
+        if (d->status == ON_MISSION && !lod_mode) {
+            batch_line(&mission_lines, d->coord, d->target, GREEN);
         }
-        pthread_mutex_unlock(&drone_fleet[i].lock);
     }
+    flush_cells(&idle_drones, BLUE, lod_mode);
+    flush_cells(&busy_drones, GREEN, lod_mode);
+    flush_lines(&mission_lines);
 }
 
-void draw_survivors() {
-    for (int i = 0; i < map.height; i++) {
-        for (int j = 0; j < map.width; j++) {
-            pthread_mutex_lock(&map.cells[i][j].survivors->lock);
-            if (map.cells[i][j].survivors->number_of_elements > 0) {
-                draw_cell(i, j, RED);
-            }
-            pthread_mutex_unlock(&map.cells[i][j].survivors->lock);
+/* batches one cell of map_texture by its snapshot occupancy */
+static void redraw_survivor_cell(const WorldSnapshot *snap, int idx) {
+    batch_cell(snap->occupied[idx] ? &red_cells : &black_cells,
+               idx / snap->width, idx % snap->width);
+}
+
+void draw_survivors(const WorldSnapshot *snap) {
+    SDL_SetRenderTarget(renderer, map_texture);
+    if (full_redraw || snap->seq != drawn_seq + 1) {
+        // First frame, reset, or skipped snapshots: dirty lists of
+        // the skipped ones are gone, so repaint from the occupancy
+        SDL_SetRenderDrawColor(renderer, BLACK.r, BLACK.g, BLACK.b,
+                               BLACK.a);
+        SDL_RenderClear(renderer);
+        for (int idx = 0; idx < snap->height * snap->width; idx++) {
+            if (snap->occupied[idx]) redraw_survivor_cell(snap, idx);
+        }
+        full_redraw = 0;
+    } else {
+        for (int k = 0; k < snap->num_dirty; k++) {
+            redraw_survivor_cell(snap, snap->dirty[k]);
         }
     }
+    flush_cells(&black_cells, BLACK, 0);
+    flush_cells(&red_cells, RED, 0);
+    drawn_seq = snap->seq;
+    SDL_SetRenderTarget(renderer, NULL);
 }
 
 void draw_grid() {
-    SDL_SetRenderDrawColor(renderer, WHITE.r, WHITE.g, WHITE.b,
-                           WHITE.a);
-    for (int i = 0; i <= map.height; i++) {
-        SDL_RenderDrawLine(renderer, 0, i * CELL_SIZE, window_width,
-                           i * CELL_SIZE);
-    }
-    for (int j = 0; j <= map.width; j++) {
-        SDL_RenderDrawLine(renderer, j * CELL_SIZE, 0, j * CELL_SIZE,
-                           window_height);
+    if (cell_size < MIN_GRID_CELL) return;
+
+    if (!grid_ready) {
+        SDL_SetRenderTarget(renderer, grid_texture);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);  // transparent
+        SDL_RenderClear(renderer);
+        SDL_SetRenderDrawColor(renderer, WHITE.r, WHITE.g, WHITE.b,
+                               WHITE.a);
+        for (int i = 0; i <= map_height; i++) {
+            SDL_RenderDrawLine(renderer, 0, i * cell_size, window_width,
+                               i * cell_size);
+        }
+        for (int j = 0; j <= map_width; j++) {
+            SDL_RenderDrawLine(renderer, j * cell_size, 0,
+                               j * cell_size, window_height);
+        }
+        SDL_SetRenderTarget(renderer, NULL);
+        grid_ready = 1;
     }
+    SDL_RenderCopy(renderer, grid_texture, NULL, NULL);
 }
 
 int draw_map() {
-    SDL_SetRenderDrawColor(renderer, BLACK.r, BLACK.g, BLACK.b,
-                           BLACK.a);
-    SDL_RenderClear(renderer);
+    const WorldSnapshot *snap = latest_snapshot();
+    if (snap && (snap->seq != drawn_seq || full_redraw)) {
+        draw_survivors(snap);
+    }
 
-    draw_survivors();
-    draw_drones();
+    // map_texture covers the whole window, so no SDL_RenderClear
+    SDL_RenderCopy(renderer, map_texture, NULL, NULL);
+    if (snap) draw_drones(snap);
     draw_grid();
 
     SDL_RenderPresent(renderer);
@@ -130,11 +304,29 @@ int check_events() {
         if (event.type == SDL_KEYDOWN &&
             event.key.keysym.sym == SDLK_ESCAPE)
             return 1;
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_l)
+            lod_mode = !lod_mode;
+        // Target textures lose their content on a device reset
+        if (event.type == SDL_RENDER_TARGETS_RESET ||
+            event.type == SDL_RENDER_DEVICE_RESET) {
+            full_redraw = 1;
+            grid_ready = 0;
+        }
     }
     return 0;
 }
 
 void quit_all() {
+    if (map_texture) SDL_DestroyTexture(map_texture);
+    if (grid_texture) SDL_DestroyTexture(grid_texture);
+    RectBatch *batches[] = {&red_cells, &black_cells, &idle_drones,
+                            &busy_drones};
+    for (int i = 0; i < 4; i++) {
+        free(batches[i]->rects);
+        free(batches[i]->points);
+    }
+    free(mission_lines.vertices);
+    free(mission_lines.indices);
     if (renderer) SDL_DestroyRenderer(renderer);
     if (window) SDL_DestroyWindow(window);
     SDL_Quit();
@@ -0,0 +1,49 @@
+// viewer.c: renders a world streamed by `controller --stream PORT`
+#include "headers/globals.h"
+#include "headers/snapshot.h"
+#include "headers/stream.h"
+#include "headers/view.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+volatile sig_atomic_t running = 1;
+
+int main(int argc, char *argv[]) {
+    const char *host = argc > 1 ? argv[1] : "127.0.0.1";
+    int port = argc > 2 ? atoi(argv[2]) : STREAM_PORT;
+
+    int fd = stream_connect(host, port);
+    if (fd < 0) return 1;
+
+    // The first message is a keyframe, it tells the map size
+    WorldSnapshot mirror = {0};
+    if (stream_apply_next(fd, &mirror) != 0 || !mirror.occupied) {
+        fprintf(stderr, "No keyframe from %s:%d\n", host, port);
+        return 1;
+    }
+    init_snapshots(mirror.height, mirror.width);
+    publish_mirror(&mirror);
+
+    pthread_t receiver_thread;
+    StreamConn conn = {.fd = fd, .mirror = &mirror};
+    pthread_create(&receiver_thread, NULL, stream_receiver, &conn);
+
+    init_sdl_window(mirror.height, mirror.width);
+    while (running && !check_events()) {
+        draw_map();
+        SDL_Delay(100);
+    }
+    printf("Exiting...\n");
+    running = 0;
+    shutdown(fd, SHUT_RDWR);  // wakes the receiver out of recv
+    pthread_join(receiver_thread, NULL);
+    close(fd);
+    quit_all();
+    free_snapshots();
+    free(mirror.drones);
+    free(mirror.occupied);
+    free(mirror.dirty);
+    return 0;
+}
@@ -0,0 +1,303 @@
+/**
+ * @file wire.c
+ * @brief compact binary encoding of the protocol messages.
+ *
+ * Payload layouts after the type byte (all integers little-endian,
+ * str = 1 byte length + bytes, coord = zigzag varint x, y):
+ *
+ *   HANDSHAKE           str drone_id
+ *   STATUS_UPDATE       str drone_id, i64 timestamp, coord location,
+ *                       u8 status, u8 battery, u16 speed
+ *   MISSION_COMPLETE    str drone_id, str mission_id, i64 timestamp,
+ *                       u8 success
+ *   HEARTBEAT_RESPONSE  str drone_id, i64 timestamp
+ *   HANDSHAKE_ACK       str session_id, u16 status_update_interval,
+ *                       u16 heartbeat_interval
+ *   ASSIGN_MISSION      str mission_id, u8 priority, coord target,
+ *                       i64 expiry
+ *   HEARTBEAT           i64 timestamp
+ *   ERROR               u16 code, i64 timestamp, str message
+ *   CONFIG_UPDATE       u16 status_update_interval
+ *
+ * A UDP telemetry datagram is u32 telemetry_id, u32 telemetry_key,
+ * u32 seq and a STATUS_UPDATE frame, length prefix included.
+ */
+#include "headers/wire.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "headers/codec.h"
+
+static const char *statuses[] = {"idle", "busy", "charging"};
+static const char *priorities[] = {"low", "medium", "high"};
+#define NAMES(a) (int)(sizeof(a) / sizeof(a[0]))
+
+/* index of name in names, -1 if it is not there */
+static int name_index(const char *name, const char **names, int n) {
+    for (int i = 0; i < n; i++)
+        if (strcmp(name, names[i]) == 0) return i;
+    return -1;
+}
+
+/* Writer and reader over a bounded buffer. A write past the end or a
+ * read past len sets the error flag instead of touching memory. */
+typedef struct {
+    unsigned char *buf;
+    size_t pos, size;
+    int error;
+} Writer;
+
+typedef struct {
+    const unsigned char *buf;
+    size_t pos, len;
+    int error;
+} Reader;
+
+static void put_bytes(Writer *w, const void *src, size_t n) {
+    if (w->pos + n > w->size) {
+        w->error = 1;
+        return;
+    }
+    memcpy(w->buf + w->pos, src, n);
+    w->pos += n;
+}
+
+static void put_uint(Writer *w, uint64_t v, int bytes) {
+    unsigned char b[8];
+    for (int i = 0; i < bytes; i++) b[i] = (unsigned char)(v >> (8 * i));
+    put_bytes(w, b, bytes);
+}
+
+static void put_str(Writer *w, const char *s) {
+    size_t n = strlen(s);
+    put_uint(w, n, 1);
+    put_bytes(w, s, n);
+}
+
+/* an unknown name fails the message rather than sending entry 0 */
+static void put_name(Writer *w, const char *name, const char **names, int n) {
+    int i = name_index(name, names, n);
+    if (i < 0) w->error = 1;
+    else put_uint(w, i, 1);
+}
+
+static void put_coord(Writer *w, Coord c) {
+    if (w->pos + 2 * VARINT_MAX > w->size) {
+        w->error = 1;
+        return;
+    }
+    w->pos += put_varint(w->buf + w->pos, zigzag(c.x));
+    w->pos += put_varint(w->buf + w->pos, zigzag(c.y));
+}
+
+static uint64_t get_uint(Reader *r, int bytes) {
+    if (r->pos + bytes > r->len) {
+        r->error = 1;
+        return 0;
+    }
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++)
+        v |= (uint64_t)r->buf[r->pos + i] << (8 * i);
+    r->pos += bytes;
+    return v;
+}
+
+static void get_str(Reader *r, char *dest, size_t size) {
+    size_t n = get_uint(r, 1);
+    if (r->error || r->pos + n > r->len || n >= size) {
+        r->error = 1;
+        dest[0] = '\0';
+        return;
+    }
+    memcpy(dest, r->buf + r->pos, n);
+    dest[n] = '\0';
+    r->pos += n;
+}
+
+static Coord get_coord(Reader *r) {
+    unsigned int v[2] = {0, 0};
+    for (int i = 0; i < 2 && !r->error; i++) {
+        int n = get_varint(r->buf + r->pos, r->len - r->pos, &v[i]);
+        if (n <= 0) r->error = 1;
+        else r->pos += n;
+    }
+    return (Coord){unzigzag(v[0]), unzigzag(v[1])};
+}
+
+/**
+ * @brief writes msg as one binary frame (length prefix included)
+ * @return int: frame size, -1 if it does not fit in size bytes
+ */
+int encode_binary(const Message *msg, unsigned char *buf, size_t size) {
+    Writer w = {buf, WIRE_HEADER, size, size < WIRE_HEADER};
+    put_uint(&w, msg->type, 1);
+    switch (msg->type) {
+        case MSG_HANDSHAKE:
+            put_str(&w, msg->drone_id);
+            break;
+        case MSG_STATUS_UPDATE:
+            put_str(&w, msg->drone_id);
+            put_uint(&w, msg->timestamp, 8);
+            put_coord(&w, msg->location);
+            put_name(&w, msg->status, statuses, NAMES(statuses));
+            put_uint(&w, msg->battery, 1);
+            put_uint(&w, msg->speed, 2);
+            break;
+        case MSG_MISSION_COMPLETE:
+            put_str(&w, msg->drone_id);
+            put_str(&w, msg->mission_id);
+            put_uint(&w, msg->timestamp, 8);
+            put_uint(&w, msg->success, 1);
+            break;
+        case MSG_HEARTBEAT_RESPONSE:
+            put_str(&w, msg->drone_id);
+            put_uint(&w, msg->timestamp, 8);
+            break;
+        case MSG_HANDSHAKE_ACK:
+            put_str(&w, msg->session_id);
+            put_uint(&w, msg->status_update_interval, 2);
+            put_uint(&w, msg->heartbeat_interval, 2);
+            break;
+        case MSG_ASSIGN_MISSION:
+            put_str(&w, msg->mission_id);
+            put_name(&w, msg->priority, priorities, NAMES(priorities));
+            put_coord(&w, msg->target);
+            put_uint(&w, msg->expiry, 8);
+            break;
+        case MSG_HEARTBEAT:
+            put_uint(&w, msg->timestamp, 8);
+            break;
+        case MSG_ERROR:
+            put_uint(&w, msg->code, 2);
+            put_uint(&w, msg->timestamp, 8);
+            put_str(&w, msg->error);
+            break;
+        case MSG_CONFIG_UPDATE:
+            put_uint(&w, msg->status_update_interval, 2);
+            break;
+        default:
+            return -1;
+    }
+    size_t payload = w.pos - WIRE_HEADER;
+    if (w.error || w.pos > WIRE_MAX_FRAME) return -1;
+    buf[0] = (unsigned char)payload;
+    buf[1] = (unsigned char)(payload >> 8);
+    return (int)w.pos;
+}
+
+/**
+ * @brief parses one frame payload (without the length prefix)
+ * @return int: 0 on success, -1 if the payload is malformed
+ */
+int decode_binary(const unsigned char *payload, size_t len, Message *msg) {
+    Reader r = {payload, 0, len, 0};
+    memset(msg, 0, sizeof(Message));
+    msg->type = get_uint(&r, 1);
+    switch (msg->type) {
+        case MSG_HANDSHAKE:
+            get_str(&r, msg->drone_id, sizeof(msg->drone_id));
+            strcpy(msg->encoding, "binary");
+            break;
+        case MSG_STATUS_UPDATE: {
+            get_str(&r, msg->drone_id, sizeof(msg->drone_id));
+            msg->timestamp = (long)get_uint(&r, 8);
+            msg->location = get_coord(&r);
+            unsigned int status = get_uint(&r, 1);
+            if (status >= (unsigned)NAMES(statuses)) r.error = 1;
+            else strcpy(msg->status, statuses[status]);
+            msg->battery = get_uint(&r, 1);
+            msg->speed = get_uint(&r, 2);
+            break;
+        }
+        case MSG_MISSION_COMPLETE:
+            get_str(&r, msg->drone_id, sizeof(msg->drone_id));
+            get_str(&r, msg->mission_id, sizeof(msg->mission_id));
+            msg->timestamp = (long)get_uint(&r, 8);
+            msg->success = get_uint(&r, 1) != 0;
+            break;
+        case MSG_HEARTBEAT_RESPONSE:
+            get_str(&r, msg->drone_id, sizeof(msg->drone_id));
+            msg->timestamp = (long)get_uint(&r, 8);
+            break;
+        case MSG_HANDSHAKE_ACK:
+            get_str(&r, msg->session_id, sizeof(msg->session_id));
+            msg->status_update_interval = get_uint(&r, 2);
+            msg->heartbeat_interval = get_uint(&r, 2);
+            strcpy(msg->encoding, "binary");
+            break;
+        case MSG_ASSIGN_MISSION: {
+            get_str(&r, msg->mission_id, sizeof(msg->mission_id));
+            unsigned int priority = get_uint(&r, 1);
+            if (priority >= (unsigned)NAMES(priorities)) r.error = 1;
+            else strcpy(msg->priority, priorities[priority]);
+            msg->target = get_coord(&r);
+            msg->expiry = (long)get_uint(&r, 8);
+            break;
+        }
+        case MSG_HEARTBEAT:
+            msg->timestamp = (long)get_uint(&r, 8);
+            break;
+        case MSG_ERROR:
+            msg->code = get_uint(&r, 2);
+            msg->timestamp = (long)get_uint(&r, 8);
+            get_str(&r, msg->error, sizeof(msg->error));
+            break;
+        case MSG_CONFIG_UPDATE:
+            msg->status_update_interval = get_uint(&r, 2);
+            break;
+        default:
+            return -1;
+    }
+    return r.error || r.pos != len ? -1 : 0;
+}
+
+/**
+ * @brief size of the frame at the start of buf
+ * @return int: frame size, 0 if the length prefix is not complete,
+ * -1 if the frame is larger than WIRE_MAX_FRAME
+ */
+int binary_frame_length(const unsigned char *buf, size_t len) {
+    if (len < WIRE_HEADER) return 0;
+    int frame = WIRE_HEADER + (buf[0] | buf[1] << 8);
+    return frame > WIRE_MAX_FRAME ? -1 : frame;
+}
+
+/**
+ * @brief builds a UDP telemetry datagram: u32 telemetry_id,
+ * u32 telemetry_key, u32 seq, then msg as a binary frame
+ * @return int: datagram size, -1 if msg is not a STATUS_UPDATE or does
+ * not fit
+ */
+int encode_telemetry(const Message *msg, unsigned int id, unsigned int key,
+                     unsigned int seq, unsigned char *buf, size_t size) {
+    if (msg->type != MSG_STATUS_UPDATE || size < TELEMETRY_HEADER) return -1;
+    Writer w = {buf, 0, size, 0};
+    put_uint(&w, id, 4);
+    put_uint(&w, key, 4);
+    put_uint(&w, seq, 4);
+    int frame = encode_binary(msg, buf + TELEMETRY_HEADER,
+                              size - TELEMETRY_HEADER);
+    return frame < 0 ? -1 : TELEMETRY_HEADER + frame;
+}
+
+/**
+ * @brief parses a datagram built by encode_telemetry()
+ * @return int: 0 on success, -1 if it is malformed or not a
+ * STATUS_UPDATE
+ */
+int decode_telemetry(const unsigned char *buf, size_t len, unsigned int *id,
+                     unsigned int *key, unsigned int *seq, Message *msg) {
+    Reader r = {buf, 0, len, 0};
+    *id = get_uint(&r, 4);
+    *key = get_uint(&r, 4);
+    *seq = get_uint(&r, 4);
+    if (r.error) return -1;
+    int frame = binary_frame_length(buf + TELEMETRY_HEADER,
+                                    len - TELEMETRY_HEADER);
+    if (frame <= 0 || (size_t)frame != len - TELEMETRY_HEADER) return -1;
+    if (decode_binary(buf + TELEMETRY_HEADER + WIRE_HEADER,
+                      frame - WIRE_HEADER, msg) != 0)
+        return -1;
+    return msg->type == MSG_STATUS_UPDATE ? 0 : -1;
+}